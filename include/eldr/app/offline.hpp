@@ -0,0 +1,57 @@
+#pragma once
+#include <eldr/core/fwd.hpp>
+#include <eldr/render/bvh.hpp>
+#include <eldr/render/integrator.hpp>
+#include <eldr/render/rfilter.hpp>
+#include <eldr/render/sampler.hpp>
+
+#include <filesystem>
+#include <memory>
+
+namespace eldr::app {
+/// @brief Renders a scene with the CPU path tracer and writes the image to
+/// disk, without opening a window or initializing Vulkan
+class OfflineRenderer {
+  ELDR_IMPORT_CORE_TYPES();
+
+public:
+  struct Settings {
+    /// Scene file, relative to ELDR_DIR
+    std::filesystem::path model_path{ "assets/models/Suzanne.gltf" };
+    /// Equirectangular image lighting the scene from all around, none if
+    /// empty
+    std::filesystem::path environment_path;
+    Float                 environment_scale{ 1.f };
+    /// Image file to write, the format follows from the extension. With
+    /// several frames, the frame number is appended to the file name.
+    std::filesystem::path    output_path{ "render.pfm" };
+    /// Number of frames of a turntable animation, rotating the scene once
+    /// around +z
+    uint32_t                 frames{ 1 };
+    /// Rebuild the top-level BVH between frames once its SAH cost exceeds the
+    /// built one by this factor, see `SceneAccel::update`
+    Float                    tlas_rebuild_threshold{ 2.f };
+    uint32_t                 width{ 1280 };
+    uint32_t                 height{ 720 };
+    PathIntegrator::Settings integrator;
+    BVHBuildSettings         bvh;
+    /// Reorder mesh triangles and vertices for locality when loading
+    bool optimize_mesh_layout{ false };
+    /// Pixel reconstruction filter
+    std::shared_ptr<ReconstructionFilter> filter{
+      std::make_shared<GaussianFilter>()
+    };
+    std::shared_ptr<Sampler> sampler{ std::make_shared<SobolSampler>() };
+  };
+
+  explicit OfflineRenderer(const Settings& settings) : settings_(settings) {}
+
+  void run();
+
+private:
+  std::filesystem::path frameOutputPath(uint32_t frame) const;
+
+private:
+  Settings settings_;
+};
+} // namespace eldr::app
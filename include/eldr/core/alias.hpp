@@ -0,0 +1,87 @@
+#pragma once
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/math.hpp>
+
+#include <span>
+#include <vector>
+
+namespace eldr {
+/// @brief Discrete distribution over `size()` entries, sampled in constant
+/// time with Walker's alias method. Every entry owns a bin of equal
+/// probability, which it shares with at most one other entry (its alias), so
+/// a sample picks a bin and then one of its two entries, without searching.
+///
+/// Large tables are built on the global thread pool. Entries of zero weight
+/// are never picked, and if all weights are zero every entry is equally
+/// likely. A single precision sample only has the resolution to also choose
+/// within the bins of tables up to about a million entries, larger
+/// distributions such as images should use `AliasTable2D`.
+class AliasTable {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  AliasTable() = default;
+  explicit AliasTable(std::span<const Float> weights);
+
+  /// @brief Pick an entry with probability proportional to its weight
+  /// @param u Uniform sample in [0, 1)
+  [[nodiscard]] uint32_t sample(Float u) const
+  {
+    return sampleReuse(u);
+  }
+
+  /// @brief Pick an entry like `sample`, and remap `u` to a new uniform
+  /// sample in [0, 1) independent of the choice, for reuse by the caller
+  [[nodiscard]] uint32_t sampleReuse(Float& u) const;
+
+  /// @brief Get the probability of picking entry `index`
+  [[nodiscard]] Float pmf(uint32_t index) const { return pmf_[index]; }
+
+  /// @brief Get the sum of all weights
+  [[nodiscard]] double sum() const { return sum_; }
+
+  [[nodiscard]] size_t size() const { return bins_.size(); }
+  [[nodiscard]] bool   empty() const { return bins_.empty(); }
+
+private:
+  struct Bin {
+    /// Probability of keeping the entry of the bin rather than its alias
+    float    q;
+    uint32_t alias;
+  };
+
+  std::vector<Bin>   bins_;
+  std::vector<Float> pmf_;
+  double             sum_{ 0. };
+};
+
+/// @brief Discrete distribution over the cells of a 2D grid, such as the
+/// pixels of an image. A row is picked from the marginal distribution of the
+/// row sums first, then a cell from the conditional distribution of that row,
+/// both with alias tables. The rows are built in parallel.
+class AliasTable2D {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  AliasTable2D() = default;
+  /// @param weights Row-major weights of the `size.x` x `size.y` cells
+  AliasTable2D(std::span<const Float> weights, const Vec2u& size);
+
+  /// @brief Pick a cell with probability proportional to its weight, and
+  /// remap `u` to a uniform sample in [0, 1)^2 independent of the choice
+  [[nodiscard]] Vec2u sampleReuse(Point2f& u) const;
+
+  /// @brief Get the probability of picking `cell`
+  [[nodiscard]] Float pmf(const Vec2u& cell) const
+  {
+    return marginal_.pmf(cell.y) * conditional_[cell.y].pmf(cell.x);
+  }
+
+  [[nodiscard]] const Vec2u& size() const { return size_; }
+
+private:
+  Vec2u                   size_{ 0 };
+  AliasTable              marginal_;
+  std::vector<AliasTable> conditional_;
+};
+} // namespace eldr
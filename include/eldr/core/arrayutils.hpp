@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstddef>
 #include <cstring>
+#include <new>
+#include <vector>
 
 namespace eldr {
 template <typename T, typename U> T memcpy_cast(const U& u)
@@ -10,4 +13,41 @@ template <typename T, typename U> T memcpy_cast(const U& u)
   memcpy(&result, &u, sizeof(T));
   return result;
 }
+
+/// @brief Allocator returning memory aligned to `Alignment` bytes, by default
+/// a cache line, e.g. for SoA buffers processed with SIMD
+template <typename T, size_t Alignment = 64> struct AlignedAllocator {
+  static_assert(Alignment >= alignof(T), "alignment too small for T");
+  using value_type = T;
+
+  template <typename U> struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() = default;
+  template <typename U>
+  constexpr AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept
+  {
+  }
+
+  [[nodiscard]] T* allocate(size_t count)
+  {
+    return static_cast<T*>(
+      ::operator new(count * sizeof(T), std::align_val_t{ Alignment }));
+  }
+
+  void deallocate(T* p, size_t) noexcept
+  {
+    ::operator delete(p, std::align_val_t{ Alignment });
+  }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept
+  {
+    return true;
+  }
+};
+
+template <typename T, size_t Alignment = 64>
+using AlignedVector = std::vector<T, AlignedAllocator<T, Alignment>>;
 } // namespace eldr
@@ -0,0 +1,79 @@
+#pragma once
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/math.hpp>
+
+#include <limits>
+
+namespace eldr {
+/// @brief Axis-aligned bounding box. A default constructed box is "invalid",
+/// i.e. min > max, so that expanding it by any point yields a valid box.
+struct BoundingBox3f {
+  ELDR_IMPORT_CORE_TYPES()
+
+  BoundingBox3f()
+    : min(std::numeric_limits<Float>::max()),
+      max(std::numeric_limits<Float>::lowest())
+  {
+  }
+  explicit BoundingBox3f(const Point3f& p) : min(p), max(p) {}
+  BoundingBox3f(const Point3f& min, const Point3f& max) : min(min), max(max) {}
+
+  /// @brief Check whether this is a valid bounding box (min <= max)
+  [[nodiscard]] bool valid() const
+  {
+    return min.x <= max.x and min.y <= max.y and min.z <= max.z;
+  }
+
+  [[nodiscard]] Point3f center() const { return (min + max) * .5f; }
+  [[nodiscard]] Vec3f   extents() const { return max - min; }
+
+  [[nodiscard]] Float surfaceArea() const
+  {
+    if (not valid())
+      return 0.f;
+    const Vec3f e{ extents() };
+    return 2.f * (e.x * e.y + e.y * e.z + e.z * e.x);
+  }
+
+  /// @brief Return the index of the axis with the largest extent
+  [[nodiscard]] uint32_t majorAxis() const
+  {
+    const Vec3f e{ extents() };
+    uint32_t    axis{ 0 };
+    if (e.y > e[axis])
+      axis = 1;
+    if (e.z > e[axis])
+      axis = 2;
+    return axis;
+  }
+
+  [[nodiscard]] bool contains(const Point3f& p) const
+  {
+    return p.x >= min.x and p.x <= max.x and p.y >= min.y and p.y <= max.y and
+           p.z >= min.z and p.z <= max.z;
+  }
+
+  void expand(const Point3f& p)
+  {
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+  }
+
+  void expand(const BoundingBox3f& bbox)
+  {
+    min = glm::min(min, bbox.min);
+    max = glm::max(max, bbox.max);
+  }
+
+  [[nodiscard]] static BoundingBox3f merge(const BoundingBox3f& a,
+                                           const BoundingBox3f& b)
+  {
+    return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+  }
+
+  bool operator==(const BoundingBox3f&) const = default;
+
+  Point3f min;
+  Point3f max;
+};
+} // namespace eldr
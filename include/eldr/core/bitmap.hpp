@@ -99,6 +99,14 @@ public:
   size_t bytesPerPixel() const;
   size_t bufferSize() const;
   bool   srgbGamma() const { return srgb_gamma_; }
+  /// Write the bitmap to a file. With `FileFormat::Auto`, the format is
+  /// deduced from the file extension.
+  void write(const std::filesystem::path& path,
+             FileFormat                   format = FileFormat::Auto) const;
+
+  /// Write the bitmap to a stream in the given format
+  void write(Stream* stream, FileFormat format) const;
+
   // Convert RGB to RGBA, adding an opaque alpha channel.
   // This is useful for creating Vulkan images, which require RGBA.
   void              rgbToRgba();
@@ -151,11 +159,11 @@ protected:
   ///// Save a file using the RGBE file format
   // void write_rgbe(Stream* stream) const;
 
-  ///// Read a file encoded using the PFM file format
-  // void read_pfm(Stream* stream);
+  /// Read a file encoded using the PFM file format
+  void readPfm(Stream* stream);
 
-  ///// Save a file using the PFM file format
-  // void write_pfm(Stream* stream) const;
+  /// Save a file using the PFM file format
+  void writePfm(Stream* stream) const;
 
 private:
   std::string               name_{ "undefined" };
@@ -0,0 +1,43 @@
+#pragma once
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/math.hpp>
+
+#include <cmath>
+
+namespace eldr {
+/// @brief Orthonormal basis used to move directions between world space and
+/// a local shading space, in which the normal `n` is the z-axis.
+struct Frame3f {
+  ELDR_IMPORT_CORE_TYPES()
+
+  Frame3f() = default;
+
+  /// @brief Build a frame around a normalized vector
+  explicit Frame3f(const Vec3f& n) : n(n)
+  {
+    // Duff et al. 2017, "Building an Orthonormal Basis, Revisited"
+    const Float sign{ std::copysign(1.f, n.z) };
+    const Float a{ -1.f / (sign + n.z) };
+    const Float b{ n.x * n.y * a };
+    s = Vec3f{ 1.f + sign * n.x * n.x * a, sign * b, -sign * n.x };
+    t = Vec3f{ b, sign + n.y * n.y * a, -n.y };
+  }
+
+  [[nodiscard]] Vec3f toLocal(const Vec3f& v) const
+  {
+    return { glm::dot(v, s), glm::dot(v, t), glm::dot(v, n) };
+  }
+
+  [[nodiscard]] Vec3f toWorld(const Vec3f& v) const
+  {
+    return s * v.x + t * v.y + n * v.z;
+  }
+
+  /// @brief Cosine of the angle between a local direction and the normal
+  [[nodiscard]] static Float cosTheta(const Vec3f& v) { return v.z; }
+
+  Vec3f s{ 1.f, 0.f, 0.f };
+  Vec3f t{ 0.f, 1.f, 0.f };
+  Vec3f n{ 0.f, 0.f, 1.f };
+};
+} // namespace eldr
@@ -11,6 +11,7 @@ namespace eldr {
 class Bitmap;
 class Struct;
 class Stream;
+class MemoryMappedFile;
 class StopWatch;
 
 namespace core {
@@ -22,6 +23,9 @@ struct SingleThreaded;
 struct MultiThreaded;
 class Sink;
 class Thread;
+class ThreadPool;
+class TaskGroup;
+template <typename T> class BlockedRange;
 } // namespace core
 
 template <size_t size, typename T> using Color = glm::vec<size, T>;
@@ -3,6 +3,8 @@
  */
 #pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <functional>
 
 namespace eldr {
@@ -52,6 +54,39 @@ size_t hash(const std::vector<T, Allocator>& v)
   return value;
 }
 
+/// @brief Hash a block of memory with MurmurHash64A. Unlike `std::hash`, the
+/// result is the same in every run and build, so it can identify data stored
+/// on disk.
+inline uint64_t hashBuffer(const void* data, size_t size, uint64_t seed = 0)
+{
+  constexpr uint64_t m{ 0xc6a4a7935bd1e995ull };
+  constexpr int      r{ 47 };
+  const auto*        bytes{ static_cast<const uint8_t*>(data) };
+  uint64_t           h{ seed ^ (size * m) };
+
+  const size_t words{ size / 8 };
+  for (size_t i = 0; i < words; ++i) {
+    uint64_t k;
+    std::memcpy(&k, bytes + 8 * i, sizeof(k));
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+  if (const size_t tail{ size % 8 }; tail > 0) {
+    uint64_t k{ 0 };
+    std::memcpy(&k, bytes + 8 * words, tail);
+    h ^= k;
+    h *= m;
+  }
+
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
+
 template <typename T> struct hasher {
   size_t operator()(const T& t) const { return hash(t); }
 };
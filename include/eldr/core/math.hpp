@@ -5,3 +5,86 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/quaternion.hpp>
+
+// After the GLM_FORCE defines, since it includes glm
+#include <eldr/core/fwd.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+
+namespace eldr {
+inline constexpr Float pi{ std::numbers::pi_v<Float> };
+/// Largest float below one, for clamping samples to [0, 1)
+inline constexpr float one_minus_epsilon{ 0x1.fffffep-1f };
+
+/// @brief Square root that clamps small negative rounding errors to zero
+template <typename T> [[nodiscard]] T safeSqrt(T x)
+{
+  return std::sqrt(std::max(x, T(0)));
+}
+
+/// @brief Arc cosine that clamps its argument to [-1, 1]
+template <typename T> [[nodiscard]] T safeAcos(T x)
+{
+  return std::acos(std::clamp(x, T(-1), T(1)));
+}
+
+/// @brief Luminance of a linear sRGB color
+template <typename T> [[nodiscard]] constexpr T luminance(const Color<3, T>& c)
+{
+  return T(0.2126) * c.x + T(0.7152) * c.y + T(0.0722) * c.z;
+}
+
+/// @brief Reciprocal of a ray direction component, clamped away from zero so
+/// that it stays finite. Slab tests would otherwise compute inf - inf or
+/// 0 * inf for rays parallel to an axis.
+template <typename T> [[nodiscard]] T safeRcp(T d)
+{
+  constexpr T min_d{ T(1e-18) };
+  return T(1) / (std::abs(d) < min_d ? std::copysign(min_d, d) : d);
+}
+
+/// @brief `safeRcp` of each component of a direction
+template <typename T> [[nodiscard]] Vec<3, T> safeRcp(const Vec<3, T>& d)
+{
+  return { safeRcp(d.x), safeRcp(d.y), safeRcp(d.z) };
+}
+
+/// @brief Insert a zero bit in between each of the lower 16 bits of `x`
+[[nodiscard]] constexpr uint32_t part1By1(uint32_t x)
+{
+  x &= 0x0000ffff;
+  x = (x | (x << 8)) & 0x00ff00ff;
+  x = (x | (x << 4)) & 0x0f0f0f0f;
+  x = (x | (x << 2)) & 0x33333333;
+  x = (x | (x << 1)) & 0x55555555;
+  return x;
+}
+
+/// @brief Insert two zero bits in between each of the lower 10 bits of `x`
+[[nodiscard]] constexpr uint32_t part1By2(uint32_t x)
+{
+  x &= 0x000003ff;
+  x = (x | (x << 16)) & 0x030000ff;
+  x = (x | (x << 8)) & 0x0300f00f;
+  x = (x | (x << 4)) & 0x030c30c3;
+  x = (x | (x << 2)) & 0x09249249;
+  return x;
+}
+
+/// @brief Interleave the lower 16 bits of `x` and `y` into a Morton code
+[[nodiscard]] constexpr uint32_t mortonEncode2(uint32_t x, uint32_t y)
+{
+  return part1By1(x) | (part1By1(y) << 1);
+}
+
+/// @brief Interleave the lower 10 bits of `x`, `y` and `z` into a Morton code
+[[nodiscard]] constexpr uint32_t mortonEncode3(uint32_t x,
+                                               uint32_t y,
+                                               uint32_t z)
+{
+  return part1By2(x) | (part1By2(y) << 1) | (part1By2(z) << 2);
+}
+} // namespace eldr
@@ -0,0 +1,36 @@
+#pragma once
+#include <eldr/core/fwd.hpp>
+
+#include <filesystem>
+
+namespace eldr {
+/// @brief File mapped into memory. Pages are only read from disk when first
+/// touched, so opening is immediate even for very large files.
+///
+/// The mapping is copy-on-write: the contents may be modified in memory, e.g.
+/// by a `MemoryStream` on top of it, but changes never reach the file.
+class MemoryMappedFile {
+public:
+  /// @brief Map the whole file at `path`. Throws if it can't be opened.
+  explicit MemoryMappedFile(const std::filesystem::path& path);
+  ~MemoryMappedFile();
+
+  MemoryMappedFile(const MemoryMappedFile&)            = delete;
+  MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+  [[nodiscard]] void*       data() { return data_; }
+  [[nodiscard]] const void* data() const { return data_; }
+  [[nodiscard]] size_t      size() const { return size_; }
+
+  [[nodiscard]] const std::filesystem::path& path() const { return path_; }
+
+private:
+  std::filesystem::path path_;
+  void*                 data_{ nullptr };
+  size_t                size_{ 0 };
+#if defined(_WIN32)
+  void* file_{ nullptr };
+  void* mapping_{ nullptr };
+#endif
+};
+} // namespace eldr
@@ -0,0 +1,167 @@
+#pragma once
+#include <eldr/core/fwd.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace eldr::core {
+/// @brief Half-open range [begin, end) that `parallelFor` recursively splits
+/// into blocks of at most `grain_size` elements
+template <typename T> class BlockedRange {
+public:
+  using value_type = T;
+
+  BlockedRange(T begin, T end, T grain_size = 1)
+    : begin_(begin), end_(end), grain_size_(std::max<T>(grain_size, 1))
+  {
+  }
+
+  [[nodiscard]] T begin() const { return begin_; }
+  [[nodiscard]] T end() const { return end_; }
+  [[nodiscard]] T grainSize() const { return grain_size_; }
+  [[nodiscard]] T size() const { return end_ - begin_; }
+  [[nodiscard]] bool empty() const { return not(begin_ < end_); }
+
+  /// @brief Check whether the range is large enough to be split further
+  [[nodiscard]] bool divisible() const { return size() > grain_size_; }
+
+  /// @brief Split the range into two halves
+  [[nodiscard]] std::pair<BlockedRange, BlockedRange> split() const
+  {
+    const T mid{ begin_ + size() / 2 };
+    return { BlockedRange{ begin_, mid, grain_size_ },
+             BlockedRange{ mid, end_, grain_size_ } };
+  }
+
+private:
+  T begin_;
+  T end_;
+  T grain_size_;
+};
+
+/// @brief Pool of worker threads with one task deque each. Workers push and
+/// pop tasks at the back of their own deque and steal from the front of the
+/// others' when they run out. Tasks submitted from threads outside the pool go
+/// to a shared queue.
+class ThreadPool {
+public:
+  using Task = std::function<void()>;
+
+  explicit ThreadPool(uint32_t thread_count);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&)            = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  [[nodiscard]] uint32_t threadCount() const;
+
+  /// @brief Schedule a task for execution. Exceptions escaping the task are
+  /// logged and discarded, use a `TaskGroup` to propagate them.
+  void submit(Task task);
+
+  /// @brief Run one pending task on the calling thread, if there is any. Used
+  /// by threads waiting for tasks to finish so that they help out instead of
+  /// blocking.
+  /// @return Whether a task was run
+  bool runPendingTask();
+
+  /// @brief Create the global thread pool
+  /// @param thread_count Number of worker threads, 0 to use one per core
+  static void createContext(uint32_t thread_count = 0);
+
+  /// @brief Stop and join the workers of the global thread pool
+  static void releaseContext();
+
+  /// @brief Get the global thread pool, or nullptr if there is none, in which
+  /// case tasks run on the calling thread
+  [[nodiscard]] static ThreadPool* instance();
+
+private:
+  void workerLoop(uint32_t index);
+
+private:
+  struct ThreadPoolImpl;
+  std::unique_ptr<ThreadPoolImpl> impl_;
+};
+
+/// @brief Set of tasks that can be waited on as a whole. Waiting threads run
+/// pending tasks of the pool while they wait, so task groups can be nested
+/// freely, e.g. for fork-join recursion. The first exception thrown by a task
+/// is rethrown by `wait()`.
+class TaskGroup {
+public:
+  explicit TaskGroup(ThreadPool* pool = ThreadPool::instance()) : pool_(pool)
+  {
+  }
+  ~TaskGroup();
+
+  TaskGroup(const TaskGroup&)            = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  /// @brief Run `func` asynchronously, or right away if there is no pool
+  template <typename Func> void run(Func&& func);
+
+  /// @brief Wait for all tasks of the group to finish
+  void wait();
+
+private:
+  void setException(std::exception_ptr exception);
+
+private:
+  ThreadPool*           pool_;
+  std::atomic<uint32_t> pending_{ 0 };
+  std::mutex            exception_mutex_;
+  std::exception_ptr    exception_;
+};
+
+template <typename Func> void TaskGroup::run(Func&& func)
+{
+  if (not pool_) {
+    func();
+    return;
+  }
+  pending_.fetch_add(1, std::memory_order_relaxed);
+  pool_->submit([this, func = std::forward<Func>(func)]() mutable {
+    try {
+      func();
+    }
+    catch (...) {
+      setException(std::current_exception());
+    }
+    pending_.fetch_sub(1, std::memory_order_release);
+  });
+}
+
+namespace detail {
+template <typename T, typename Func>
+void parallelForSplit(TaskGroup& group, BlockedRange<T> range, Func& func)
+{
+  while (range.divisible()) {
+    auto [left, right] = range.split();
+    group.run([&group, right, &func] { parallelForSplit(group, right, func); });
+    range = left;
+  }
+  func(range);
+}
+} // namespace detail
+
+/// @brief Call `func(const BlockedRange<T>&)` for blocks covering `range` in
+/// parallel, and wait for all of them to finish. The range is split
+/// recursively, so idle workers steal large blocks first.
+template <typename T, typename Func>
+void parallelFor(const BlockedRange<T>& range,
+                 Func&&                 func,
+                 ThreadPool*            pool = ThreadPool::instance())
+{
+  if (range.empty())
+    return;
+  TaskGroup group{ pool };
+  detail::parallelForSplit(group, range, func);
+  group.wait();
+}
+} // namespace eldr::core
@@ -0,0 +1,89 @@
+#pragma once
+#include <eldr/core/fwd.hpp>
+
+#include <bit>
+#include <cstdint>
+
+namespace eldr {
+/// @brief PCG32 pseudo-random number generator by Melissa O'Neill
+/// (https://www.pcg-random.org). Small state, fast, and statistically much
+/// better than the standard library engines of similar size. Independent
+/// streams are selected with `seed()`, so e.g. every pixel of an image can get
+/// its own reproducible sequence.
+class PCG32 {
+public:
+  static constexpr uint64_t default_state{ 0x853c49e6748fea9bULL };
+  static constexpr uint64_t default_stream{ 0xda3e39cb94b95bdbULL };
+  static constexpr uint64_t mult{ 0x5851f42d4c957f2dULL };
+
+  PCG32(uint64_t init_state = default_state, uint64_t init_seq = 1)
+  {
+    seed(init_state, init_seq);
+  }
+
+  /// @brief Seed the generator
+  /// @param init_state Starting state
+  /// @param init_seq Sequence selection constant, i.e. which of the 2^63
+  /// streams to use
+  void seed(uint64_t init_state, uint64_t init_seq = 1)
+  {
+    state_ = 0;
+    inc_   = (init_seq << 1u) | 1u;
+    nextUInt32();
+    state_ += init_state;
+    nextUInt32();
+  }
+
+  /// @brief Generate a uniformly distributed 32-bit integer
+  uint32_t nextUInt32()
+  {
+    const uint64_t old_state{ state_ };
+    state_ = old_state * mult + inc_;
+    const auto xor_shifted{ static_cast<uint32_t>(
+      ((old_state >> 18u) ^ old_state) >> 27u) };
+    const auto rot{ static_cast<int>(old_state >> 59u) };
+    return std::rotr(xor_shifted, rot);
+  }
+
+  /// @brief Generate a uniformly distributed float in [0, 1)
+  float nextFloat()
+  {
+    // Fill the mantissa of a float in [1, 2) with random bits
+    return std::bit_cast<float>((nextUInt32() >> 9) | 0x3f800000u) - 1.f;
+  }
+
+  /// @brief Advance the generator by `delta` steps in O(log(delta)) time
+  void advance(int64_t delta)
+  {
+    uint64_t cur_mult{ mult }, cur_plus{ inc_ }, acc_mult{ 1u }, acc_plus{ 0u };
+    // Two's complement makes negative deltas go backwards
+    auto steps{ static_cast<uint64_t>(delta) };
+    while (steps > 0) {
+      if (steps & 1) {
+        acc_mult *= cur_mult;
+        acc_plus = acc_plus * cur_mult + cur_plus;
+      }
+      cur_plus = (cur_mult + 1) * cur_plus;
+      cur_mult *= cur_mult;
+      steps /= 2;
+    }
+    state_ = acc_mult * state_ + acc_plus;
+  }
+
+private:
+  uint64_t state_;
+  uint64_t inc_;
+};
+
+/// @brief Mix the bits of a 64-bit integer (the finalizer of MurmurHash3), for
+/// turning e.g. pixel coordinates into well distributed seeds
+constexpr uint64_t mix64(uint64_t v)
+{
+  v ^= v >> 33;
+  v *= 0xff51afd7ed558ccdULL;
+  v ^= v >> 33;
+  v *= 0xc4ceb9fe1a85ec53ULL;
+  v ^= v >> 33;
+  return v;
+}
+} // namespace eldr
@@ -0,0 +1,28 @@
+#pragma once
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/math.hpp>
+
+#include <limits>
+
+namespace eldr {
+/// @brief Simple ray data structure with an origin, a direction and a maximum
+/// extent along the direction.
+struct Ray3f {
+  ELDR_IMPORT_CORE_TYPES()
+
+  Ray3f() = default;
+  Ray3f(const Point3f& o,
+        const Vec3f&   d,
+        Float          maxt = std::numeric_limits<Float>::infinity())
+    : o(o), d(d), maxt(maxt)
+  {
+  }
+
+  /// @brief Return the position of a point along the ray
+  [[nodiscard]] Point3f operator()(Float t) const { return o + t * d; }
+
+  Point3f o{ 0.f };
+  Vec3f   d{ 0.f, 0.f, 1.f };
+  Float   maxt{ std::numeric_limits<Float>::infinity() };
+};
+} // namespace eldr
@@ -0,0 +1,116 @@
+#pragma once
+#include <eldr/core/math.hpp>
+
+#include <array>
+#include <cstdint>
+
+namespace eldr {
+namespace sobol {
+/// Number of dimensions with generator matrices
+constexpr uint32_t dimension_count{ 16 };
+/// Number of bits, and columns of the generator matrices
+constexpr uint32_t matrix_size{ 32 };
+
+namespace detail {
+/// @brief Primitive polynomial and initial direction numbers of a dimension,
+/// from the new-joe-kuo-6.21201 set by S. Joe and F. Y. Kuo
+struct DirectionNumbers {
+  uint32_t                degree;
+  uint32_t                coefficients;
+  std::array<uint32_t, 6> m;
+};
+
+// clang-format off
+constexpr std::array<DirectionNumbers, dimension_count - 1> joe_kuo{ {
+  { 1,  0, { 1 } },
+  { 2,  1, { 1, 3 } },
+  { 3,  1, { 1, 3, 1 } },
+  { 3,  2, { 1, 1, 1 } },
+  { 4,  1, { 1, 1, 3, 3 } },
+  { 4,  4, { 1, 3, 5, 13 } },
+  { 5,  2, { 1, 1, 5, 5, 17 } },
+  { 5,  4, { 1, 1, 5, 5, 5 } },
+  { 5,  7, { 1, 1, 7, 11, 19 } },
+  { 5, 11, { 1, 1, 5, 1, 1 } },
+  { 5, 13, { 1, 1, 1, 3, 11 } },
+  { 5, 14, { 1, 3, 5, 5, 31 } },
+  { 6,  1, { 1, 3, 3, 9, 7, 49 } },
+  { 6, 13, { 1, 1, 1, 15, 21, 21 } },
+  { 6, 16, { 1, 3, 1, 13, 27, 49 } },
+} };
+// clang-format on
+
+/// @brief Expand the direction numbers into the columns of the generator
+/// matrices, most significant bit first
+constexpr std::array<std::array<uint32_t, matrix_size>, dimension_count>
+generateMatrices()
+{
+  std::array<std::array<uint32_t, matrix_size>, dimension_count> matrices{};
+  // The first dimension is the van der Corput sequence
+  for (uint32_t i = 0; i < matrix_size; ++i)
+    matrices[0][i] = 1u << (matrix_size - 1 - i);
+
+  for (uint32_t dim = 1; dim < dimension_count; ++dim) {
+    const DirectionNumbers& dn{ joe_kuo[dim - 1] };
+    std::array<uint32_t, matrix_size>& v{ matrices[dim] };
+    for (uint32_t i = 0; i < dn.degree; ++i)
+      v[i] = dn.m[i] << (matrix_size - 1 - i);
+    for (uint32_t i = dn.degree; i < matrix_size; ++i) {
+      v[i] = v[i - dn.degree] ^ (v[i - dn.degree] >> dn.degree);
+      for (uint32_t k = 1; k < dn.degree; ++k)
+        if ((dn.coefficients >> (dn.degree - 1 - k)) & 1)
+          v[i] ^= v[i - k];
+    }
+  }
+  return matrices;
+}
+} // namespace detail
+
+/// Generator matrices, column `i` of dimension `d` is `matrices[d][i]`
+inline constexpr std::array<std::array<uint32_t, matrix_size>, dimension_count>
+  matrices{ detail::generateMatrices() };
+
+/// @brief Get dimension `dim` of point `index` of the Sobol sequence, as a
+/// 0.32 fixed point number
+constexpr uint32_t sample(uint32_t index, uint32_t dim)
+{
+  uint32_t v{ 0 };
+  for (uint32_t i = 0; index != 0; index >>= 1, ++i)
+    if (index & 1)
+      v ^= matrices[dim][i];
+  return v;
+}
+
+constexpr uint32_t reverseBits(uint32_t v)
+{
+  v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+  v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+  v = ((v >> 4) & 0x0f0f0f0fu) | ((v & 0x0f0f0f0fu) << 4);
+  v = ((v >> 8) & 0x00ff00ffu) | ((v & 0x00ff00ffu) << 8);
+  return (v >> 16) | (v << 16);
+}
+
+/// @brief Nested uniform (Owen) scrambling of a 0.32 fixed point number with
+/// the hash based permutation of Burley, "Practical Hash-based Owen
+/// Scrambling" (2020). Every bit is flipped depending on all bits above it, so
+/// the stratification of the sequence is preserved.
+constexpr uint32_t owenScramble(uint32_t v, uint32_t seed)
+{
+  v = reverseBits(v);
+  v += seed;
+  v ^= v * 0x6c50b47cu;
+  v ^= v * 0xb82f1e52u;
+  v ^= v * 0xc7afe638u;
+  v ^= v * 0x8d22f6e6u;
+  return reverseBits(v);
+}
+
+/// @brief Convert a 0.32 fixed point number to a float in [0, 1)
+constexpr float toFloat(uint32_t v)
+{
+  // Rounding to the nearest float could give exactly one
+  const float f{ static_cast<float>(v) * 0x1p-32f };
+  return f < one_minus_epsilon ? f : one_minus_epsilon;
+}
+} // namespace sobol
+} // namespace eldr
@@ -1,16 +1,22 @@
 #pragma once
 #include <eldr/core/fwd.hpp>
 
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <string>
+#include <thread>
 
 namespace eldr::core {
-/// Mock thread class for now until I have time to implement it
+/// @brief Thread with its own `Logger`. The main thread is registered by
+/// `createContext()`, other threads are spawned with `start()` and inherit a
+/// copy of the logger of the thread that started them, so that `Log()` can be
+/// used from anywhere.
 class Thread {
 public:
   Thread(std::string_view name) : name_(name) {};
 
-  virtual ~Thread() = default;
+  virtual ~Thread();
 
 public:
   void setLogger(std::unique_ptr<Logger> logger)
@@ -22,6 +28,14 @@ public:
 
   [[nodiscard]] Logger* logger() { return logger_.get(); }
 
+  /// @brief Spawn a new OS thread executing `run()`
+  void start();
+
+  /// @brief Wait for `run()` to return
+  void join();
+
+  [[nodiscard]] bool isRunning() const { return thread_.joinable(); }
+
   [[nodiscard]] static Thread* thread();
 
   static void createContext();
@@ -32,5 +46,19 @@ protected:
 private:
   std::string             name_;
   std::unique_ptr<Logger> logger_;
+  std::thread             thread_;
+};
+
+/// @brief Thread executing a given function, named "<prefix><n>"
+class WorkerThread : public Thread {
+public:
+  WorkerThread(std::string_view prefix, std::function<void()> func);
+
+protected:
+  void run() override { func_(); }
+
+private:
+  std::function<void()>        func_;
+  static std::atomic<uint32_t> counter_;
 };
 } // namespace eldr::core
@@ -1,10 +1,14 @@
 #pragma once
+#include <cstdint>
 #include <string>
 
 namespace eldr::core::util {
 
 int terminalWidth();
 
+/// @brief Get the number of logical cores of the machine
+[[nodiscard]] uint32_t coreCount();
+
 std::string infoCopyright();
 
 std::string infoBuild(int thread_count);
@@ -0,0 +1,79 @@
+#pragma once
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/math.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+/// Functions warping uniformly distributed samples on [0, 1)^2 to other
+/// domains, and the densities of the resulting distributions
+namespace eldr::warp {
+using Point2f = CoreAliases<Float>::Point2f;
+using Vec3f   = CoreAliases<Float>::Vec3f;
+
+inline constexpr Float inv_pi{ std::numbers::inv_pi_v<Float> };
+inline constexpr Float inv_four_pi{ 0.25f * std::numbers::inv_pi_v<Float> };
+
+/// @brief Low-distortion concentric mapping from the square to the unit disk
+inline Point2f squareToUniformDiskConcentric(const Point2f& sample)
+{
+  const Float x{ 2.f * sample.x - 1.f };
+  const Float y{ 2.f * sample.y - 1.f };
+  if (x == 0.f and y == 0.f)
+    return Point2f{ 0.f };
+
+  constexpr Float pi_4{ 0.25f * std::numbers::pi_v<Float> };
+  Float           r, phi;
+  if (std::abs(x) > std::abs(y)) {
+    r   = x;
+    phi = pi_4 * (y / x);
+  }
+  else {
+    r   = y;
+    phi = 2.f * pi_4 - pi_4 * (x / y);
+  }
+  return { r * std::cos(phi), r * std::sin(phi) };
+}
+
+/// @brief Cosine-weighted direction on the hemisphere around +z
+inline Vec3f squareToCosineHemisphere(const Point2f& sample)
+{
+  const Point2f p{ squareToUniformDiskConcentric(sample) };
+  const Float   z{ std::sqrt(std::max(0.f, 1.f - p.x * p.x - p.y * p.y)) };
+  return { p.x, p.y, z };
+}
+
+inline Float squareToCosineHemispherePdf(const Vec3f& v)
+{
+  return inv_pi * std::max(0.f, v.z);
+}
+
+/// @brief Uniformly distributed direction on the unit sphere
+inline Vec3f squareToUniformSphere(const Point2f& sample)
+{
+  const Float z{ 1.f - 2.f * sample.y };
+  const Float r{ std::sqrt(std::max(0.f, 1.f - z * z)) };
+  const Float phi{ 2.f * std::numbers::pi_v<Float> * sample.x };
+  return { r * std::cos(phi), r * std::sin(phi), z };
+}
+
+inline Float squareToUniformSpherePdf() { return inv_four_pi; }
+
+/// @brief Inverse of `squareToUniformSphere`. The mapping preserves area, so
+/// a density on the square is `4 pi` times the density on the sphere.
+inline Point2f uniformSphereToSquare(const Vec3f& v)
+{
+  Float phi{ std::atan2(v.y, v.x) * (0.5f * std::numbers::inv_pi_v<Float>) };
+  if (phi < 0.f)
+    phi += 1.f;
+  return { std::clamp(phi, 0.f, 1.f), std::clamp(0.5f - 0.5f * v.z, 0.f, 1.f) };
+}
+
+/// @brief Uniformly distributed barycentric coordinates (b1, b2) on a triangle
+inline Point2f squareToUniformTriangle(const Point2f& sample)
+{
+  const Float t{ std::sqrt(1.f - sample.x) };
+  return { 1.f - t, t * sample.y };
+}
+} // namespace eldr::warp
@@ -0,0 +1,172 @@
+#pragma once
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/ray.hpp>
+#include <eldr/render/bvh.hpp>
+#include <eldr/render/fwd.hpp>
+#include <eldr/render/interaction.hpp>
+#include <eldr/render/packet.hpp>
+#include <eldr/render/triangleblock.hpp>
+#include <eldr/render/widebvh.hpp>
+
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace eldr {
+/// @brief Bottom-level acceleration structure over the triangles of a single
+/// mesh, in object space. Shared by all instances of the mesh.
+class MeshAccel {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  MeshAccel(const Mesh& mesh, const BVHBuildSettings& settings = {});
+
+  /// @brief Intersect an object space ray with the mesh. If a triangle is hit
+  /// closer than `pi.t`, the distance, barycentric coordinates and triangle
+  /// index of `pi` are updated.
+  /// @return Whether `pi` was updated
+  bool rayIntersect(const Ray3f& ray, PreliminaryIntersection& pi) const;
+
+  /// @brief Check whether an object space ray hits any triangle of the mesh
+  [[nodiscard]] bool occluded(const Ray3f& ray) const;
+
+  /// @brief Intersect a packet of object space rays with the mesh, updating
+  /// the intersection of every ray that hits a triangle closer than before
+  /// @param pi One intersection per ray of the packet
+  /// @return Bit mask of the rays whose intersection was updated
+  template <uint32_t Size>
+  uint32_t rayIntersect(const RayPacket<Size>&   packet,
+                        PreliminaryIntersection* pi) const;
+
+  [[nodiscard]] const Mesh&          mesh() const { return *mesh_; }
+  [[nodiscard]] const BoundingBox3f& bbox() const
+  {
+    return quantized_ ? quantized_bvh_.bbox() : bvh_.bbox();
+  }
+
+private:
+  /// Leaves hold at most `BVHBuildSettings::max_leaf_size` triangles, usually
+  /// only a few, so wider blocks would mostly be padding
+  using Block = TriangleBlock4;
+
+  /// @brief Intersect a ray with the triangles of a leaf, updating `pi` on a
+  /// hit closer than `maxt`
+  bool intersectLeaf(const Ray3f&             ray,
+                     uint32_t                 first,
+                     uint32_t                 count,
+                     Float                    maxt,
+                     PreliminaryIntersection& pi) const;
+
+  /// @brief Check whether a ray hits any triangle of a leaf before `maxt`
+  [[nodiscard]] bool
+  occludedLeaf(const Ray3f& ray, uint32_t first, uint32_t count, Float maxt)
+    const;
+
+  void build(const BVHBuildSettings& settings);
+
+  /// @brief Load the BVH and triangles from a cache file
+  /// @return False if the file doesn't exist, is damaged, or was written for
+  /// different geometry or settings
+  bool loadCache(const std::filesystem::path& path,
+                 uint64_t                     geometry_hash,
+                 uint64_t                     settings_hash);
+
+  void saveCache(const std::filesystem::path& path,
+                 uint64_t                     geometry_hash,
+                 uint64_t                     settings_hash) const;
+
+  /// @brief Call `func` with the wide BVH in use
+  template <typename Func> decltype(auto) visitBVH(Func&& func) const
+  {
+    return quantized_ ? func(quantized_bvh_) : func(bvh_);
+  }
+
+  const Mesh* mesh_;
+  /// Only one of the two is built, depending on
+  /// `BVHBuildSettings::quantize_wide_nodes`
+  WideBVH8          bvh_;
+  QuantizedWideBVH8 quantized_bvh_;
+  bool              quantized_;
+  /// Triangles in the order of the primitives of the BVH, whose leaves start
+  /// at a block boundary. A leaf starting at `first` begins at block
+  /// `first / Block::width`.
+  std::vector<Block> blocks_;
+};
+
+/// @brief Two-level ray tracing acceleration structure for a scene. One
+/// `MeshAccel` is built per unique mesh, and a top-level BVH is built over the
+/// `MeshNode`s instancing them. Rays are transformed into object space when
+/// they enter an instance, so memory use scales with the number of unique
+/// meshes rather than with the number of instances.
+class SceneAccel {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  struct Instance {
+    const MeshNode*  node;
+    const MeshAccel* blas;
+    /// Inverse of the world transform of `node`
+    Mat4f to_object;
+  };
+
+  explicit SceneAccel(const Scene& scene, const BVHBuildSettings& settings = {});
+
+  /// @brief Find the closest intersection along `ray`
+  [[nodiscard]] PreliminaryIntersection rayIntersect(const Ray3f& ray) const;
+
+  /// @brief Find the closest intersections of a packet of rays, such as the
+  /// camera rays of neighbouring pixels. Nodes are culled for the whole packet
+  /// at once, and the rays are traced one by one instead if their directions
+  /// are not coherent.
+  /// @param pi Receives one intersection per ray of the packet
+  template <uint32_t Size>
+  void rayIntersect(const RayPacket<Size>&             packet,
+                    std::span<PreliminaryIntersection> pi) const;
+
+  /// @brief Check whether anything is hit along `ray` before `tmax`. Meant for
+  /// shadow rays: traversal ends at the first hit found, and no intersection
+  /// data is computed.
+  [[nodiscard]] bool occluded(const Ray3f& ray, Float tmax) const;
+
+  /// @brief Check whether anything is hit along `ray` before `ray.maxt`
+  [[nodiscard]] bool occluded(const Ray3f& ray) const
+  {
+    return occluded(ray, ray.maxt);
+  }
+
+  /// @brief Compute the full surface interaction of an intersection found by
+  /// `rayIntersect(ray)`
+  [[nodiscard]] SurfaceInteraction
+  computeSurfaceInteraction(const Ray3f&                   ray,
+                            const PreliminaryIntersection& pi) const;
+
+  /// @brief Update the top-level BVH after the world transforms of the scene
+  /// nodes changed (see `SceneNode::refreshTransform`). The BVH is refitted in
+  /// place rather than rebuilt.
+  /// @param rebuild_threshold If the SAH cost of the refitted tree exceeds the
+  /// cost at build time by this factor, the tree is rebuilt instead. Zero
+  /// disables rebuilding.
+  void update(float rebuild_threshold = 0.f);
+
+  /// @brief Get the top-level BVH over the instances
+  [[nodiscard]] const BVH& tlas() const { return tlas_; }
+
+  /// @brief Get the instances referenced by `instance_index` of intersections
+  [[nodiscard]] std::span<const Instance> instances() const
+  {
+    return instances_;
+  }
+
+private:
+  void updateInstanceBounds();
+
+private:
+  std::vector<std::unique_ptr<MeshAccel>> blas_;
+  std::vector<Instance>                   instances_;
+  std::vector<BoundingBox3f>              instance_bounds_;
+  BVH                                     tlas_;
+  BVHBuildSettings                        settings_;
+  /// SAH cost of the top-level BVH right after it was last built
+  float tlas_build_cost_{ 0.f };
+};
+} // namespace eldr
@@ -0,0 +1,45 @@
+#pragma once
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/render/fwd.hpp>
+
+#include <utility>
+
+namespace eldr {
+/// @brief Sampled outgoing direction in the local shading frame
+struct BSDFSample3f {
+  ELDR_IMPORT_CORE_TYPES()
+
+  Vec3f wo{ 0.f, 0.f, 1.f };
+  /// Solid angle density of `wo`, zero if sampling failed
+  Float pdf{ 0.f };
+};
+
+/// @brief Two-sided Lambertian reflectance, derived from the base color of a
+/// glTF material. All directions are in the local shading frame of the
+/// interaction, see `SurfaceInteraction::sh_frame`.
+class BSDF {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  explicit BSDF(const Color3f& reflectance) : reflectance_(reflectance) {}
+
+  /// @brief Evaluate the BSDF times the cosine foreshortening term for the
+  /// outgoing direction `wo`
+  [[nodiscard]] Color3f eval(const SurfaceInteraction& si,
+                             const Vec3f&              wo) const;
+
+  /// @brief Get the solid angle density with which `sample()` generates `wo`
+  [[nodiscard]] Float pdf(const SurfaceInteraction& si, const Vec3f& wo) const;
+
+  /// @brief Importance sample an outgoing direction
+  /// @return The sample and its weight, i.e. `eval() / pdf()`
+  [[nodiscard]] std::pair<BSDFSample3f, Color3f>
+  sample(const SurfaceInteraction& si, const Point2f& sample) const;
+
+  [[nodiscard]] const Color3f& reflectance() const { return reflectance_; }
+
+private:
+  Color3f reflectance_;
+};
+} // namespace eldr
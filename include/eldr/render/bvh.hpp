@@ -0,0 +1,329 @@
+#pragma once
+#include <eldr/core/bbox.hpp>
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/core/ray.hpp>
+#include <eldr/render/packet.hpp>
+
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace eldr {
+
+/// @brief Node of a binary BVH. The two children of an interior node are
+/// always stored next to each other, so only the index of the left child is
+/// kept.
+struct BVHNode {
+  BoundingBox3f bbox;
+  /// Index of the first primitive (leaf) or of the left child (interior)
+  uint32_t offset;
+  /// Number of primitives in the leaf, zero for interior nodes
+  uint32_t prim_count;
+
+  [[nodiscard]] bool isLeaf() const { return prim_count > 0; }
+};
+static_assert(sizeof(BVHNode) == 32, "BVHNode should fit two per cache line");
+
+struct BVHBuildSettings {
+  /// Number of bins per axis used to evaluate the SAH (at most 64)
+  uint32_t bin_count{ 32 };
+  /// Nodes with more primitives than this are always split, if possible
+  uint32_t max_leaf_size{ 8 };
+  /// Cost of traversing a node relative to intersecting a primitive
+  float traversal_cost{ 1.f };
+  float intersection_cost{ 1.f };
+  /// Subtrees with fewer primitives than this are built on a single thread
+  uint32_t parallel_threshold{ 4096 };
+  /// Store the wide BVHs of meshes with quantized nodes (see
+  /// `QuantizedWideBVHNode`), for less memory traffic on large scenes
+  bool quantize_wide_nodes{ false };
+  /// Directory the BVHs of meshes are cached in across runs, keyed by a hash
+  /// of the mesh geometry and these settings. Empty disables the cache.
+  std::filesystem::path cache_dir;
+};
+
+struct BVHStats {
+  float    build_time_ms{ 0.f };
+  /// Duration of the last refit, if any
+  float    refit_time_ms{ 0.f };
+  size_t   prim_count{ 0 };
+  size_t   node_count{ 0 };
+  size_t   leaf_count{ 0 };
+  uint32_t max_depth{ 0 };
+  uint32_t max_leaf_size{ 0 };
+  float    avg_leaf_size{ 0.f };
+  /// SAH cost of the whole tree, normalized by the root surface area. Kept up
+  /// to date by refits.
+  float sah_cost{ 0.f };
+};
+
+/// @brief Binary bounding volume hierarchy built with a binned SAH. The BVH
+/// only knows about the bounding boxes of its primitives, the primitives
+/// themselves are intersected through a callback during traversal.
+class BVH {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  /// Traversal stack size, the builder never creates deeper trees than this
+  static constexpr uint32_t max_depth{ 64 };
+
+  BVH() = default;
+  BVH(std::span<const BoundingBox3f> prim_bounds,
+      const BVHBuildSettings&        settings);
+
+  /// @brief (Re)build the hierarchy over primitives with the given bounds.
+  /// Subtrees are built in parallel on the global thread pool.
+  void build(std::span<const BoundingBox3f> prim_bounds,
+             const BVHBuildSettings&        settings);
+
+  /// @brief Update the node bounds for primitives that moved, keeping the
+  /// topology of the tree. Much cheaper than a rebuild, but the tree quality
+  /// degrades as primitives move away from where they were at build time.
+  /// Large trees are refitted in parallel.
+  /// @param prim_bounds New bounds of the primitives given to `build()`, in
+  /// the same order
+  void refit(std::span<const BoundingBox3f> prim_bounds);
+
+  /// @brief Compute the SAH cost of the tree in its current state, normalized
+  /// by the root surface area
+  [[nodiscard]] float sahCost() const;
+
+  [[nodiscard]] bool empty() const { return nodes_.empty(); }
+
+  /// @brief Get the bounding box of the whole hierarchy
+  [[nodiscard]] const BoundingBox3f& bbox() const { return nodes_[0].bbox; }
+
+  [[nodiscard]] std::span<const BVHNode> nodes() const { return nodes_; }
+
+  /// @brief Get the primitive indices referenced by the leaves
+  [[nodiscard]] std::span<const uint32_t> primIndices() const
+  {
+    return prim_indices_;
+  }
+
+  /// @brief Get statistics gathered during the last build
+  [[nodiscard]] const BVHStats& stats() const { return stats_; }
+
+  /// @brief Find the closest primitive hit along `ray`.
+  /// @param intersect_prim Callable with signature
+  /// `bool(uint32_t prim_index, Float& maxt)`. It should intersect the
+  /// primitive, and if it is hit closer than `maxt`, update `maxt` and return
+  /// true.
+  /// @return Whether any primitive was hit
+  template <typename Func>
+  bool traverse(const Ray3f& ray, Func&& intersect_prim) const;
+
+  /// @brief Check whether any primitive is hit along `ray`, stopping at the
+  /// first one found. Cheaper than `traverse()` since children are not
+  /// ordered by distance and the ray extent never shrinks.
+  /// @param intersect_prim Callable with signature
+  /// `bool(uint32_t prim_index, Float maxt)`, returning whether the primitive
+  /// is hit before `maxt`
+  template <typename Func>
+  bool occluded(const Ray3f& ray, Func&& intersect_prim) const;
+
+  /// @brief Traverse the hierarchy with a coherent packet of rays, culling
+  /// nodes against the packet frustum. The nodes are visited roughly front to
+  /// back.
+  /// @param intersect_prim Callable with signature `Float(uint32_t
+  /// prim_index)`. It should intersect the primitive with the rays of the
+  /// packet and return the largest distance any ray is still interested in,
+  /// i.e. the farthest closest hit so far, or infinity while a ray has none.
+  template <typename Func>
+  void traversePacket(const PacketFrustum& frustum,
+                      Float                maxt,
+                      Func&&               intersect_prim) const;
+
+private:
+  struct BuildContext;
+  void buildRecursive(BuildContext&        ctx,
+                      uint32_t             node_index,
+                      const BoundingBox3f& centroid_bbox,
+                      uint32_t             begin,
+                      uint32_t             end,
+                      uint32_t             depth);
+  BoundingBox3f refitRecursive(std::span<const BoundingBox3f> prim_bounds,
+                               uint32_t                       node_index,
+                               uint32_t                       depth,
+                               uint32_t                       spawn_depth);
+  void          computeStats();
+
+private:
+  std::vector<BVHNode>  nodes_;
+  std::vector<uint32_t> prim_indices_;
+  BVHBuildSettings      settings_;
+  BVHStats              stats_;
+};
+
+namespace detail {
+/// @brief Ray-box slab test returning the entry distance in `tnear`
+inline bool intersectBBox(const BoundingBox3f&           bbox,
+                          const CoreAliases<Float>::Point3f& o,
+                          const CoreAliases<Float>::Vec3f&   d_rcp,
+                          Float                          maxt,
+                          Float&                         tnear)
+{
+  const auto t0{ (bbox.min - o) * d_rcp };
+  const auto t1{ (bbox.max - o) * d_rcp };
+  const auto tmin{ glm::min(t0, t1) };
+  const auto tmax{ glm::max(t0, t1) };
+  tnear = std::max(std::max(tmin.x, tmin.y), std::max(tmin.z, Float(0)));
+  const Float tfar{ std::min(std::min(tmax.x, tmax.y), std::min(tmax.z, maxt)) };
+  return tnear <= tfar;
+}
+} // namespace detail
+
+template <typename Func>
+bool BVH::traverse(const Ray3f& ray, Func&& intersect_prim) const
+{
+  if (unlikely(nodes_.empty()))
+    return false;
+
+  struct StackEntry {
+    uint32_t node;
+    Float    tnear;
+  };
+  StackEntry stack[max_depth];
+  uint32_t   stack_size{ 0 };
+
+  const Vec3f d_rcp{ safeRcp(ray.d) };
+  Float       maxt{ ray.maxt };
+  bool        hit{ false };
+
+  Float tnear;
+  if (not detail::intersectBBox(nodes_[0].bbox, ray.o, d_rcp, maxt, tnear))
+    return false;
+  stack[stack_size++] = { 0, tnear };
+
+  while (stack_size > 0) {
+    const StackEntry entry{ stack[--stack_size] };
+    // The closest hit may have moved since this node was pushed
+    if (entry.tnear > maxt)
+      continue;
+    const BVHNode& node{ nodes_[entry.node] };
+
+    if (node.isLeaf()) {
+      for (uint32_t i = 0; i < node.prim_count; ++i) {
+        if (intersect_prim(prim_indices_[node.offset + i], maxt))
+          hit = true;
+      }
+      continue;
+    }
+
+    Float      t_left, t_right;
+    const bool hit_left{ detail::intersectBBox(
+      nodes_[node.offset].bbox, ray.o, d_rcp, maxt, t_left) };
+    const bool hit_right{ detail::intersectBBox(
+      nodes_[node.offset + 1].bbox, ray.o, d_rcp, maxt, t_right) };
+
+    // Push the farther child first so that the closer one is visited first
+    if (hit_left and hit_right) {
+      if (t_left <= t_right) {
+        stack[stack_size++] = { node.offset + 1, t_right };
+        stack[stack_size++] = { node.offset, t_left };
+      }
+      else {
+        stack[stack_size++] = { node.offset, t_left };
+        stack[stack_size++] = { node.offset + 1, t_right };
+      }
+    }
+    else if (hit_left) {
+      stack[stack_size++] = { node.offset, t_left };
+    }
+    else if (hit_right) {
+      stack[stack_size++] = { node.offset + 1, t_right };
+    }
+  }
+  return hit;
+}
+
+template <typename Func>
+void BVH::traversePacket(const PacketFrustum& frustum,
+                         Float                maxt,
+                         Func&&               intersect_prim) const
+{
+  if (unlikely(nodes_.empty()))
+    return;
+
+  struct StackEntry {
+    uint32_t node;
+    Float    tnear;
+  };
+  StackEntry stack[max_depth];
+  uint32_t   stack_size{ 0 };
+
+  Float tnear;
+  if (not frustum.intersect(nodes_[0].bbox, maxt, tnear))
+    return;
+  stack[stack_size++] = { 0, tnear };
+
+  while (stack_size > 0) {
+    const StackEntry entry{ stack[--stack_size] };
+    if (entry.tnear > maxt)
+      continue;
+    const BVHNode& node{ nodes_[entry.node] };
+
+    if (node.isLeaf()) {
+      for (uint32_t i = 0; i < node.prim_count; ++i)
+        maxt = intersect_prim(prim_indices_[node.offset + i]);
+      continue;
+    }
+
+    Float      t_left, t_right;
+    const bool hit_left{ frustum.intersect(
+      nodes_[node.offset].bbox, maxt, t_left) };
+    const bool hit_right{ frustum.intersect(
+      nodes_[node.offset + 1].bbox, maxt, t_right) };
+    if (hit_left and hit_right) {
+      if (t_left <= t_right) {
+        stack[stack_size++] = { node.offset + 1, t_right };
+        stack[stack_size++] = { node.offset, t_left };
+      }
+      else {
+        stack[stack_size++] = { node.offset, t_left };
+        stack[stack_size++] = { node.offset + 1, t_right };
+      }
+    }
+    else if (hit_left) {
+      stack[stack_size++] = { node.offset, t_left };
+    }
+    else if (hit_right) {
+      stack[stack_size++] = { node.offset + 1, t_right };
+    }
+  }
+}
+
+template <typename Func>
+bool BVH::occluded(const Ray3f& ray, Func&& intersect_prim) const
+{
+  if (unlikely(nodes_.empty()))
+    return false;
+
+  uint32_t stack[max_depth];
+  uint32_t stack_size{ 0 };
+
+  const Vec3f d_rcp{ safeRcp(ray.d) };
+  Float       tnear;
+  if (not detail::intersectBBox(nodes_[0].bbox, ray.o, d_rcp, ray.maxt, tnear))
+    return false;
+  stack[stack_size++] = 0;
+
+  while (stack_size > 0) {
+    const BVHNode& node{ nodes_[stack[--stack_size]] };
+    if (node.isLeaf()) {
+      for (uint32_t i = 0; i < node.prim_count; ++i) {
+        if (intersect_prim(prim_indices_[node.offset + i], ray.maxt))
+          return true;
+      }
+      continue;
+    }
+    for (uint32_t child = node.offset; child < node.offset + 2; ++child) {
+      if (detail::intersectBBox(
+            nodes_[child].bbox, ray.o, d_rcp, ray.maxt, tnear))
+        stack[stack_size++] = child;
+    }
+  }
+  return false;
+}
+} // namespace eldr
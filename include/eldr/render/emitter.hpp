@@ -0,0 +1,168 @@
+#pragma once
+#include <eldr/core/alias.hpp>
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/render/fwd.hpp>
+#include <eldr/render/lightbvh.hpp>
+
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace eldr {
+/// @brief Point sampled on an emitter, as seen from a reference point
+struct DirectionSample3f {
+  ELDR_IMPORT_CORE_TYPES()
+
+  /// Position of the sample, meaningless for environment emitters
+  Point3f p{ 0.f };
+  /// Surface normal at `p`
+  Vec3f n{ 0.f, 0.f, 1.f };
+  /// Normalized direction from the reference point towards `p`
+  Vec3f d{ 0.f, 0.f, 1.f };
+  /// Distance from the reference point to `p`, infinite for environment
+  /// emitters
+  Float dist{ 0.f };
+  /// Solid angle density of the sample, zero if sampling failed
+  Float          pdf{ 0.f };
+  const Emitter* emitter{ nullptr };
+};
+
+class Emitter {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  virtual ~Emitter() = default;
+
+  /// @brief Sample a point on the emitter that is visible from `ref`, ignoring
+  /// occlusion
+  /// @return The sample and the emitted radiance divided by its density
+  [[nodiscard]] virtual std::pair<DirectionSample3f, Color3f>
+  sampleDirection(const Point3f& ref, const Point2f& sample) const = 0;
+
+  /// @brief Get the solid angle density with which `sampleDirection()` would
+  /// have generated `ds` from `ref`
+  [[nodiscard]] virtual Float
+  pdfDirection(const Point3f& ref, const DirectionSample3f& ds) const = 0;
+
+  /// @brief Get the radiance emitted towards the origin of the ray that
+  /// produced `si`. For environment emitters `si` belongs to a ray that left
+  /// the scene, and `si.wi` is in world space.
+  [[nodiscard]] virtual Color3f eval(const SurfaceInteraction& si) const = 0;
+
+  /// @brief Whether the emitter surrounds the scene at infinite distance
+  [[nodiscard]] virtual bool isEnvironment() const { return false; }
+
+  /// @brief Get the bounds of the emitted light for the `LightBVH`, nothing
+  /// for emitters that can't be bounded, like environments
+  [[nodiscard]] virtual std::optional<LightBounds> bounds() const
+  {
+    return std::nullopt;
+  }
+};
+
+/// @brief Diffuse area light covering one emissive surface of a mesh
+/// instance. Light leaves the front side of the triangles only.
+class AreaEmitter final : public Emitter {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  /// @param node Instance of the mesh, whose world transform must be up to
+  /// date
+  /// @param surface_index Index of the emissive surface in `Mesh::surfaces()`
+  /// @param radiance Emitted radiance
+  AreaEmitter(const MeshNode& node,
+              uint32_t        surface_index,
+              const Color3f&  radiance);
+
+  [[nodiscard]] std::pair<DirectionSample3f, Color3f>
+  sampleDirection(const Point3f& ref, const Point2f& sample) const override;
+
+  [[nodiscard]] Float pdfDirection(const Point3f&           ref,
+                                   const DirectionSample3f& ds) const override;
+
+  [[nodiscard]] Color3f eval(const SurfaceInteraction& si) const override;
+
+  /// @brief Get the world space surface area of the emitter
+  [[nodiscard]] Float area() const { return area_; }
+
+  [[nodiscard]] std::optional<LightBounds> bounds() const override
+  {
+    return bounds_;
+  }
+
+private:
+  struct Triangle {
+    Point3f p0;
+    Vec3f   e1;
+    Vec3f   e2;
+    /// Normalized geometric normal
+    Vec3f n;
+  };
+
+  Color3f               radiance_;
+  std::vector<Triangle> triangles_;
+  /// For picking triangles proportional to their area
+  AliasTable  triangle_table_;
+  Float       area_{ 0.f };
+  LightBounds bounds_;
+};
+
+/// @brief Environment emitter with the same radiance in all directions
+class ConstantEmitter final : public Emitter {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  explicit ConstantEmitter(const Color3f& radiance) : radiance_(radiance) {}
+
+  [[nodiscard]] std::pair<DirectionSample3f, Color3f>
+  sampleDirection(const Point3f& ref, const Point2f& sample) const override;
+
+  [[nodiscard]] Float pdfDirection(const Point3f&           ref,
+                                   const DirectionSample3f& ds) const override;
+
+  [[nodiscard]] Color3f eval(const SurfaceInteraction& si) const override;
+
+  [[nodiscard]] bool isEnvironment() const override { return true; }
+
+private:
+  Color3f radiance_;
+};
+
+/// @brief Environment emitter with the radiance given by an image in
+/// equirectangular projection. The top row of the image is straight up (+z)
+/// and the left edge faces +x. Directions are sampled proportional to the
+/// luminance of the pixels.
+class EnvironmentEmitter final : public Emitter {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  /// @param bitmap Image of the environment, linear if stored as floats and
+  /// sRGB encoded otherwise
+  /// @param scale Factor applied to the radiance of all pixels
+  explicit EnvironmentEmitter(const Bitmap& bitmap, Float scale = 1.f);
+
+  [[nodiscard]] std::pair<DirectionSample3f, Color3f>
+  sampleDirection(const Point3f& ref, const Point2f& sample) const override;
+
+  [[nodiscard]] Float pdfDirection(const Point3f&           ref,
+                                   const DirectionSample3f& ds) const override;
+
+  [[nodiscard]] Color3f eval(const SurfaceInteraction& si) const override;
+
+  [[nodiscard]] bool isEnvironment() const override { return true; }
+
+private:
+  /// @brief Get the pixel seen in direction `d`
+  [[nodiscard]] Vec2u pixel(const Vec3f& d) const;
+
+  /// @brief Convert the probability of picking a pixel to the solid angle
+  /// density of a direction within it
+  [[nodiscard]] Float solidAnglePdf(const Vec2u& pixel, Float sin_theta) const;
+
+  Vec2u                size_;
+  std::vector<Color3f> radiance_;
+  /// For picking pixels by their luminance weighted by their solid angle
+  AliasTable2D pixel_table_;
+};
+} // namespace eldr
@@ -0,0 +1,48 @@
+#pragma once
+#include <eldr/core/bitmap.hpp>
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/render/fwd.hpp>
+#include <eldr/render/imageblock.hpp>
+
+#include <memory>
+
+namespace eldr {
+/// @brief Image being rendered. Worker threads accumulate samples into their
+/// own `ImageBlock`s and merge them into the film when a block is done.
+/// Merging uses atomic additions instead of a lock, since blocks only overlap
+/// along their borders and contention is rare.
+class Film {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  Film(const Vec2u& size, std::shared_ptr<ReconstructionFilter> filter);
+
+  [[nodiscard]] const Vec2u&                size() const { return size_; }
+  [[nodiscard]] const ReconstructionFilter& filter() const { return *filter_; }
+
+  /// @brief Create a block, with border, for rendering tiles of up to `size`
+  /// pixels
+  [[nodiscard]] ImageBlock createBlock(const Vec2u& size) const
+  {
+    return ImageBlock{ size, *filter_ };
+  }
+
+  /// @brief Add the contents of a block to the film. Can be called
+  /// concurrently from any number of threads.
+  void put(const ImageBlock& block);
+
+  /// @brief Reset the film to black
+  void clear();
+
+  /// @brief Normalize the accumulated samples by their filter weights
+  /// @return Linear RGB image
+  [[nodiscard]] Bitmap develop() const;
+
+private:
+  Vec2u                                 size_;
+  std::shared_ptr<ReconstructionFilter> filter_;
+  /// Accumulated samples, in the same layout as the blocks but without border
+  ImageBlock storage_;
+};
+} // namespace eldr
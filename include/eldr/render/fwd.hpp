@@ -2,26 +2,38 @@
 #include <cstdint>
 namespace eldr {
 // struct BSDFContext;
-// class BSDF;
+class BSDF;
 // class OptixDenoiser;
-// class Emitter;
+class Emitter;
+class LightBVH;
+struct LightBounds;
 // class Endpoint;
-// class Film;
-// class ImageBlock;
+class Film;
+class ImageBlock;
 // class Integrator;
 // class SamplingIntegrator;
+class PathIntegrator;
+class SDTree;
+class DirectionalQuadtree;
+struct WavefrontQueues;
 // class MonteCarloIntegrator;
 // class AdjointIntegrator;
 // class Medium;
 class Mesh;
+class BVH;
+template <uint32_t Width, bool Quantized = false> class WideBVH;
+class SceneAccel;
 enum class MaterialType : uint8_t;
 // class MicrofacetDistribution;
-// class ReconstructionFilter;
-// class Sampler;
+class ReconstructionFilter;
+class Sampler;
 struct Scene;
+struct SceneNode;
+struct MeshNode;
 // class Sensor;
 // class PhaseFunction;
 // class ProjectiveCamera;
+class PerspectiveCamera;
 class Shape;
 // class ShapeGroup;
 // class ShapeKDTree;
@@ -30,13 +42,13 @@ class Shape;
 // class VolumeGrid;
 // class MeshAttribute;
 //
-// struct DirectionSample;
+struct DirectionSample3f;
 // struct PositionSample;
-// struct BSDFSample3;
+struct BSDFSample3f;
 // struct SilhouetteSample;
 // struct PhaseFunctionContext;
 // struct Interaction;
 // struct MediumInteraction;
-// struct SurfaceInteraction;
-// struct PreliminaryIntersection;
+struct SurfaceInteraction;
+struct PreliminaryIntersection;
 } // namespace eldr
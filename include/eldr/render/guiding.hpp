@@ -0,0 +1,131 @@
+#pragma once
+#include <eldr/core/bbox.hpp>
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/render/fwd.hpp>
+
+#include <array>
+#include <atomic>
+#include <vector>
+
+namespace eldr {
+/// @brief Piecewise constant distribution of incident radiance over the
+/// sphere of directions, for path guiding. Directions are mapped to the unit
+/// square by the area preserving cylindrical mapping of
+/// `warp::squareToUniformSphere`, which a quadtree then subdivides more finely
+/// where more light arrives.
+///
+/// Two copies of the tree are kept: samples are drawn from the one learned in
+/// the previous training iteration, while the radiance of the current one is
+/// recorded into the other. Recording only adds to the energy of existing
+/// nodes with atomics and can be called concurrently from any number of
+/// threads, the structure only changes in `refine()`.
+class DirectionalQuadtree {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  DirectionalQuadtree();
+
+  /// @brief Whether any radiance was learned yet. Until then samples are
+  /// uniform on the sphere.
+  [[nodiscard]] bool trained() const { return trained_; }
+
+  /// @brief Sample a direction in proportion to the learned radiance
+  /// @param u Uniform sample in [0, 1)^2
+  [[nodiscard]] Vec3f sample(Point2f u) const;
+
+  /// @brief Get the solid angle density of `sample` generating `d`
+  [[nodiscard]] Float pdf(const Vec3f& d) const;
+
+  /// @brief Record an estimate of the radiance arriving from `d`, divided by
+  /// the density it was sampled with. Thread-safe.
+  void record(const Vec3f& d, Float value);
+
+  /// @brief Get the number of estimates recorded since the last refinement
+  [[nodiscard]] uint64_t sampleCount() const { return sample_count_; }
+
+  /// @brief Sample from the radiance recorded since the last call, and
+  /// restructure the recording tree: nodes holding more than `threshold` of
+  /// the total energy are split, all others merged. Not thread-safe.
+  void refine(Float threshold, uint32_t max_depth);
+
+private:
+  friend class SDTree;
+
+  struct Node {
+    /// Energy of the four quadrants, indexed by `x + 2 * y`
+    std::array<float, 4> sum{};
+    /// Index of the node subdividing each quadrant, zero for leaves since the
+    /// root is never a child
+    std::array<uint32_t, 4> child{};
+
+    [[nodiscard]] float total() const
+    {
+      return sum[0] + sum[1] + sum[2] + sum[3];
+    }
+  };
+
+  std::vector<Node> sampling_;
+  std::vector<Node> building_;
+  bool              trained_{ false };
+  alignas(std::atomic_ref<uint64_t>::required_alignment) uint64_t
+    sample_count_{ 0 };
+};
+
+/// @brief Spatio-directional tree for path guiding, after Müller et al. 2017,
+/// "Practical Path Guiding for Efficient Light-Transport Simulation". A
+/// binary tree splits the scene bounds in half along alternating axes, and
+/// every leaf holds a `DirectionalQuadtree` of the light arriving in its
+/// region.
+///
+/// The tree is trained iteratively: during an iteration paths sample from
+/// the distributions learned so far and record the radiance they find, then
+/// `refine()` subdivides regions that received many samples and makes the
+/// recorded radiance the new distributions. With the number of samples
+/// doubling from one iteration to the next, the resolution follows the
+/// amount of data available.
+class SDTree {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  /// Samples a leaf needs to receive in the first iteration to be split
+  static constexpr Float spatial_threshold{ 12000.f };
+  /// Fraction of the energy of a quadtree a node needs to be subdivided
+  static constexpr Float directional_threshold{ 0.01f };
+  static constexpr uint32_t max_directional_depth{ 20 };
+
+  explicit SDTree(const BoundingBox3f& bounds);
+
+  /// @brief Get the directional distribution of the region containing `p`
+  [[nodiscard]] const DirectionalQuadtree& quadtree(const Point3f& p) const
+  {
+    return quadtrees_[leaf(p)];
+  }
+  [[nodiscard]] DirectionalQuadtree& quadtree(const Point3f& p)
+  {
+    return quadtrees_[leaf(p)];
+  }
+
+  /// @brief End training iteration `iteration` (starting from zero). Must
+  /// not run concurrently with anything else.
+  void refine(uint32_t iteration);
+
+  [[nodiscard]] size_t leafCount() const { return quadtrees_.size(); }
+
+private:
+  struct Node {
+    /// Children below and above the middle of `axis`, zero for leaves
+    std::array<uint32_t, 2> child{};
+    uint32_t                quadtree{ 0 };
+    uint8_t                 axis{ 0 };
+  };
+
+  /// @brief Find the index of the quadtree of the leaf containing `p`
+  [[nodiscard]] uint32_t leaf(const Point3f& p) const;
+
+  /// Cube around the scene, so that the regions stay roughly cubical
+  BoundingBox3f                    bounds_;
+  std::vector<Node>                nodes_;
+  std::vector<DirectionalQuadtree> quadtrees_;
+};
+} // namespace eldr
@@ -0,0 +1,77 @@
+#pragma once
+#include <eldr/core/arrayutils.hpp>
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/render/fwd.hpp>
+
+namespace eldr {
+/// @brief Rectangular block of pixels accumulating filtered radiance
+/// samples, e.g. the tile a worker thread is currently rendering. Samples
+/// near the edge spill into a border around the block as wide as the filter
+/// requires, so that blocks of neighbouring tiles overlap and blend without
+/// seams once merged into the `Film`.
+///
+/// Channels are stored as separate planes (SoA). Every row starts on a cache
+/// line, which keeps splatting and merging to a few contiguous, vectorizable
+/// streams per row.
+class ImageBlock {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  /// Channels of a block: R, G, B and the sum of the filter weights
+  static constexpr uint32_t channel_count{ 4 };
+  static constexpr uint32_t weight_channel{ 3 };
+  /// Largest supported filter border, in pixels
+  static constexpr uint32_t max_border_size{ 4 };
+
+  /// @param size Size of the block without border
+  /// @param filter Filter to splat samples with, must outlive the block
+  /// @param border Whether to allocate a border for the filter
+  ImageBlock(const Vec2u&                size,
+             const ReconstructionFilter& filter,
+             bool                        border = true);
+
+  /// @brief Set the position of the top left pixel (excluding the border) on
+  /// the film
+  void setOffset(const Vec2u& offset) { offset_ = offset; }
+
+  /// @brief Change the size of the block. Memory is only reallocated when the
+  /// block grows, so blocks can be reused for tiles of varying sizes. The
+  /// contents are undefined afterwards.
+  void setSize(const Vec2u& size);
+
+  /// @brief Set all channels to zero
+  void clear();
+
+  /// @brief Splat a radiance sample
+  /// @param pos Position of the sample on the film, in pixels
+  void put(const Point2f& pos, const Color3f& value);
+
+  [[nodiscard]] const Vec2u& offset() const { return offset_; }
+  [[nodiscard]] const Vec2u& size() const { return size_; }
+  [[nodiscard]] uint32_t     borderSize() const { return border_size_; }
+
+  /// @brief Get the size of the stored region, including the border
+  [[nodiscard]] Vec2u fullSize() const
+  {
+    return size_ + Vec2u{ 2 * border_size_ };
+  }
+
+  /// @brief Get the distance between rows of a channel plane, in floats
+  [[nodiscard]] size_t rowStride() const { return row_stride_; }
+
+  /// @brief Get the plane of a channel, starting at the top left pixel of the
+  /// border
+  [[nodiscard]] float*       channel(uint32_t index);
+  [[nodiscard]] const float* channel(uint32_t index) const;
+
+private:
+  const ReconstructionFilter* filter_;
+  Vec2u                       offset_{ 0 };
+  Vec2u                       size_{ 0 };
+  uint32_t                    border_size_;
+  size_t                      row_stride_{ 0 };
+  size_t                      plane_size_{ 0 };
+  AlignedVector<float>        data_;
+};
+} // namespace eldr
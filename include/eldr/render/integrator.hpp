@@ -0,0 +1,269 @@
+#pragma once
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/core/ray.hpp>
+#include <eldr/render/fwd.hpp>
+#include <eldr/render/interaction.hpp>
+
+#include <optional>
+#include <vector>
+
+namespace eldr {
+/// @brief Order in which the tiles of an image are handed out to workers
+enum class TileOrder : uint8_t {
+  /// Row by row, from the top left
+  Scanline,
+  /// Along a Z-order curve, so consecutive tiles are spatially close and
+  /// share more of the scene data in cache
+  Morton,
+  /// Outwards from the center of the image, where the subject usually is
+  Spiral,
+};
+
+/// @brief Rectangular block of pixels of an image
+struct Tile {
+  ELDR_IMPORT_CORE_TYPES()
+
+  Vec2u offset;
+  Vec2u size;
+};
+
+/// @brief Split an image into tiles of at most `tile_size` x `tile_size`
+/// pixels, sorted in the order they should be rendered in
+[[nodiscard]] std::vector<Tile>
+generateTiles(const CoreAliases<Float>::Vec2u& image_size,
+              uint32_t                         tile_size,
+              TileOrder                        order);
+
+/// @brief How the path tracer organizes the work within a tile
+enum class ExecutionMode : uint8_t {
+  /// Every sample traces its whole path before the next one starts
+  Megakernel,
+  /// All paths of a tile advance together, one stage at a time, with rays
+  /// sorted for coherence in between (see `WavefrontQueues`)
+  Wavefront,
+};
+
+/// @brief Unidirectional path tracer with next event estimation and multiple
+/// importance sampling. The image is split into tiles which the workers of the
+/// global thread pool pick up one at a time, so the load stays balanced no
+/// matter how unevenly the cost is spread over the image.
+///
+/// With adaptive sampling the image is rendered in passes. After each pass a
+/// tile is tested for convergence using a running variance estimate of each of
+/// its pixels, and tiles whose noisiest pixel falls below the error threshold
+/// are not scheduled again.
+///
+/// With path guiding, the first passes train an `SDTree` on the radiance the
+/// paths find, and the directions of later bounces are sampled from a mix of
+/// the BSDF and the learned distribution of incident light.
+///
+/// With ReSTIR, the direct light at the first hit of the camera rays is
+/// instead estimated by resampling emitter candidates, and reusing the
+/// resulting reservoirs over neighbouring pixels and from one sample per
+/// pixel to the next. Each sample per pixel is then rendered as a frame over
+/// the whole film.
+class PathIntegrator {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  /// Upper bound of `Settings::restir_spatial_neighbors`
+  static constexpr uint32_t max_restir_spatial_neighbors{ 32 };
+
+  struct Settings {
+    /// Samples per pixel, the maximum when sampling adaptively
+    uint32_t spp{ 16 };
+    /// Maximum number of scattering events along a path
+    uint32_t max_depth{ 8 };
+    /// Depth from which paths are terminated with Russian roulette
+    uint32_t rr_depth{ 4 };
+    /// Edge length of the square tiles in pixels
+    uint32_t  tile_size{ 32 };
+    TileOrder tile_order{ TileOrder::Spiral };
+    /// Relative error of the pixel estimates below which a tile stops
+    /// receiving samples. Zero disables adaptive sampling.
+    Float adaptive_threshold{ 0.01f };
+    /// Samples per pixel rendered before each convergence test
+    uint32_t adaptive_pass_spp{ 16 };
+    ExecutionMode mode{ ExecutionMode::Megakernel };
+    /// Maximum number of paths a worker keeps in flight in wavefront mode
+    uint32_t wavefront_size{ 1u << 16 };
+    /// Number of camera rays traced together as a packet in wavefront mode:
+    /// 8, 16, or 0 to trace them one by one
+    uint32_t packet_size{ 16 };
+    /// Pick emitters for next event estimation with the light BVH of the
+    /// scene instead of uniformly
+    bool use_light_bvh{ true };
+    /// Number of training passes for path guiding, zero disables guiding.
+    /// Pass `k` renders `2^k` samples per pixel and refines the guiding tree
+    /// afterwards, the remaining samples use the final tree. Megakernel mode
+    /// only.
+    uint32_t guiding_passes{ 0 };
+    /// Probability of sampling the BSDF instead of the guiding distribution
+    /// at a bounce
+    Float guiding_bsdf_fraction{ 0.5f };
+    /// Number of emitter candidates resampled per pixel for the direct light
+    /// at the first hit, zero disables ReSTIR. Megakernel mode only, and not
+    /// combined with adaptive sampling or guiding.
+    uint32_t restir_candidates{ 0 };
+    /// Number of neighbouring pixels whose reservoirs are reused, clamped to
+    /// `max_restir_spatial_neighbors`
+    uint32_t restir_spatial_neighbors{ 5 };
+    /// Radius in pixels neighbours are picked in
+    Float restir_spatial_radius{ 5.f };
+    /// Limit of the candidate count carried over from the previous sample,
+    /// as a multiple of the new candidates. Zero disables temporal reuse.
+    Float restir_history_limit{ 20.f };
+  };
+
+  explicit PathIntegrator(const Settings& settings);
+
+  /// @brief Render the scene as seen by `camera`, adding the samples to
+  /// `film`
+  /// @param sampler Prototype of the sampler, cloned for every worker
+  void render(const Scene&             scene,
+              const SceneAccel&        accel,
+              const PerspectiveCamera& camera,
+              const Sampler&           sampler,
+              Film&                    film) const;
+
+  /// @brief Estimate the radiance arriving along `ray`
+  /// @param guide Distributions to guide the bounces with, if not null
+  /// @param train Whether to record the radiance found into `guide`
+  [[nodiscard]] Color3f sample(const Scene&      scene,
+                               const SceneAccel& accel,
+                               const Ray3f&      ray,
+                               Sampler&          sampler,
+                               SDTree*           guide = nullptr,
+                               bool              train = false) const;
+
+  [[nodiscard]] const Settings& settings() const { return settings_; }
+
+private:
+  /// @brief State carried along a path from one vertex to the next
+  struct PathState {
+    /// Ray to trace next
+    Ray3f   ray;
+    Color3f throughput{ 1.f };
+    /// Radiance gathered so far
+    Color3f result{ 0.f };
+    /// Origin, normal and BSDF density of the last bounce, for weighting
+    /// emitters hit by BSDF sampling against next event estimation
+    Point3f prev_p{ 0.f };
+    Vec3f   prev_n{ 0.f };
+    Float   prev_bsdf_pdf{ 1.f };
+  };
+
+  /// @brief Next event estimation sample, to be added to the path result if
+  /// the shadow ray is unoccluded
+  struct EmitterSample {
+    Ray3f   shadow_ray;
+    Color3f value;
+  };
+
+  /// @brief Continue a path from `depth` until it terminates
+  /// @return The radiance gathered along the path, `state.result`
+  Color3f trace(const Scene&      scene,
+                const SceneAccel& accel,
+                PathState&        state,
+                uint32_t          depth,
+                Sampler&          sampler,
+                SDTree*           guide,
+                bool              train) const;
+
+  /// @brief Path vertex whose incident radiance is recorded for guiding
+  struct GuidingVertex {
+    Point3f p;
+    /// Direction the path continued in
+    Vec3f d;
+    /// Path throughput including the bounce, which the radiance found later
+    /// along the path is divided by
+    Color3f throughput;
+    Color3f radiance{ 0.f };
+    /// Density `d` was sampled with
+    Float pdf;
+  };
+
+  /// @brief Advance a path by one vertex: add the emission at `pi`, sample an
+  /// emitter and continue the path by sampling the BSDF. Shared by both
+  /// execution modes, which only differ in how they schedule the ray queries.
+  /// @param pi Intersection of `state.ray` with the scene
+  /// @param emitter_sample Set if an emitter was sampled
+  /// @param guide Distributions to guide the BSDF sampling with, if not null
+  /// @return Whether the path continues with the updated `state.ray`
+  bool shade(const Scene&                   scene,
+             const SceneAccel&              accel,
+             const PreliminaryIntersection& pi,
+             uint32_t                       depth,
+             PathState&                     state,
+             Sampler&                       sampler,
+             std::optional<EmitterSample>&  emitter_sample,
+             const SDTree*                  guide = nullptr) const;
+
+  /// @brief Pick an emitter for next event estimation at a shading point
+  /// @param n Geometric normal at `p`
+  /// @return The emitter, null if there is none to pick, and its probability
+  [[nodiscard]] std::pair<const Emitter*, Float> sampleEmitter(
+    const Scene& scene, const Point3f& p, const Vec3f& n, Float u) const;
+
+  /// @brief Get the probability of `sampleEmitter` picking `emitter`
+  [[nodiscard]] Float emitterPmf(const Scene&   scene,
+                                 const Point3f& p,
+                                 const Vec3f&   n,
+                                 const Emitter* emitter) const;
+
+  /// @brief Running mean and variance of the luminance of a pixel's samples
+  struct PixelStatistics {
+    /// Mean below which the error is measured in absolute terms
+    static constexpr Float min_relative_mean{ 1e-2f };
+
+    uint32_t count{ 0 };
+    Float    mean{ 0.f };
+    Float    m2{ 0.f };
+
+    void add(const Color3f& sample);
+    /// @brief Get the standard error of the mean relative to the mean
+    [[nodiscard]] Float relativeError() const;
+  };
+
+  /// @brief Render a range of the samples of each pixel of a tile into `block`
+  /// @param statistics Per pixel statistics of the film, updated when not null
+  /// @param guide, train See `sample()`
+  /// @return Largest relative error of the tile's pixels, or zero without
+  /// `statistics`
+  Float renderTile(const Scene&             scene,
+                   const SceneAccel&        accel,
+                   const PerspectiveCamera& camera,
+                   const Tile&              tile,
+                   uint32_t                 sample_offset,
+                   uint32_t                 sample_count,
+                   Sampler&                 sampler,
+                   ImageBlock&              block,
+                   PixelStatistics*         statistics,
+                   SDTree*                  guide,
+                   bool                     train) const;
+
+  /// @brief Wavefront version of `renderTile()`, implemented in wavefront.cpp
+  Float renderTileWavefront(const Scene&             scene,
+                            const SceneAccel&        accel,
+                            const PerspectiveCamera& camera,
+                            const Tile&              tile,
+                            uint32_t                 sample_offset,
+                            uint32_t                 sample_count,
+                            Sampler&                 sampler,
+                            ImageBlock&              block,
+                            PixelStatistics*         statistics,
+                            WavefrontQueues&         queues) const;
+
+  /// @brief Render with ReSTIR direct lighting at the first hit, one sample
+  /// per pixel and frame, implemented in restir.cpp
+  void renderReSTIR(const Scene&             scene,
+                    const SceneAccel&        accel,
+                    const PerspectiveCamera& camera,
+                    const Sampler&           sampler,
+                    Film&                    film) const;
+
+private:
+  Settings settings_;
+};
+} // namespace eldr
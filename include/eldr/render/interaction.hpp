@@ -0,0 +1,100 @@
+#pragma once
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/frame.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/core/ray.hpp>
+#include <eldr/render/fwd.hpp>
+
+#include <algorithm>
+#include <limits>
+
+namespace eldr {
+/// @brief Minimal information about a ray-triangle intersection, as computed
+/// during BVH traversal. Enough to later build a full surface interaction.
+struct PreliminaryIntersection {
+  ELDR_IMPORT_CORE_TYPES()
+
+  /// Distance along the ray
+  Float t{ std::numeric_limits<Float>::infinity() };
+  /// Barycentric coordinates of the hit on the triangle
+  Point2f prim_uv{ 0.f };
+  /// Index of the triangle within its mesh
+  uint32_t prim_index{ 0 };
+  /// Index of the mesh instance that was hit
+  uint32_t instance_index{ 0 };
+  /// The mesh that was hit
+  const Mesh* shape{ nullptr };
+
+  [[nodiscard]] bool isValid() const
+  {
+    return t < std::numeric_limits<Float>::infinity();
+  }
+};
+
+/// @brief Full description of a ray-surface intersection, in world space
+struct SurfaceInteraction {
+  ELDR_IMPORT_CORE_TYPES()
+
+  /// Distance along the ray, infinite if the ray left the scene
+  Float t{ std::numeric_limits<Float>::infinity() };
+  /// Position of the intersection
+  Point3f p{ 0.f };
+  /// Normalized geometric normal, facing the side the triangle winds
+  /// counter-clockwise on
+  Vec3f n{ 0.f, 0.f, 1.f };
+  /// Shading frame, around the interpolated vertex normal
+  Frame3f sh_frame;
+  /// Texture coordinates
+  Point2f uv{ 0.f };
+  /// Normalized direction towards the ray origin, in the shading frame
+  Vec3f wi{ 0.f, 0.f, 1.f };
+
+  const Mesh*    shape{ nullptr };
+  const BSDF*    bsdf{ nullptr };
+  const Emitter* emitter{ nullptr };
+
+  [[nodiscard]] bool isValid() const
+  {
+    return t < std::numeric_limits<Float>::infinity();
+  }
+
+  [[nodiscard]] Vec3f toWorld(const Vec3f& v) const
+  {
+    return sh_frame.toWorld(v);
+  }
+  [[nodiscard]] Vec3f toLocal(const Vec3f& v) const
+  {
+    return sh_frame.toLocal(v);
+  }
+
+  /// @brief Spawn a ray leaving the surface in direction `d`. The origin is
+  /// offset along the geometric normal to avoid self-intersection.
+  [[nodiscard]] Ray3f spawnRay(const Vec3f& d) const
+  {
+    return { offsetOrigin(d), d };
+  }
+
+  /// @brief Spawn a ray from the surface towards `target`, ending just before
+  /// reaching it. The direction is normalized.
+  [[nodiscard]] Ray3f spawnRayTo(const Point3f& target) const
+  {
+    const Vec3f   d{ target - p };
+    const Point3f o{ offsetOrigin(d) };
+    const Float   dist{ glm::length(target - o) };
+    return { o, (target - o) / dist, dist * (1.f - shadow_epsilon) };
+  }
+
+  /// Relative distance by which shadow rays stop short of their target
+  static constexpr Float shadow_epsilon{ 1e-4f };
+
+private:
+  [[nodiscard]] Point3f offsetOrigin(const Vec3f& d) const
+  {
+    // Scale the offset with the magnitude of the position, since that is what
+    // bounds the floating point error of the intersection
+    const Float mag{ std::max({ std::abs(p.x), std::abs(p.y), std::abs(p.z) }) };
+    const Float offset{ (1.f + mag) * 1e-5f };
+    return p + (glm::dot(d, n) >= 0.f ? offset : -offset) * n;
+  }
+};
+} // namespace eldr
@@ -0,0 +1,110 @@
+#pragma once
+#include <eldr/core/bbox.hpp>
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/render/fwd.hpp>
+
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace eldr {
+/// @brief Spatial and directional bounds of the light leaving one or more
+/// emitters, used to estimate how much they contribute at a point
+struct LightBounds {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  /// @brief Get the union of two bounds
+  [[nodiscard]] static LightBounds merge(const LightBounds& a,
+                                         const LightBounds& b);
+
+  /// @brief Estimate the contribution of the emitters at `p`, up to a
+  /// constant factor. The estimate is conservative, it is only zero if no
+  /// light can reach `p`.
+  /// @param n Surface normal at `p`, or zero to ignore foreshortening
+  [[nodiscard]] Float importance(const Point3f& p, const Vec3f& n) const;
+
+  BoundingBox3f bbox;
+  /// Axis of the cone bounding the surface normals
+  Vec3f w{ 0.f, 0.f, 1.f };
+  /// Total emitted power, in luminance
+  Float phi{ 0.f };
+  /// Cosine of the spread of the normal cone
+  Float cos_theta_o{ 1.f };
+  /// Cosine of the angle around a normal that light is emitted into
+  Float cos_theta_e{ 0.f };
+  /// Whether light leaves both sides of the surfaces
+  bool two_sided{ false };
+};
+
+/// @brief Emitter picked by `LightBVH::sample`, with the probability of
+/// having picked it
+struct SampledEmitter {
+  const Emitter* emitter{ nullptr };
+  CoreAliases<Float>::Float pmf{ 0.f };
+};
+
+/// @brief Hierarchy over the emitters of a scene for picking one for next
+/// event estimation, with a probability roughly proportional to its
+/// contribution at the shading point. Every node stores the bounds of the
+/// light its emitters leave (see `LightBounds`), and sampling descends from
+/// the root by randomly choosing a child in proportion to its importance, so
+/// the cost grows with the depth of the tree rather than the emitter count.
+///
+/// Emitters without bounds, like environments, are kept outside the tree and
+/// picked uniformly, with the same probability as the tree as a whole.
+class LightBVH {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  explicit LightBVH(std::span<const std::shared_ptr<Emitter>> emitters);
+
+  /// @brief Pick an emitter for a shading point
+  /// @param p, n Position and geometric normal of the shading point
+  /// @param u Uniform sample in [0, 1)
+  /// @return The emitter and its probability, no emitter if none of them can
+  /// reach `p`
+  [[nodiscard]] SampledEmitter
+  sample(const Point3f& p, const Vec3f& n, Float u) const;
+
+  /// @brief Get the probability of `sample` picking `emitter` at `p`
+  [[nodiscard]] Float
+  pmf(const Point3f& p, const Vec3f& n, const Emitter* emitter) const;
+
+  [[nodiscard]] size_t nodeCount() const { return nodes_.size(); }
+
+private:
+  struct Node {
+    LightBounds bounds;
+    /// Index of the second child (interior) or of the emitter (leaf). The
+    /// first child directly follows its parent.
+    uint32_t offset;
+    bool     leaf;
+  };
+
+  /// @brief Build the subtree over `emitters[first, last)` and return the
+  /// index of its root
+  /// @param bits Branches taken from the root to this subtree, starting from
+  /// the lowest bit
+  uint32_t
+  build(std::vector<std::pair<uint32_t, LightBounds>>& emitters,
+        size_t                                         first,
+        size_t                                         last,
+        uint64_t                                       bits,
+        uint32_t                                       depth);
+
+  /// @brief Get the probability of picking the tree rather than an unbounded
+  /// emitter
+  [[nodiscard]] Float treeProbability() const;
+
+  std::vector<Node>           nodes_;
+  std::vector<const Emitter*> bounded_;
+  std::vector<const Emitter*> unbounded_;
+  /// Path from the root to the leaf of every emitter in the tree, one bit per
+  /// level, set for the second child
+  std::unordered_map<const Emitter*, uint64_t> emitter_bits_;
+};
+} // namespace eldr
@@ -1,6 +1,7 @@
 #pragma once
 #include <eldr/core/fwd.hpp>
 #include <eldr/core/math.hpp>
+#include <eldr/render/fwd.hpp>
 #include <eldr/render/shape.hpp>
 
 #include <memory>
@@ -20,6 +21,10 @@ struct GeoSurface {
   uint32_t                  start_index;
   uint32_t                  count;
   std::shared_ptr<Material> material;
+  /// Material of the surface for the CPU renderer
+  std::shared_ptr<BSDF> bsdf;
+  /// Radiance emitted by the surface, zero if it isn't a light source
+  CoreAliases<Float>::Color3f emission{ 0.f };
 };
 
 class Mesh final : public Shape {
@@ -31,6 +36,7 @@ public:
        std::vector<Point2f>&&    texcoords,
        std::vector<Color4f>&&    colors,
        std::vector<Vec3f>&&      normals,
+       std::vector<uint32_t>&&   indices,
        std::vector<GeoSurface>&& surfaces);
   ~Mesh() override = default;
 
@@ -58,17 +64,51 @@ public:
     return vtx_normals_;
   }
 
+  /// @brief Get the triangle index list of this mesh. Every three consecutive
+  /// indices make up one face.
+  [[nodiscard]] const std::vector<uint32_t>& indices() const
+  {
+    return indices_;
+  }
+
+  /// @brief Get the number of triangles in this mesh
+  [[nodiscard]] size_t faceCount() const { return indices_.size() / 3; }
+
+  /// @brief Get the vertex indices of face `index`
+  [[nodiscard]] Vec3u faceIndices(size_t index) const
+  {
+    return { indices_[3 * index + 0],
+             indices_[3 * index + 1],
+             indices_[3 * index + 2] };
+  }
+
   /// @brief Get a vector surface info from this mesh
   [[nodiscard]] const std::vector<GeoSurface>& surfaces() const
   {
     return surfaces_;
   }
 
+  /// @brief Get the index of the surface that face `index` belongs to
+  [[nodiscard]] uint32_t surfaceIndex(size_t index) const;
+
+  /// @brief Hash the vertex positions and indices, all that acceleration
+  /// structures over the mesh depend on. Stable across runs.
+  [[nodiscard]] uint64_t geometryHash() const;
+
+  /// @brief Reorder the triangles of every surface along a Morton curve over
+  /// their centroids, then renumber the vertices in the order the triangles
+  /// first use them. Neighbouring triangles end up next to each other in
+  /// memory, which speeds up BVH builds and improves cache hit rates of ray
+  /// traversal and GPU vertex fetches. Surface ranges stay valid, as triangles
+  /// never move between surfaces.
+  void optimizeLayout();
+
 protected:
   std::vector<Point3f>    vtx_positions_;
   std::vector<Point2f>    vtx_texcoords_;
   std::vector<Color4f>    vtx_colors_;
   std::vector<Vec3f>      vtx_normals_;
+  std::vector<uint32_t>   indices_;
   std::vector<GeoSurface> surfaces_;
 
   // std::optional<vk::wr::GpuBuffer>
@@ -0,0 +1,148 @@
+#pragma once
+#include <eldr/core/bbox.hpp>
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/core/ray.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace eldr {
+/// @brief Group of rays traced through the BVH together, stored as structure
+/// of arrays. Only rays whose bit is set in `active` are traced, so packets
+/// can be partially filled.
+template <uint32_t Size> struct RayPacket {
+  ELDR_IMPORT_CORE_TYPES()
+  static_assert(Size == 8 or Size == 16, "Only 8- and 16-ray packets exist");
+
+public:
+  static constexpr uint32_t size{ Size };
+
+  void set(uint32_t i, const Ray3f& ray)
+  {
+    ox[i]   = ray.o.x;
+    oy[i]   = ray.o.y;
+    oz[i]   = ray.o.z;
+    dx[i]   = ray.d.x;
+    dy[i]   = ray.d.y;
+    dz[i]   = ray.d.z;
+    maxt[i] = ray.maxt;
+    active |= 1u << i;
+  }
+
+  [[nodiscard]] Ray3f ray(uint32_t i) const
+  {
+    return { { ox[i], oy[i], oz[i] }, { dx[i], dy[i], dz[i] }, maxt[i] };
+  }
+
+  [[nodiscard]] bool isActive(uint32_t i) const { return active >> i & 1; }
+
+  alignas(64) Float ox[Size];
+  alignas(64) Float oy[Size];
+  alignas(64) Float oz[Size];
+  alignas(64) Float dx[Size];
+  alignas(64) Float dy[Size];
+  alignas(64) Float dz[Size];
+  alignas(64) Float maxt[Size];
+  uint32_t active{ 0 };
+};
+
+/// @brief Conservative bound of the rays of a packet, using interval
+/// arithmetic over their origins and reciprocal directions. A box missed by
+/// the frustum is missed by every ray, so whole subtrees can be culled with a
+/// single test per node instead of one per ray.
+///
+/// The bound only exists if the directions of all rays have the same sign
+/// along each axis. Otherwise the packet is not coherent enough and its rays
+/// should be traced one by one.
+struct PacketFrustum {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  template <uint32_t Size> explicit PacketFrustum(const RayPacket<Size>& packet)
+  {
+    constexpr Float inf{ std::numeric_limits<Float>::infinity() };
+    o_min    = Vec3f{ inf };
+    o_max    = Vec3f{ -inf };
+    rcp_min  = Vec3f{ inf };
+    rcp_max  = Vec3f{ -inf };
+    uint32_t negative{ 0 }, positive{ 0 };
+    for (uint32_t i = 0; i < Size; ++i) {
+      if (not packet.isActive(i))
+        continue;
+      const Vec3f o{ packet.ox[i], packet.oy[i], packet.oz[i] };
+      const Vec3f d{ packet.dx[i], packet.dy[i], packet.dz[i] };
+      Vec3f       rcp;
+      for (uint32_t axis = 0; axis < 3; ++axis) {
+        const bool neg{ std::signbit(d[axis]) };
+        rcp[axis] = safeRcp(d[axis]);
+        (neg ? negative : positive) |= 1u << axis;
+      }
+      o_min   = glm::min(o_min, o);
+      o_max   = glm::max(o_max, o);
+      rcp_min = glm::min(rcp_min, rcp);
+      rcp_max = glm::max(rcp_max, rcp);
+    }
+    coherent = packet.active != 0 and (negative & positive) == 0;
+    for (uint32_t axis = 0; axis < 3; ++axis)
+      negative_dir[axis] = negative >> axis & 1;
+  }
+
+  /// @brief Test a box against the frustum
+  /// @param maxt Largest distance any ray of the packet is still interested
+  /// in
+  /// @param tnear Lower bound of the distance at which any ray enters the box
+  /// @return False if no ray of the packet can hit the box before `maxt`
+  [[nodiscard]] bool intersect(const Point3f& bmin,
+                               const Point3f& bmax,
+                               Float          maxt,
+                               Float&         tnear) const
+  {
+    Float tfar{ maxt };
+    tnear = 0.f;
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+      const Float near_plane{ negative_dir[axis] ? bmax[axis] : bmin[axis] };
+      const Float far_plane{ negative_dir[axis] ? bmin[axis] : bmax[axis] };
+      tnear = std::max(tnear, lowerBound(near_plane, axis));
+      tfar  = std::min(tfar, upperBound(far_plane, axis));
+    }
+    return tnear <= tfar;
+  }
+
+  [[nodiscard]] bool intersect(const BoundingBox3f& bbox,
+                               Float                maxt,
+                               Float&               tnear) const
+  {
+    return intersect(bbox.min, bbox.max, maxt, tnear);
+  }
+
+  Vec3f o_min, o_max;
+  Vec3f rcp_min, rcp_max;
+  bool  negative_dir[3];
+  bool  coherent;
+
+private:
+  /// @brief Smallest (plane - o) * rcp over all origins and directions
+  [[nodiscard]] Float lowerBound(Float plane, uint32_t axis) const
+  {
+    const Float a{ plane - o_max[axis] };
+    const Float b{ plane - o_min[axis] };
+    return std::min({ a * rcp_min[axis],
+                      a * rcp_max[axis],
+                      b * rcp_min[axis],
+                      b * rcp_max[axis] });
+  }
+
+  /// @brief Largest (plane - o) * rcp over all origins and directions
+  [[nodiscard]] Float upperBound(Float plane, uint32_t axis) const
+  {
+    const Float a{ plane - o_max[axis] };
+    const Float b{ plane - o_min[axis] };
+    return std::max({ a * rcp_min[axis],
+                      a * rcp_max[axis],
+                      b * rcp_min[axis],
+                      b * rcp_max[axis] });
+  }
+};
+} // namespace eldr
@@ -0,0 +1,97 @@
+#pragma once
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/core/ray.hpp>
+#include <eldr/render/fwd.hpp>
+#include <eldr/render/interaction.hpp>
+
+#include <vector>
+
+namespace eldr {
+/// @brief Point on an emitter, stored so that it can be reused by other
+/// shading points than the one it was sampled for
+struct LightSample {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  /// Position of the sample, or the direction towards it for environment
+  /// emitters
+  Point3f p{ 0.f };
+  /// Surface normal at `p`, unused for environment emitters
+  Vec3f          n{ 0.f, 0.f, 1.f };
+  Color3f        radiance{ 0.f };
+  const Emitter* emitter{ nullptr };
+  bool           infinite{ false };
+};
+
+/// @brief Weighted reservoir holding one light sample picked out of a stream
+/// of candidates, for resampled importance sampling (Bitterli et al. 2020,
+/// "Spatiotemporal Reservoir Resampling for Real-Time Ray Tracing with
+/// Dynamic Direct Lighting")
+struct Reservoir {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  /// @brief Add a candidate with resampling weight `weight`, which replaces
+  /// the current sample with probability `weight / w_sum`
+  /// @param u Uniform sample in [0, 1)
+  /// @return Whether `sample` was kept
+  bool update(const LightSample& sample, Float weight, Float u)
+  {
+    w_sum += weight;
+    if (weight > 0.f and u * w_sum < weight) {
+      y = sample;
+      return true;
+    }
+    return false;
+  }
+
+  LightSample y;
+  /// Sum of the resampling weights of all candidates seen
+  Float w_sum{ 0.f };
+  /// Unbiased contribution weight of `y`, the reciprocal of its effective
+  /// density
+  Float W{ 0.f };
+  /// Number of candidates seen, fractional after clamping temporal history
+  Float M{ 0.f };
+};
+
+/// @brief Per pixel state of the ReSTIR direct lighting passes, kept from
+/// one frame to the next for temporal reuse
+struct ReSTIRBuffers {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  /// @brief First hit of the camera ray of a pixel
+  struct Primary {
+    Ray3f                   ray;
+    PreliminaryIntersection pi;
+    /// Position of the sample on the film
+    Point2f film_pos{ 0.f };
+    /// Sampler dimension to continue the pixel sample at
+    uint32_t dimension{ 0 };
+    /// Shading normal and distance of the hit, for rejecting neighbours on
+    /// different surfaces during reuse. Zero distance for misses.
+    Vec3f n{ 0.f };
+    Float depth{ 0.f };
+  };
+
+  void resize(size_t pixel_count)
+  {
+    primary.resize(pixel_count);
+    previous.resize(pixel_count);
+    reservoirs.resize(pixel_count);
+    reused.resize(pixel_count);
+    history.resize(pixel_count);
+  }
+
+  std::vector<Primary> primary;
+  /// Primary hits of the last frame
+  std::vector<Primary> previous;
+  /// Candidates of the current frame, combined with the history
+  std::vector<Reservoir> reservoirs;
+  /// Result of the spatial reuse, shaded and kept as the next history
+  std::vector<Reservoir> reused;
+  std::vector<Reservoir> history;
+};
+} // namespace eldr
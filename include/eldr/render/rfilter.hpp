@@ -0,0 +1,109 @@
+#pragma once
+#include <eldr/core/fwd.hpp>
+#include <eldr/render/fwd.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace eldr {
+/// @brief Separable pixel reconstruction filter. Samples are splatted onto all
+/// pixels whose center lies within `radius()` of the sample, weighted by the
+/// product of the filter evaluated along x and y.
+class ReconstructionFilter {
+public:
+  /// Number of entries of the lookup table used by `evalDiscretized()`
+  static constexpr uint32_t table_size{ 32 };
+
+  virtual ~ReconstructionFilter() = default;
+
+  /// @brief Evaluate the one-dimensional filter at offset `x`
+  [[nodiscard]] virtual Float eval(Float x) const = 0;
+
+  /// @brief Evaluate the filter using the precomputed lookup table. Much
+  /// cheaper than `eval()` for filters with transcendental functions, and
+  /// accurate enough given the noise of the samples being splatted.
+  [[nodiscard]] Float evalDiscretized(Float x) const
+  {
+    const auto index{ static_cast<uint32_t>(std::abs(x) * scale_) };
+    return table_[std::min(index, table_size)];
+  }
+
+  /// @brief Get the support of the filter, in pixels around the sample
+  [[nodiscard]] Float radius() const { return radius_; }
+
+  /// @brief Get the number of pixels a sample can affect beyond the pixel it
+  /// lies in, on each side
+  [[nodiscard]] uint32_t borderSize() const
+  {
+    return static_cast<uint32_t>(std::max(0.f, std::ceil(radius_ - 0.5f)));
+  }
+
+protected:
+  explicit ReconstructionFilter(Float radius)
+    : radius_(radius), scale_(static_cast<Float>(table_size) / radius)
+  {
+  }
+
+  /// @brief Fill the lookup table, must be called by the constructor of
+  /// derived classes once `eval()` works
+  void initTable()
+  {
+    for (uint32_t i = 0; i < table_size; ++i)
+      table_[i] = eval((static_cast<Float>(i) + 0.5f) / scale_);
+    table_[table_size] = 0.f;
+  }
+
+private:
+  Float radius_;
+  Float scale_;
+  /// Filter values at the centers of `table_size` bins covering [0, radius),
+  /// followed by a zero for offsets outside of the support
+  std::array<Float, table_size + 1> table_{};
+};
+
+/// @brief Box filter covering exactly one pixel. Fastest, but aliases.
+class BoxFilter final : public ReconstructionFilter {
+public:
+  BoxFilter() : ReconstructionFilter(0.5f) { initTable(); }
+
+  [[nodiscard]] Float eval(Float x) const override
+  {
+    return std::abs(x) <= 0.5f ? 1.f : 0.f;
+  }
+};
+
+/// @brief Triangle shaped filter with a radius of one pixel
+class TentFilter final : public ReconstructionFilter {
+public:
+  TentFilter() : ReconstructionFilter(1.f) { initTable(); }
+
+  [[nodiscard]] Float eval(Float x) const override
+  {
+    return std::max(0.f, 1.f - std::abs(x));
+  }
+};
+
+/// @brief Truncated Gaussian, a good compromise between sharpness and
+/// aliasing
+class GaussianFilter final : public ReconstructionFilter {
+public:
+  explicit GaussianFilter(Float stddev = 0.5f)
+    : ReconstructionFilter(4.f * stddev),
+      alpha_(-1.f / (2.f * stddev * stddev)),
+      bias_(std::exp(alpha_ * radius() * radius()))
+  {
+    initTable();
+  }
+
+  [[nodiscard]] Float eval(Float x) const override
+  {
+    // Shifted down so the filter smoothly goes to zero at the radius
+    return std::max(0.f, std::exp(alpha_ * x * x) - bias_);
+  }
+
+private:
+  Float alpha_;
+  Float bias_;
+};
+} // namespace eldr
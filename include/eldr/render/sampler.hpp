@@ -0,0 +1,106 @@
+#pragma once
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/core/random.hpp>
+#include <eldr/render/fwd.hpp>
+
+#include <memory>
+
+namespace eldr {
+/// @brief Source of the random numbers driving the path tracer. A sampler is
+/// positioned at a sample of a pixel with `startPixelSample()` and then hands
+/// out the dimensions of that sample one after another.
+///
+/// The numbers only depend on the seed, the pixel, the sample index and the
+/// dimension, never on which thread renders the pixel or in what order, so
+/// images are reproducible for any number of threads.
+class Sampler {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  virtual ~Sampler() = default;
+
+  /// @brief Create an independent copy, one is needed per thread
+  [[nodiscard]] virtual std::unique_ptr<Sampler> clone() const = 0;
+
+  /// @brief Start generating sample `sample_index` of `pixel`
+  virtual void startPixelSample(const Vec2u& pixel, uint32_t sample_index)
+  {
+    pixel_seed_   = pixelSeed(pixel);
+    sample_index_ = sample_index;
+    dimension_    = 0;
+  }
+
+  /// @brief Continue the current sample at dimension `dim`. Allows a sample
+  /// to be suspended and resumed later, e.g. by the wavefront renderer, which
+  /// interleaves the dimensions of many paths.
+  virtual void setDimension(uint32_t dim) { dimension_ = dim; }
+
+  /// @brief Get the dimension the next value will be drawn for
+  [[nodiscard]] uint32_t dimension() const { return dimension_; }
+
+  /// @brief Get the next dimension of the current sample
+  [[nodiscard]] virtual Float next1D() = 0;
+
+  /// @brief Get the next two dimensions of the current sample
+  [[nodiscard]] virtual Point2f next2D() = 0;
+
+  [[nodiscard]] uint64_t seed() const { return seed_; }
+
+protected:
+  explicit Sampler(uint64_t seed) : seed_(seed) {}
+
+  /// @brief Hash a pixel into a seed for its sequence
+  [[nodiscard]] uint64_t pixelSeed(const Vec2u& pixel) const
+  {
+    return mix64(seed_ ^ mix64((static_cast<uint64_t>(pixel.y) << 32) |
+                               pixel.x));
+  }
+
+protected:
+  uint64_t seed_;
+  uint64_t pixel_seed_{ 0 };
+  uint32_t sample_index_{ 0 };
+  uint32_t dimension_{ 0 };
+};
+
+/// @brief Uncorrelated uniform random numbers from a PCG32 stream per pixel
+class IndependentSampler final : public Sampler {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  explicit IndependentSampler(uint64_t seed = 0) : Sampler(seed) {}
+
+  [[nodiscard]] std::unique_ptr<Sampler> clone() const override;
+  void startPixelSample(const Vec2u& pixel, uint32_t sample_index) override;
+  void setDimension(uint32_t dim) override;
+  [[nodiscard]] Float   next1D() override;
+  [[nodiscard]] Point2f next2D() override;
+
+private:
+  PCG32 rng_;
+};
+
+/// @brief Owen-scrambled Sobol sequence, with a differently scrambled sequence
+/// for every pixel. Stratifies much better than independent samples, in
+/// particular for power of two sample counts.
+///
+/// The first `sobol::dimension_count` dimensions use the generator matrices of
+/// core/sobol.hpp. Dimensions beyond those reuse the matrices with the sample
+/// indices shuffled, which decorrelates them from the earlier dimensions while
+/// keeping them stratified.
+class SobolSampler final : public Sampler {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  explicit SobolSampler(uint64_t seed = 0) : Sampler(seed) {}
+
+  [[nodiscard]] std::unique_ptr<Sampler> clone() const override;
+  [[nodiscard]] Float   next1D() override;
+  [[nodiscard]] Point2f next2D() override;
+
+private:
+  /// @brief Get a dimension of the current sample as 0.32 fixed point number
+  [[nodiscard]] uint32_t sampleDimension(uint32_t dim) const;
+};
+} // namespace eldr
@@ -54,6 +54,10 @@ struct SceneNode : public Renderable {
 struct MeshNode final : public SceneNode {
   // inline MeshNode(std::shared_ptr<Mesh> s) : mesh(s) {};
   std::shared_ptr<Mesh> mesh;
+  /// Area emitters of the surfaces of `mesh`, indexed like
+  /// `Mesh::surfaces()`. Null for surfaces that don't emit light, and empty if
+  /// none of them do.
+  std::vector<std::shared_ptr<Emitter>> emitters;
   void draw(const Mat4f& top_matrix, DrawContext& ctx) const override;
 };
 
@@ -61,12 +65,22 @@ struct Scene : public Renderable {
   ELDR_IMPORT_CORE_TYPES()
   struct SceneInfo {
     const std::filesystem::path model_path;
+    /// Reorder the triangles and vertices of the meshes for locality, see
+    /// `Mesh::optimizeLayout`
+    bool optimize_mesh_layout{ false };
   };
 
   virtual void draw(const Mat4f& top_matrix, DrawContext& ctx) const override;
 
+  /// @brief Load a glTF scene
+  /// @param engine Engine to create the GPU resources of the materials with,
+  /// or nullptr to only load what the CPU renderer needs
+  /// @param optimize_mesh_layout Whether to call `Mesh::optimizeLayout` on
+  /// every mesh loaded
   [[nodiscard]] static std::optional<std::shared_ptr<Scene>>
-  loadGltf(const vk::VulkanEngine& engine, std::filesystem::path file_path);
+  loadGltf(const vk::VulkanEngine* engine,
+           std::filesystem::path   file_path,
+           bool                    optimize_mesh_layout = false);
 
   [[nodiscard]]
   static std::optional<std::shared_ptr<Scene>>
@@ -74,7 +88,19 @@ struct Scene : public Renderable {
 
   [[nodiscard]]
   static std::optional<std::shared_ptr<Scene>>
-  load(const vk::VulkanEngine& engine, const SceneInfo&);
+  load(const vk::VulkanEngine* engine, const SceneInfo&);
+
+  /// @brief Set the emitter seen by rays leaving the scene, replacing the
+  /// previous one in `emitters`
+  void setEnvironment(std::shared_ptr<Emitter> emitter);
+
+  /// @brief Place the whole scene with `transform`, refreshing the world
+  /// transforms of the nodes and the area emitters that depend on them. A
+  /// `SceneAccel` over the scene must be updated afterwards.
+  void setTransform(const Mat4f& transform);
+
+  /// @brief Rebuild `light_bvh` over `emitters`, needed whenever they change
+  void buildLightBVH();
 
   std::unordered_map<std::string, std::shared_ptr<Mesh>>      meshes;
   std::unordered_map<std::string, std::shared_ptr<Material>>  materials;
@@ -84,7 +110,13 @@ struct Scene : public Renderable {
 
   std::shared_ptr<vk::SceneData> vk_scene_data;
 
-  // std::vector<Emitter> emitters_;
+  /// All emitters of the scene, including the environment
+  std::vector<std::shared_ptr<Emitter>> emitters;
+  /// Emitter seen by rays leaving the scene, if any
+  std::shared_ptr<Emitter> environment;
+  /// Hierarchy for picking emitters by their contribution
+  std::shared_ptr<const LightBVH> light_bvh;
+
   // std::vector<SceneNode> scene_;
   //  std::vector<Sensor> sensors_;
 };
@@ -0,0 +1,43 @@
+#pragma once
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/core/ray.hpp>
+#include <eldr/render/fwd.hpp>
+
+namespace eldr {
+/// @brief Pinhole camera. Looks down its local -z axis with +y up, like the
+/// view matrices of the Vulkan preview.
+class PerspectiveCamera {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  /// @param to_world Camera to world transform
+  /// @param fov_y Vertical field of view in degrees
+  /// @param film_size Resolution of the image in pixels
+  PerspectiveCamera(const Mat4f& to_world, Float fov_y, const Vec2u& film_size);
+
+  /// @brief Create a camera at `origin` looking at `target`
+  [[nodiscard]] static PerspectiveCamera lookAt(const Point3f& origin,
+                                                const Point3f& target,
+                                                const Vec3f&   up,
+                                                Float          fov_y,
+                                                const Vec2u&   film_size);
+
+  /// @brief Generate the ray through a position on the film
+  /// @param film_pos Position in pixels, with (0, 0) in the top left corner
+  [[nodiscard]] Ray3f sampleRay(const Point2f& film_pos) const;
+
+  [[nodiscard]] const Vec2u& filmSize() const { return film_size_; }
+  [[nodiscard]] const Mat4f& toWorld() const { return to_world_; }
+
+private:
+  Mat4f   to_world_;
+  Vec2u   film_size_;
+  Point3f origin_;
+  /// World space direction through the top left corner of the film, and the
+  /// steps to the next pixel in x and y
+  Vec3f corner_dir_;
+  Vec3f dx_;
+  Vec3f dy_;
+};
+} // namespace eldr
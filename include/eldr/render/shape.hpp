@@ -29,7 +29,8 @@ protected:
 protected:
   std::string name_;
   // BSDF bsdf_;
-  //  Emitter emitter_;
+  // Emitters depend on the world transform, so they belong to the instances
+  // of a shape rather than the shape (see `MeshNode::emitters`)
   //  Sensor sensor_;
   //  Medium interior_medium_;
   //  Medium exterior_medium_;
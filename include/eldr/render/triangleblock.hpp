@@ -0,0 +1,74 @@
+#pragma once
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/core/ray.hpp>
+
+namespace eldr {
+/// @brief Up to `Width` triangles in edge form (a vertex and the two edges
+/// leaving it), stored as structure of arrays so that a ray can be tested
+/// against all of them with a single SIMD Möller-Trumbore kernel. The kernel
+/// is chosen for the host CPU at runtime (AVX2, SSE or a scalar fallback).
+///
+/// Unused slots have zero edges, which makes them degenerate and never hit.
+template <uint32_t Width> struct alignas(Width * 4) TriangleBlock {
+  ELDR_IMPORT_CORE_TYPES()
+  static_assert(Width == 4 or Width == 8, "Only 4- and 8-wide blocks exist");
+
+public:
+  static constexpr uint32_t width{ Width };
+  static constexpr uint32_t invalid{ ~0u };
+
+  TriangleBlock()
+  {
+    for (uint32_t i = 0; i < Width; ++i)
+      clear(i);
+  }
+
+  void set(uint32_t       i,
+           uint32_t       prim,
+           const Point3f& v0,
+           const Point3f& v1,
+           const Point3f& v2)
+  {
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+      p0[axis][i] = v0[axis];
+      e1[axis][i] = v1[axis] - v0[axis];
+      e2[axis][i] = v2[axis] - v0[axis];
+    }
+    prim_index[i] = prim;
+  }
+
+  void clear(uint32_t i)
+  {
+    for (uint32_t axis = 0; axis < 3; ++axis)
+      p0[axis][i] = e1[axis][i] = e2[axis][i] = 0.f;
+    prim_index[i] = invalid;
+  }
+
+  /// @brief Intersect a ray with all triangles of the block
+  /// @param t, u, v Receive the distance and barycentric coordinates of every
+  /// triangle, only meaningful for the triangles hit
+  /// @return Bit mask of the triangles hit in (0, `maxt`)
+  uint32_t intersect(const Ray3f& ray,
+                     Float        maxt,
+                     Float*       t,
+                     Float*       u,
+                     Float*       v) const;
+
+  /// @brief Get the name of the triangle kernel selected for this CPU
+  [[nodiscard]] static const char* kernelName();
+
+  /// Vertex and edges of each triangle, indexed as [axis][triangle]
+  float p0[3][Width];
+  float e1[3][Width];
+  float e2[3][Width];
+  /// Index of the triangle in its mesh, `invalid` for unused slots
+  uint32_t prim_index[Width];
+};
+
+using TriangleBlock4 = TriangleBlock<4>;
+using TriangleBlock8 = TriangleBlock<8>;
+
+extern template struct TriangleBlock<4>;
+extern template struct TriangleBlock<8>;
+} // namespace eldr
@@ -0,0 +1,106 @@
+#pragma once
+#include <eldr/core/fwd.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/core/ray.hpp>
+#include <eldr/render/fwd.hpp>
+#include <eldr/render/interaction.hpp>
+
+#include <utility>
+#include <vector>
+
+namespace eldr {
+/// @brief Queue of rays stored as structure of arrays, so that a stage only
+/// streams through the components it needs
+struct RayQueue {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  [[nodiscard]] size_t size() const { return path.size(); }
+  [[nodiscard]] bool   empty() const { return path.empty(); }
+
+  void clear()
+  {
+    path.clear();
+    for (auto* c : { &ox, &oy, &oz, &dx, &dy, &dz, &maxt })
+      c->clear();
+  }
+
+  void push(uint32_t path_index, const Ray3f& ray)
+  {
+    path.push_back(path_index);
+    ox.push_back(ray.o.x);
+    oy.push_back(ray.o.y);
+    oz.push_back(ray.o.z);
+    dx.push_back(ray.d.x);
+    dy.push_back(ray.d.y);
+    dz.push_back(ray.d.z);
+    maxt.push_back(ray.maxt);
+  }
+
+  [[nodiscard]] Ray3f ray(size_t i) const
+  {
+    return { { ox[i], oy[i], oz[i] }, { dx[i], dy[i], dz[i] }, maxt[i] };
+  }
+
+  /// Index of the path the ray belongs to
+  std::vector<uint32_t> path;
+  std::vector<Float>    ox, oy, oz;
+  std::vector<Float>    dx, dy, dz;
+  std::vector<Float>    maxt;
+};
+
+/// @brief Per worker storage of the wavefront path tracer. The state of all
+/// paths in flight is kept as structure of arrays indexed by path, while the
+/// rays of the current stage live in queues that are compacted and reordered
+/// as paths terminate.
+///
+/// The buffers are reused from tile to tile, so they only allocate while they
+/// grow to the size of the largest wavefront.
+struct WavefrontQueues {
+  ELDR_IMPORT_CORE_TYPES()
+
+public:
+  /// @brief Resize the path state for `count` paths
+  void resizePaths(size_t count)
+  {
+    for (auto* c : { &film_x, &film_y, &throughput_r, &throughput_g,
+                     &throughput_b, &result_r, &result_g, &result_b, &prev_px,
+                     &prev_py, &prev_pz, &prev_nx, &prev_ny, &prev_nz,
+                     &prev_bsdf_pdf })
+      c->resize(count);
+    for (auto* c : { &pixel_x, &pixel_y, &sample_index, &dimension })
+      c->resize(count);
+  }
+
+  //----------------------------------------------------------------------------
+  // Path state
+  //----------------------------------------------------------------------------
+  /// Position of the camera sample on the film
+  std::vector<Float>    film_x, film_y;
+  std::vector<uint32_t> pixel_x, pixel_y;
+  std::vector<uint32_t> sample_index;
+  /// Next sampler dimension of each path
+  std::vector<uint32_t> dimension;
+  std::vector<Float>    throughput_r, throughput_g, throughput_b;
+  std::vector<Float>    result_r, result_g, result_b;
+  std::vector<Float>    prev_px, prev_py, prev_pz;
+  std::vector<Float>    prev_nx, prev_ny, prev_nz;
+  std::vector<Float>    prev_bsdf_pdf;
+
+  //----------------------------------------------------------------------------
+  // Queues
+  //----------------------------------------------------------------------------
+  /// Rays to intersect in the current stage, and the paths continuing
+  RayQueue rays, next_rays;
+  /// Closest hits of `rays`
+  std::vector<PreliminaryIntersection> hits;
+  /// Shadow rays of next event estimation, with the contribution they add to
+  /// their path when unoccluded
+  RayQueue           shadow_rays;
+  std::vector<Float> shadow_r, shadow_g, shadow_b;
+  /// Sort keys combined with queue indices, for ordering rays
+  std::vector<uint64_t> keys;
+  /// Queue indices of `hits` grouped by the BSDF at the hit
+  std::vector<std::pair<const BSDF*, uint32_t>> materials;
+};
+} // namespace eldr
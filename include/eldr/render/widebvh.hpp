@@ -0,0 +1,425 @@
+#pragma once
+#include <eldr/render/bvh.hpp>
+#include <eldr/render/fwd.hpp>
+
+#include <bit>
+#include <cmath>
+#include <type_traits>
+
+namespace eldr {
+
+/// @brief Node of a wide BVH with up to `Width` children. The child bounds are
+/// stored as structure of arrays so that a ray can be tested against all of
+/// them at once. Unused child slots have inverted bounds and are never hit.
+template <uint32_t Width> struct alignas(64) WideBVHNode {
+  static constexpr uint32_t width{ Width };
+  static constexpr uint32_t invalid{ ~0u };
+
+  /// Child bounds, indexed as [axis][child] for the minimum and
+  /// [3 + axis][child] for the maximum
+  float bounds[6][Width];
+  /// Index of the child node (interior), or of its first primitive (leaf)
+  uint32_t child[Width];
+  /// Number of primitives in a leaf child, zero for interior children
+  uint32_t prim_count[Width];
+
+  [[nodiscard]] bool isEmpty(uint32_t i) const { return child[i] == invalid; }
+  [[nodiscard]] bool isLeaf(uint32_t i) const { return prim_count[i] > 0; }
+
+  [[nodiscard]] BoundingBox3f childBBox(uint32_t i) const
+  {
+    return { { bounds[0][i], bounds[1][i], bounds[2][i] },
+             { bounds[3][i], bounds[4][i], bounds[5][i] } };
+  }
+
+  /// @brief Get the index of interior child `i` of the node at `self`
+  [[nodiscard]] uint32_t childNode(uint32_t /*self*/, uint32_t i) const
+  {
+    return child[i];
+  }
+
+  /// @brief Get the offset of the first primitive of leaf child `i`
+  [[nodiscard]] uint32_t firstPrim(uint32_t i) const { return child[i]; }
+};
+
+/// @brief Compressed node of a wide BVH, a quarter to half the size of
+/// `WideBVHNode` so that it fits in one (4-wide) or two (8-wide) cache lines.
+/// The child bounds are quantized to 8 bits on a grid spanning the node, with
+/// power of two cells so that decoding is exact. Bounds are rounded outwards,
+/// so children only ever grow.
+template <uint32_t Width> struct alignas(64) QuantizedWideBVHNode {
+  static constexpr uint32_t width{ Width };
+  static constexpr uint32_t invalid{ ~0u };
+
+  /// Minimum corner of the node, where the grid starts
+  float origin[3];
+  /// Cell size of the grid per axis, as power of two exponent
+  int8_t exponent[3];
+  /// Bit mask of the used child slots
+  uint8_t child_mask;
+  /// Child bounds in grid cells, indexed as [axis][child] for the minimum and
+  /// [3 + axis][child] for the maximum
+  uint8_t bounds[6][Width];
+  /// Index of the child node relative to this one (interior), or absolute
+  /// index of its first primitive (leaf)
+  uint32_t child[Width];
+  /// Number of primitives in a leaf child, zero for interior children
+  uint16_t prim_count[Width];
+
+  [[nodiscard]] bool isEmpty(uint32_t i) const { return child[i] == invalid; }
+  [[nodiscard]] bool isLeaf(uint32_t i) const { return prim_count[i] > 0; }
+
+  [[nodiscard]] float scale(uint32_t axis) const
+  {
+    return std::bit_cast<float>(static_cast<uint32_t>(exponent[axis] + 127)
+                                << 23);
+  }
+
+  [[nodiscard]] BoundingBox3f childBBox(uint32_t i) const
+  {
+    BoundingBox3f bbox;
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+      bbox.min[axis] = origin[axis] + bounds[axis][i] * scale(axis);
+      bbox.max[axis] = origin[axis] + bounds[3 + axis][i] * scale(axis);
+    }
+    return bbox;
+  }
+
+  [[nodiscard]] uint32_t childNode(uint32_t self, uint32_t i) const
+  {
+    return self + child[i];
+  }
+
+  [[nodiscard]] uint32_t firstPrim(uint32_t i) const { return child[i]; }
+};
+static_assert(sizeof(QuantizedWideBVHNode<4>) == 64,
+              "4-wide quantized nodes should fit one cache line");
+static_assert(sizeof(QuantizedWideBVHNode<8>) == 128,
+              "8-wide quantized nodes should fit two cache lines");
+
+/// @brief Precomputed ray data shared by the wide node kernels
+struct WideRay {
+  ELDR_IMPORT_CORE_TYPES()
+
+  explicit WideRay(const Ray3f& ray)
+  {
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+      // A finite reciprocal keeps the premultiplied slab test below from
+      // computing inf - inf for rays parallel to an axis
+      const bool neg{ std::signbit(ray.d[axis]) };
+      d_rcp[axis] = safeRcp(ray.d[axis]);
+      o_rcp[axis] = ray.o[axis] * d_rcp[axis];
+      near[axis] = axis + (neg ? 3 : 0);
+      far[axis]  = axis + (neg ? 0 : 3);
+    }
+  }
+
+  Vec3f d_rcp;
+  /// Origin premultiplied by the reciprocal direction, so that each slab
+  /// distance is a single fused multiply-subtract
+  Vec3f o_rcp;
+  /// Rows of `WideBVHNode::bounds` holding the near and far planes per axis
+  uint32_t near[3];
+  uint32_t far[3];
+};
+
+struct WideBVHStats {
+  size_t node_count{ 0 };
+  size_t leaf_count{ 0 };
+  /// Average number of used child slots per node
+  float avg_child_count{ 0.f };
+};
+
+/// @brief Wide BVH collapsed from a binary `BVH`. Traversal tests all children
+/// of a node with a single SIMD kernel, which is chosen for the host CPU at
+/// runtime (AVX2, SSE or a scalar fallback).
+///
+/// With `Quantized`, nodes are stored as `QuantizedWideBVHNode`s, trading a
+/// little decoding work and slightly looser bounds for much less memory
+/// traffic.
+template <uint32_t Width, bool Quantized> class WideBVH {
+  ELDR_IMPORT_CORE_TYPES()
+  static_assert(Width == 4 or Width == 8, "Only 4- and 8-wide BVHs exist");
+
+public:
+  using Node = std::conditional_t<Quantized,
+                                  QuantizedWideBVHNode<Width>,
+                                  WideBVHNode<Width>>;
+  /// Signature of the node kernels. Writes the entry distance of every child
+  /// to `tnear` and returns a bit mask of the children hit before `maxt`.
+  using IntersectFn = uint32_t (*)(const Node&    node,
+                                   const WideRay& ray,
+                                   Float          maxt,
+                                   Float*         tnear);
+
+  /// Traversal stack size, enough for any tree collapsed from a `BVH`
+  static constexpr uint32_t stack_size{ BVH::max_depth * Width };
+
+  WideBVH();
+  explicit WideBVH(const BVH& bvh, uint32_t leaf_alignment = 1);
+
+  /// @brief Collapse a binary BVH into this one, replacing its contents
+  /// @param leaf_alignment The primitives of every leaf start at a multiple
+  /// of this in `primIndices()`, padded with `Node::invalid`. Lets users keep
+  /// per leaf data in fixed size blocks, e.g. SIMD triangle blocks.
+  void build(const BVH& bvh, uint32_t leaf_alignment = 1);
+
+  [[nodiscard]] bool empty() const { return nodes_.empty(); }
+
+  [[nodiscard]] const BoundingBox3f& bbox() const { return bbox_; }
+
+  [[nodiscard]] std::span<const Node> nodes() const { return nodes_; }
+
+  [[nodiscard]] std::span<const uint32_t> primIndices() const
+  {
+    return prim_indices_;
+  }
+
+  [[nodiscard]] const WideBVHStats& stats() const { return stats_; }
+
+  /// @brief Write the tree to `stream`. Nodes are stored in the memory layout
+  /// of this build, so the data is only meant to be read back on the same
+  /// platform, e.g. from a cache.
+  void write(Stream& stream) const;
+
+  /// @brief Replace the contents with a tree stored by `write()`. Throws if
+  /// the tree would make traversal leave the node or primitive arrays.
+  void read(Stream& stream);
+
+  /// @brief Get the name of the node kernel selected for this CPU
+  [[nodiscard]] static const char* kernelName();
+
+  /// @brief Find the closest primitive hit along `ray`. The callback works
+  /// like the one of `BVH::traverse`.
+  template <typename Func>
+  bool traverse(const Ray3f& ray, Func&& intersect_prim) const;
+
+  /// @brief Like `traverse`, but with one callback per leaf instead of per
+  /// primitive, with signature `bool(uint32_t first, uint32_t count, Float&
+  /// maxt)`. The leaf holds `primIndices()[first, first + count)`.
+  template <typename Func>
+  bool traverseLeaves(const Ray3f& ray, Func&& intersect_leaf) const;
+
+  /// @brief Check whether any primitive is hit along `ray`, stopping at the
+  /// first one found. The callback works like the one of `BVH::occluded`.
+  template <typename Func>
+  bool occluded(const Ray3f& ray, Func&& intersect_prim) const;
+
+  /// @brief Like `occluded`, with one callback per leaf of signature
+  /// `bool(uint32_t first, uint32_t count, Float maxt)`
+  template <typename Func>
+  bool occludedLeaves(const Ray3f& ray, Func&& intersect_leaf) const;
+
+  /// @brief Traverse the hierarchy with a coherent packet of rays. Works
+  /// like `BVH::traversePacket`.
+  template <typename Func>
+  void traversePacket(const PacketFrustum& frustum,
+                      Float                maxt,
+                      Func&&               intersect_prim) const;
+
+  /// @brief Like `traversePacket`, with one callback per leaf of signature
+  /// `Float(uint32_t first, uint32_t count)`
+  template <typename Func>
+  void traversePacketLeaves(const PacketFrustum& frustum,
+                            Float                maxt,
+                            Func&&               intersect_leaf) const;
+
+private:
+  uint32_t collapse(const BVH&                     bvh,
+                    uint32_t                       binary_node,
+                    std::vector<WideBVHNode<Width>>& nodes);
+  /// @brief Append the primitives of a binary leaf to `prim_indices_`
+  /// @return Offset of the first primitive
+  uint32_t appendLeaf(const BVH& bvh, const BVHNode& leaf);
+  /// @brief Check the child links and leaf ranges of a tree that was read
+  void validate() const;
+
+private:
+  std::vector<Node>     nodes_;
+  std::vector<uint32_t> prim_indices_;
+  BoundingBox3f         bbox_;
+  WideBVHStats          stats_;
+  IntersectFn           intersect_children_;
+  uint32_t              leaf_alignment_{ 1 };
+};
+
+using WideBVH4          = WideBVH<4>;
+using WideBVH8          = WideBVH<8>;
+using QuantizedWideBVH4 = WideBVH<4, true>;
+using QuantizedWideBVH8 = WideBVH<8, true>;
+
+extern template class WideBVH<4>;
+extern template class WideBVH<8>;
+extern template class WideBVH<4, true>;
+extern template class WideBVH<8, true>;
+
+template <uint32_t Width, bool Quantized>
+template <typename Func>
+bool WideBVH<Width, Quantized>::traverseLeaves(const Ray3f& ray,
+                                    Func&&       intersect_leaf) const
+{
+  if (unlikely(nodes_.empty()))
+    return false;
+
+  struct StackEntry {
+    uint32_t node;
+    Float    tnear;
+  };
+  StackEntry stack[stack_size];
+  uint32_t   stack_ptr{ 0 };
+
+  const WideRay wray{ ray };
+  Float         maxt{ ray.maxt };
+  bool          hit{ false };
+  stack[stack_ptr++] = { 0, 0.f };
+
+  while (stack_ptr > 0) {
+    const StackEntry entry{ stack[--stack_ptr] };
+    if (entry.tnear > maxt)
+      continue;
+    const Node& node{ nodes_[entry.node] };
+
+    alignas(32) Float tnear[Width];
+    uint32_t          mask{ intersect_children_(node, wray, maxt, tnear) };
+
+    // Leaves are intersected right away, interior children are pushed onto
+    // the stack sorted so that the closest one is popped first
+    const uint32_t first{ stack_ptr };
+    while (mask != 0) {
+      const auto i{ static_cast<uint32_t>(std::countr_zero(mask)) };
+      mask &= mask - 1;
+      if (node.isLeaf(i)) {
+        if (intersect_leaf(node.firstPrim(i), node.prim_count[i], maxt))
+          hit = true;
+        continue;
+      }
+      uint32_t j{ stack_ptr++ };
+      for (; j > first and stack[j - 1].tnear < tnear[i]; --j)
+        stack[j] = stack[j - 1];
+      stack[j] = { node.childNode(entry.node, i), tnear[i] };
+    }
+  }
+  return hit;
+}
+
+template <uint32_t Width, bool Quantized>
+template <typename Func>
+bool WideBVH<Width, Quantized>::traverse(const Ray3f& ray, Func&& intersect_prim) const
+{
+  return traverseLeaves(
+    ray, [&](uint32_t first, uint32_t count, Float& maxt) {
+      bool hit{ false };
+      for (uint32_t p = 0; p < count; ++p) {
+        if (intersect_prim(prim_indices_[first + p], maxt))
+          hit = true;
+      }
+      return hit;
+    });
+}
+
+template <uint32_t Width, bool Quantized>
+template <typename Func>
+void WideBVH<Width, Quantized>::traversePacketLeaves(const PacketFrustum& frustum,
+                                          Float                maxt,
+                                          Func&& intersect_leaf) const
+{
+  if (unlikely(nodes_.empty()))
+    return;
+
+  struct StackEntry {
+    uint32_t node;
+    Float    tnear;
+  };
+  StackEntry stack[stack_size];
+  uint32_t   stack_ptr{ 0 };
+  stack[stack_ptr++] = { 0, 0.f };
+
+  while (stack_ptr > 0) {
+    const StackEntry entry{ stack[--stack_ptr] };
+    if (entry.tnear > maxt)
+      continue;
+    const Node& node{ nodes_[entry.node] };
+
+    // One frustum test per child stands in for a SIMD test per ray and child
+    const uint32_t first{ stack_ptr };
+    for (uint32_t i = 0; i < Width; ++i) {
+      if (node.isEmpty(i))
+        continue;
+      Float tnear;
+      if (not frustum.intersect(node.childBBox(i), maxt, tnear))
+        continue;
+      if (node.isLeaf(i)) {
+        maxt = intersect_leaf(node.firstPrim(i), node.prim_count[i]);
+        continue;
+      }
+      uint32_t j{ stack_ptr++ };
+      for (; j > first and stack[j - 1].tnear < tnear; --j)
+        stack[j] = stack[j - 1];
+      stack[j] = { node.childNode(entry.node, i), tnear };
+    }
+  }
+}
+
+template <uint32_t Width, bool Quantized>
+template <typename Func>
+void WideBVH<Width, Quantized>::traversePacket(const PacketFrustum& frustum,
+                                    Float                maxt,
+                                    Func&&               intersect_prim) const
+{
+  traversePacketLeaves(frustum, maxt, [&](uint32_t first, uint32_t count) {
+    Float packet_maxt{ maxt };
+    for (uint32_t p = 0; p < count; ++p)
+      packet_maxt = intersect_prim(prim_indices_[first + p]);
+    return packet_maxt;
+  });
+}
+
+template <uint32_t Width, bool Quantized>
+template <typename Func>
+bool WideBVH<Width, Quantized>::occludedLeaves(const Ray3f& ray,
+                                    Func&&       intersect_leaf) const
+{
+  if (unlikely(nodes_.empty()))
+    return false;
+
+  uint32_t stack[stack_size];
+  uint32_t stack_ptr{ 0 };
+
+  const WideRay wray{ ray };
+  stack[stack_ptr++] = 0;
+
+  while (stack_ptr > 0) {
+    const uint32_t node_index{ stack[--stack_ptr] };
+    const Node&    node{ nodes_[node_index] };
+
+    // The entry distances are not needed, any order will do
+    alignas(32) Float tnear[Width];
+    uint32_t          mask{ intersect_children_(node, wray, ray.maxt, tnear) };
+    while (mask != 0) {
+      const auto i{ static_cast<uint32_t>(std::countr_zero(mask)) };
+      mask &= mask - 1;
+      if (node.isLeaf(i)) {
+        if (intersect_leaf(node.firstPrim(i), node.prim_count[i], ray.maxt))
+          return true;
+        continue;
+      }
+      stack[stack_ptr++] = node.childNode(node_index, i);
+    }
+  }
+  return false;
+}
+
+template <uint32_t Width, bool Quantized>
+template <typename Func>
+bool WideBVH<Width, Quantized>::occluded(const Ray3f& ray, Func&& intersect_prim) const
+{
+  return occludedLeaves(
+    ray, [&](uint32_t first, uint32_t count, Float maxt) {
+      for (uint32_t p = 0; p < count; ++p) {
+        if (intersect_prim(prim_indices_[first + p], maxt))
+          return true;
+      }
+      return false;
+    });
+}
+} // namespace eldr
@@ -88,7 +88,11 @@ private:
   void recreateSwapchain();
   void updateBuffers();
   void updateScenes(uint32_t current_image);
-  void drawGeometry(const wr::CommandBuffer& cb);
+  /// @brief Allocate the descriptors of the frame's draws, before they are
+  /// recorded in parallel
+  void prepareGeometry();
+  void drawGeometry(const wr::CommandBuffer&          cb,
+                    const core::BlockedRange<size_t>& range);
 
 private:
   const app::Window& window_;
@@ -42,6 +42,7 @@ class Pipeline;
 // class ComputePipeline;
 class AllocatedBuffer;
 template <typename T> class Buffer;
+class DeviceMemory;
 class Image;
 class ImageView;
 class Framebuffer;
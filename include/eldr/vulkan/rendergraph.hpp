@@ -1,7 +1,9 @@
 #pragma once
+#include <eldr/core/parallel.hpp>
 #include <eldr/vulkan/wrappers/buffer.hpp>
 #include <eldr/vulkan/wrappers/commandbuffer.hpp>
 #include <eldr/vulkan/wrappers/descriptorsetlayout.hpp>
+#include <eldr/vulkan/wrappers/devicememory.hpp>
 #include <eldr/vulkan/wrappers/image.hpp>
 #include <eldr/vulkan/wrappers/pipeline.hpp>
 #include <eldr/vulkan/wrappers/renderpass.hpp>
@@ -9,8 +11,10 @@
 
 #include <functional>
 #include <memory>
+#include <optional>
 #include <ranges>
 #include <span>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 #include <vulkan/vulkan_core.h>
@@ -155,6 +159,9 @@ class RenderStage : public RenderGraphObject {
   friend RenderGraph;
 
 public:
+  using RangeRecordFunction = std::function<void(
+    const wr::CommandBuffer&, const core::BlockedRange<size_t>&)>;
+
   RenderStage(const RenderStage&) = delete;
   RenderStage(RenderStage&&)      = delete;
   ~RenderStage() override         = default;
@@ -194,7 +201,24 @@ public:
   RenderStage&
   setOnRecord(std::function<void(const wr::CommandBuffer&)> on_record)
   {
-    on_record_ = std::move(on_record);
+    on_record_    = std::move(on_record);
+    record_count_ = nullptr;
+    return *this;
+  }
+
+  /// @brief Specifies a function recording `count()` independent items, such
+  /// as draws, in place of a single function
+  /// @details The items are split into blocks of at least `grain_size`, each
+  /// recorded into its own secondary command buffer on a worker thread. The
+  /// function must be safe to call concurrently, and can't rely on state
+  /// bound by other blocks.
+  RenderStage& setOnRecord(std::function<size_t()> count,
+                           RangeRecordFunction     on_record,
+                           size_t                  grain_size = 256)
+  {
+    record_count_      = std::move(count);
+    on_record_range_   = std::move(on_record);
+    record_grain_size_ = grain_size;
     return *this;
   }
 
@@ -214,6 +238,11 @@ protected:
   // std::vector<VkDescriptorSetLayout> descriptor_layouts_;
   // std::vector<VkPushConstantRange>   push_constant_ranges_;
   std::function<void(const wr::CommandBuffer&)> on_record_{ [](auto&) {} };
+  // Set for stages whose items are recorded in parallel, replacing
+  // `on_record_`
+  std::function<size_t()> record_count_;
+  RangeRecordFunction     on_record_range_;
+  size_t                  record_grain_size_{ 1 };
 };
 
 class GraphicsStage : public RenderStage {
@@ -229,10 +258,12 @@ public:
   GraphicsStage& operator=(GraphicsStage&&)      = delete;
 
   /// @brief Specifies that this stage writes to `resource`.
+  /// @param store_op Store op of the attachment. If not given, the contents
+  /// are only stored if a later stage needs them.
   GraphicsStage&
-  writesTo(const TextureResource* resource,
-           VkAttachmentLoadOp     load_op,
-           VkAttachmentStoreOp    store_op = VK_ATTACHMENT_STORE_OP_STORE);
+  writesTo(const TextureResource*             resource,
+           VkAttachmentLoadOp                 load_op,
+           std::optional<VkAttachmentStoreOp> store_op = std::nullopt);
 
   GraphicsStage& readsFrom(const RenderResource* resource);
 
@@ -240,6 +271,37 @@ private:
   using LoadStoreOps = std::pair<VkAttachmentLoadOp, VkAttachmentStoreOp>;
   std::unordered_map<const TextureResource*, LoadStoreOps> load_store_ops_;
   std::unordered_set<const TextureResource*>               resolves_;
+  // Attachments whose store op is inferred during compilation
+  std::unordered_set<const TextureResource*> inferred_stores_;
+};
+
+/// @brief How a stage uses a resource: the pipeline stages and memory
+/// accesses of the use, for inferring the barriers between stages.
+struct ResourceAccess {
+  VkPipelineStageFlags2 stages{ VK_PIPELINE_STAGE_2_NONE };
+  VkAccessFlags2        access{ VK_ACCESS_2_NONE };
+  /// Layout images need to be in, ignored for buffers
+  VkImageLayout layout{ VK_IMAGE_LAYOUT_UNDEFINED };
+  bool          write{ false };
+  /// Whether the previous contents may be discarded when the layout changes
+  bool discard{ false };
+  /// Whether this is the first use in a frame of an image sharing its memory
+  /// with others, whose contents and layout are undefined at that point
+  bool acquire{ false };
+};
+
+/// @brief Accesses to the memory of a physical resource recorded since its
+/// last write. They are kept from one frame to the next so that the first
+/// stage of a frame waits for the last one of the previous frame, and shared
+/// by resources aliasing the same memory. Image layouts are tracked by the
+/// images themselves.
+struct MemoryAccessState {
+  VkPipelineStageFlags2 write_stages{ VK_PIPELINE_STAGE_2_NONE };
+  VkAccessFlags2        write_access{ VK_ACCESS_2_NONE };
+  VkPipelineStageFlags2 read_stages{ VK_PIPELINE_STAGE_2_NONE };
+  /// Stages and accesses the last write has been made visible to
+  VkPipelineStageFlags2 visible_stages{ VK_PIPELINE_STAGE_2_NONE };
+  VkAccessFlags2        visible_access{ VK_ACCESS_2_NONE };
 };
 
 class PhysicalResource : public RenderGraphObject {
@@ -255,6 +317,10 @@ public:
 
 protected:
   explicit PhysicalResource() = default;
+
+  std::shared_ptr<MemoryAccessState> state_{
+    std::make_shared<MemoryAccessState>()
+  };
 };
 
 class PhysicalBuffer : public PhysicalResource {
@@ -287,6 +353,9 @@ public:
 
 private:
   wr::Image image_;
+  // First stage of a frame using the image if it shares its memory with other
+  // transient images, null otherwise
+  const RenderStage* first_stage_{ nullptr };
 };
 
 class PhysicalBackBuffer : public PhysicalImage {
@@ -313,6 +382,9 @@ public:
 
   PhysicalStage& operator=(const PhysicalStage&) = delete;
   PhysicalStage& operator=(PhysicalStage&&)      = delete;
+
+protected:
+  std::vector<std::pair<PhysicalResource*, ResourceAccess>> accesses_;
 };
 
 class PhysicalGraphicsStage : public PhysicalStage {
@@ -330,6 +402,10 @@ public:
 private:
   std::vector<VkRenderingAttachmentInfo>     color_attachments_;
   std::unique_ptr<VkRenderingAttachmentInfo> depth_attachment_;
+  // Attachment formats, inherited by the secondary command buffers
+  std::vector<VkFormat> color_formats_;
+  VkFormat              depth_format_{ VK_FORMAT_UNDEFINED };
+  VkSampleCountFlagBits sample_count_{ VK_SAMPLE_COUNT_1_BIT };
   // wr::RenderPass               render_pass_;
   // std::vector<wr::Framebuffer> framebuffers_;
 };
@@ -372,21 +448,100 @@ public:
   }
 
   void buildAttachments(const GraphicsStage*, PhysicalGraphicsStage&) const;
+  /// @brief Derive how `stage` accesses each resource it reads or writes
+  void buildAccesses(const RenderStage* stage, PhysicalStage&) const;
   // void buildRenderPass(const GraphicsStage*, PhysicalGraphicsStage&) const;
   // void buildPipelineLayout(const RenderStage*, PhysicalStage&) const;
   // void buildGraphicsPipeline(const GraphicsStage*,
   //                            PhysicalGraphicsStage&) const;
 
-  void recordCommandBuffer(const RenderStage*       stage,
-                           const wr::CommandBuffer& cb) const;
+  /// @brief Record the barriers of `stage` and run its contents, recorded
+  /// into `secondaries`, in `cb`
+  void recordCommandBuffer(
+    const RenderStage*                        stage,
+    std::span<const wr::CommandBuffer* const> secondaries,
+    const wr::CommandBuffer&                  cb) const;
   void compile();
 
+  /// @brief Recreate the textures for the current swapchain extent, keeping
+  /// the compiled stage order. The old textures are destroyed once the
+  /// command buffers rendered with them have finished executing.
+  /// @param old_swapchain Swapchain replaced by the current one, destroyed
+  /// along with the old textures
+  void resize(wr::Swapchain old_swapchain = {});
+
+  /// @brief Record the stages into `cb`, which the caller submits once
+  /// afterwards
   void render(const wr::CommandBuffer& cb, wr::Image& target);
 
+private:
+  /// @brief Range of stage groups a texture is alive in during a frame
+  struct Lifetime {
+    size_t             first{ 0 };
+    size_t             last{ 0 };
+    const RenderStage* first_stage{ nullptr };
+    /// Whether the contents are dead between frames
+    bool transient{ true };
+  };
+
+  /// @brief Submission of a command buffer recorded by `render()`
+  struct Submission {
+    const wr::CommandBuffer* cb;
+    /// Value of `CommandBuffer::submitCount()` once it is submitted
+    uint64_t serial;
+
+    [[nodiscard]] bool completed() const { return cb->hasCompleted(serial); }
+  };
+
+  /// @brief Physical textures and the swapchain replaced by `resize()` that
+  /// may still be in use
+  struct RetiredResources {
+    std::vector<wr::DeviceMemory>                  memory;
+    std::vector<std::unique_ptr<PhysicalResource>> textures;
+    wr::Swapchain                                  swapchain;
+    /// Submissions to wait for before destroying the resources
+    std::vector<Submission> users;
+  };
+
+  struct BarrierBatch {
+    std::vector<VkImageMemoryBarrier2>  images;
+    std::vector<VkBufferMemoryBarrier2> buffers;
+  };
+
+  /// @brief Add the barrier needed before `access` of `resource`, if any, to
+  /// `batch`, and make `access` the last access of the resource
+  static void addBarrier(PhysicalResource&     resource,
+                         const ResourceAccess& access,
+                         BarrierBatch&         batch);
+  static void recordBarriers(const BarrierBatch&      batch,
+                             const wr::CommandBuffer& cb);
+
+  /// @brief Check that the buffers `stage` reads have been uploaded
+  [[nodiscard]] bool hasBufferData(const RenderStage* stage) const;
+  /// @brief Record the contents of `stage` into secondary command buffers,
+  /// one per block of items, on the workers of `group`
+  void recordSecondaries(const RenderStage*                     stage,
+                         std::vector<const wr::CommandBuffer*>& secondaries,
+                         core::TaskGroup&                       group) const;
+  void beginSecondary(const RenderStage*       stage,
+                      const wr::CommandBuffer& secondary) const;
+
+  /// @brief Create the physical textures, sharing memory between transient
+  /// textures whose lifetimes don't overlap
+  void allocateTextures();
+  /// @brief Create the physical stages, referring to the current textures
+  void buildStages();
+  /// @brief Destroy the retired resources no command buffer uses anymore
+  void releaseRetired();
+
 private:
   const wr::Device&    device_;
   const wr::Swapchain& swapchain_;
 
+  // Memory shared by transient textures, declared before the textures so that
+  // it outlives them
+  std::vector<wr::DeviceMemory> transient_memory_;
+
   TextureResource*                              back_buffer_;
   std::vector<std::unique_ptr<TextureResource>> texture_resources_;
   std::vector<std::unique_ptr<BufferResource>>  buffer_resources_;
@@ -394,6 +549,14 @@ private:
   // Stage execution order. Each sub-list contains nodes that can be recorded
   // onto the command buffer without a memory barrier in between.
   std::vector<std::vector<RenderStage*>> stage_stack_;
+
+  std::unordered_map<const TextureResource*, Lifetime> lifetimes_;
+  // Transient textures that are never stored or loaded
+  std::unordered_set<const TextureResource*> memoryless_;
+
+  // Submissions recorded by render() that may still be executing
+  std::vector<Submission>       in_flight_;
+  std::vector<RetiredResources> retired_;
 };
 
 template <typename T> [[nodiscard]] T* RenderGraphObject::as()
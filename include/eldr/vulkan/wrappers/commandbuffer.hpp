@@ -9,13 +9,18 @@ namespace eldr::vk::wr {
 class CommandBuffer {
 public:
   CommandBuffer();
-  CommandBuffer(const Device&      device_,
-                const CommandPool& command_pool,
-                std::string_view   name);
+  CommandBuffer(const Device&        device_,
+                const CommandPool&   command_pool,
+                std::string_view     name,
+                VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
   CommandBuffer(CommandBuffer&&) noexcept;
   ~CommandBuffer();
 
-  const CommandBuffer& begin(VkCommandBufferUsageFlags usage = 0) const;
+  /// @param inheritance State inherited from the primary command buffer,
+  /// required for secondary command buffers
+  const CommandBuffer&
+  begin(VkCommandBufferUsageFlags             usage       = 0,
+        const VkCommandBufferInheritanceInfo* inheritance = nullptr) const;
   const CommandBuffer& beginRenderPass(const VkRenderPassBeginInfo&) const;
   const CommandBuffer& beginRendering(const VkRenderingInfoKHR&) const;
   // const CommandBuffer&   beginSingleCommand() const;
@@ -25,6 +30,10 @@ public:
                                    int32_t  vertex_offset  = 0,
                                    uint32_t first_instance = 0) const;
   const CommandBuffer& endRenderPass() const;
+  /// @brief Execute secondary command buffers. They are not handed out again
+  /// until this command buffer is reused, after it finished executing.
+  const CommandBuffer&
+  executeCommands(std::span<const CommandBuffer* const> secondaries) const;
   const CommandBuffer& endRendering() const;
   const CommandBuffer& end() const;
   const CommandBuffer& submit(const VkSubmitInfo& submit_info) const;
@@ -155,13 +164,31 @@ public:
   [[nodiscard]] const std::string& name() const { return name_; }
   [[nodiscard]] VkCommandBuffer    vk() const;
   [[nodiscard]] VkCommandBuffer*   vkp() const;
+  /// @brief Get the status of the fence of the last submission. Only primary
+  /// command buffers have one.
   [[nodiscard]] VkResult           fenceStatus() const;
+  /// @brief Get the number of times this command buffer has been submitted
+  [[nodiscard]] uint64_t           submitCount() const;
+  /// @brief Check whether a submission has finished executing. Unlike the
+  /// fence status, this stays true after the command buffer is reused.
+  /// @param submission `submitCount()` right after that submission
+  [[nodiscard]] bool               hasCompleted(uint64_t submission) const;
   void                             resetFence() const;
   void                             waitFence() const;
 
 private:
   const CommandBuffer& copyBuffer(const VkCopyBufferInfo2& copy_info) const;
 
+  friend CommandPool;
+  /// @brief Whether a secondary command buffer is handed out
+  [[nodiscard]] bool pending() const;
+  /// @brief Keep a secondary command buffer from being handed out again
+  /// until the primary one executing it is reused
+  void markPending() const;
+  /// @brief Make the secondary command buffers executed by this primary one
+  /// available again. Only valid once it has finished executing.
+  void releaseSecondaries() const;
+
   // Specifically for staging buffer copies
   template <typename T>
   const CommandBuffer&
@@ -1,7 +1,7 @@
 #pragma once
 #include <eldr/vulkan/wrappers/commandbuffer.hpp>
 
-#include <vector>
+#include <deque>
 
 namespace eldr::vk::wr {
 class CommandPool {
@@ -16,6 +16,11 @@ public:
   [[nodiscard]] VkCommandPool vk() const;
 
   [[nodiscard]] const CommandBuffer& requestCommandBuffer();
+  /// @brief Get a secondary command buffer that no primary command buffer
+  /// still uses. Those executed by a primary one become available when it is
+  /// handed out again by `requestCommandBuffer()`. Unlike primary ones, it is
+  /// not begun.
+  [[nodiscard]] const CommandBuffer& requestSecondaryCommandBuffer();
 
 private:
   // std::string name_;
@@ -23,6 +28,8 @@ private:
   class CommandPoolImpl;
   std::unique_ptr<CommandPoolImpl> d_;
 
-  std::vector<CommandBuffer> command_buffers_;
+  // Deques, since references to the command buffers are handed out
+  std::deque<CommandBuffer> command_buffers_;
+  std::deque<CommandBuffer> secondary_command_buffers_;
 };
 } // namespace eldr::vk::wr
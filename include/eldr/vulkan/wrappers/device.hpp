@@ -44,8 +44,13 @@ public:
   [[nodiscard]] VkFormat findDepthFormat() const;
   [[nodiscard]] uint32_t findMemoryType(uint32_t              type_filter,
                                         VkMemoryPropertyFlags properties) const;
+  /// @brief Check whether any memory type has all of `properties`
+  [[nodiscard]] bool hasMemoryType(VkMemoryPropertyFlags properties) const;
 
   [[nodiscard]] const CommandBuffer& requestCommandBuffer() const;
+  /// @brief Get a secondary command buffer from the pool of the calling
+  /// thread. It is not begun, since that needs its inheritance info.
+  [[nodiscard]] const CommandBuffer& requestSecondaryCommandBuffer() const;
 
   // Accessors
   [[nodiscard]] VkSampleCountFlagBits     findMaxMsaaSampleCount() const;
@@ -0,0 +1,26 @@
+#pragma once
+#include <eldr/vulkan/vulkan.hpp>
+
+namespace eldr::vk::wr {
+
+/// @brief Memory allocation that is not tied to a single resource, so that
+/// several resources never in use at the same time can be placed in it
+class DeviceMemory {
+public:
+  DeviceMemory();
+  DeviceMemory(const Device&               device,
+               std::string_view            name,
+               const VkMemoryRequirements& requirements);
+  DeviceMemory(DeviceMemory&&) noexcept;
+  ~DeviceMemory();
+
+  DeviceMemory& operator=(DeviceMemory&&);
+
+  [[nodiscard]] VmaAllocation allocation() const;
+  [[nodiscard]] VkDeviceSize  size() const;
+
+private:
+  class DeviceMemoryImpl;
+  std::unique_ptr<DeviceMemoryImpl> d_;
+};
+} // namespace eldr::vk::wr
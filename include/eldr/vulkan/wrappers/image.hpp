@@ -23,6 +23,13 @@ class Image {
 public:
   Image();
   Image(const Device&, const ImageCreateInfo&);
+  /// @brief Create an image in memory that other images may share. Its
+  /// contents are undefined whenever another image sharing the memory has
+  /// been used since, and `final_layout` is ignored.
+  Image(const Device&,
+        const ImageCreateInfo&,
+        const DeviceMemory& memory,
+        VkDeviceSize        offset = 0);
   Image(const Device&, const Bitmap&);
   Image(const Device&, const Bitmap&, uint32_t mip_levels);
   Image(Image&&) noexcept;
@@ -30,6 +37,10 @@ public:
 
   Image& operator=(Image&&);
 
+  /// @brief Get the memory requirements of an image before creating it
+  [[nodiscard]] static VkMemoryRequirements
+  memoryRequirements(const Device&, const ImageCreateInfo&);
+
   [[nodiscard]] static Image createSwapchainImage(
     const Device&, VkImage, std::string_view name, VkExtent2D, VkFormat);
 
@@ -28,9 +28,11 @@ public:
 
   /// Create/recreate the swapchain
   /// @param extent The swapchain extent
-  void setupSwapchain(const Device&  device,
-                      const Surface& surface,
-                      VkExtent2D     extent);
+  /// @return The previous swapchain with its images, if any. Destroy it once
+  /// the command buffers using its images have finished executing.
+  Swapchain setupSwapchain(const Device&  device,
+                           const Surface& surface,
+                           VkExtent2D     extent);
 
   [[nodiscard]] uint32_t acquireNextImage(uint32_t frame_index,
                                           bool&    invalidate_swapchain) const;
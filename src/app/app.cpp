@@ -83,7 +83,7 @@ void App::mouseScrollCallback(Window* /*window*/,
 
 void App::run()
 {
-  auto scene = Scene::load(*vk_engine_, { model_path }).value_or(nullptr);
+  auto scene = Scene::load(vk_engine_.get(), { model_path }).value_or(nullptr);
   Assert(scene);
   vk_engine_->addScene("Suzanne", scene);
 
@@ -0,0 +1,71 @@
+#include <eldr/app/offline.hpp>
+#include <eldr/core/bitmap.hpp>
+#include <eldr/core/logger.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/render/accel.hpp>
+#include <eldr/render/emitter.hpp>
+#include <eldr/render/film.hpp>
+#include <eldr/render/scene.hpp>
+#include <eldr/render/sensor.hpp>
+
+#include <numbers>
+
+using namespace eldr::core;
+namespace eldr::app {
+
+void OfflineRenderer::run()
+{
+  auto scene =
+    Scene::load(nullptr,
+                { settings_.model_path, settings_.optimize_mesh_layout })
+      .value_or(nullptr);
+  Assert(scene);
+  if (not settings_.environment_path.empty()) {
+    scene->setEnvironment(std::make_shared<EnvironmentEmitter>(
+      Bitmap{ settings_.environment_path }, settings_.environment_scale));
+  }
+  if (scene->emitters.empty()) {
+    Log(Info, "Scene has no emitters, lighting it with a white environment");
+    scene->setEnvironment(std::make_shared<ConstantEmitter>(Color3f{ 1.f }));
+  }
+
+  SceneAccel accel{ *scene, settings_.bvh };
+  // Same view as the Vulkan preview
+  const auto camera{ PerspectiveCamera::lookAt(
+    { 2.f, 2.f, 2.f },
+    { 0.f, 0.f, 0.f },
+    { 0.f, 0.f, 1.f },
+    45.f,
+    { settings_.width, settings_.height }) };
+
+  const PathIntegrator integrator{ settings_.integrator };
+  for (uint32_t frame = 0; frame < settings_.frames; ++frame) {
+    if (frame > 0) {
+      const Float angle{ 2.f * std::numbers::pi_v<Float> *
+                         static_cast<Float>(frame) /
+                         static_cast<Float>(settings_.frames) };
+      scene->setTransform(
+        glm::rotate(Mat4f{ 1.f }, angle, Vec3f{ 0.f, 0.f, 1.f }));
+      accel.update(settings_.tlas_rebuild_threshold);
+    }
+
+    Film film{ camera.filmSize(), settings_.filter };
+    integrator.render(*scene, accel, camera, *settings_.sampler, film);
+    const auto output_path{ frameOutputPath(frame) };
+    film.develop().write(output_path);
+    Log(Info, "Saved render to \"{}\"", output_path.string());
+  }
+}
+
+std::filesystem::path OfflineRenderer::frameOutputPath(uint32_t frame) const
+{
+  if (settings_.frames == 1)
+    return settings_.output_path;
+  auto path{ settings_.output_path };
+  path.replace_filename(fmt::format("{}_{:04}{}",
+                                    path.stem().string(),
+                                    frame,
+                                    path.extension().string()));
+  return path;
+}
+} // namespace eldr::app
@@ -0,0 +1,152 @@
+#include <eldr/core/alias.hpp>
+#include <eldr/core/logger.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/core/parallel.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace eldr::core;
+
+namespace eldr {
+namespace {
+/// Tables with fewer entries than this are built on the calling thread
+constexpr size_t parallel_threshold{ 1u << 16 };
+constexpr size_t chunk_size{ 1u << 14 };
+} // namespace
+
+// -----------------------------------------------------------------------------
+// AliasTable
+// -----------------------------------------------------------------------------
+AliasTable::AliasTable(std::span<const Float> weights)
+  : bins_(weights.size()), pmf_(weights.size())
+{
+  const size_t count{ weights.size() };
+  if (count == 0)
+    return;
+  Assert(count <= std::numeric_limits<uint32_t>::max(), "too many entries");
+
+  // Run `func(first, last)` over chunks of the entries, on the thread pool for
+  // large tables
+  const size_t chunk_count{ (count + chunk_size - 1) / chunk_size };
+  auto         for_chunks = [&](auto&& func) {
+    auto chunk = [&](size_t c) {
+      func(c, c * chunk_size, std::min(count, (c + 1) * chunk_size));
+    };
+    if (count < parallel_threshold) {
+      for (size_t c = 0; c < chunk_count; ++c)
+        chunk(c);
+      return;
+    }
+    parallelFor(BlockedRange<size_t>{ 0, chunk_count },
+                [&](const BlockedRange<size_t>& range) {
+                  for (size_t c = range.begin(); c < range.end(); ++c)
+                    chunk(c);
+                });
+  };
+
+  std::vector<double> chunk_sums(chunk_count, 0.);
+  for_chunks([&](size_t c, size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+      Assert(weights[i] >= 0.f and std::isfinite(weights[i]),
+             "alias table weights must be finite and non-negative");
+      chunk_sums[c] += weights[i];
+    }
+  });
+  for (const double s : chunk_sums)
+    sum_ += s;
+
+  // Scale the weights so that they average to one, and sort the entries into
+  // those that underfill their bin and those that overflow it. Both lists are
+  // filled in chunk order, so the table doesn't depend on the thread count.
+  std::vector<double>   scaled(count);
+  std::vector<uint32_t> chunk_small(chunk_count, 0);
+  const double          scale{ sum_ > 0. ? static_cast<double>(count) / sum_
+                                         : 0. };
+  for_chunks([&](size_t c, size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+      scaled[i] = sum_ > 0. ? weights[i] * scale : 1.;
+      pmf_[i]   = static_cast<Float>(scaled[i] / static_cast<double>(count));
+      if (scaled[i] < 1.)
+        ++chunk_small[c];
+    }
+  });
+  std::vector<size_t> small_offset(chunk_count + 1, 0);
+  for (size_t c = 0; c < chunk_count; ++c)
+    small_offset[c + 1] = small_offset[c] + chunk_small[c];
+  std::vector<uint32_t> small(small_offset.back());
+  std::vector<uint32_t> large(count - small.size());
+  for_chunks([&](size_t c, size_t first, size_t last) {
+    size_t s{ small_offset[c] };
+    size_t l{ first - small_offset[c] };
+    for (size_t i = first; i < last; ++i) {
+      if (scaled[i] < 1.)
+        small[s++] = static_cast<uint32_t>(i);
+      else
+        large[l++] = static_cast<uint32_t>(i);
+    }
+  });
+
+  // Fill each underfull bin with part of an overflowing entry. Each step is a
+  // few operations, so this stays sequential.
+  while (not small.empty() and not large.empty()) {
+    const uint32_t s{ small.back() };
+    const uint32_t l{ large.back() };
+    small.pop_back();
+    bins_[s] = { static_cast<float>(scaled[s]), l };
+    scaled[l] = (scaled[l] + scaled[s]) - 1.;
+    if (scaled[l] < 1.) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  // What is left is full up to rounding errors
+  for (const uint32_t i : large)
+    bins_[i] = { 1.f, i };
+  for (const uint32_t i : small)
+    bins_[i] = { 1.f, i };
+}
+
+uint32_t AliasTable::sampleReuse(Float& u) const
+{
+  const auto  count{ static_cast<uint32_t>(bins_.size()) };
+  const Float x{ u * static_cast<Float>(count) };
+  const auto  index{ std::min(static_cast<uint32_t>(x), count - 1) };
+  const Float frac{ std::min(x - static_cast<Float>(index), one_minus_epsilon) };
+  const Bin&  bin{ bins_[index] };
+  if (frac < bin.q) {
+    u = std::min(frac / bin.q, one_minus_epsilon);
+    return index;
+  }
+  u = std::min((frac - bin.q) / (1.f - bin.q), one_minus_epsilon);
+  return bin.alias;
+}
+
+// -----------------------------------------------------------------------------
+// AliasTable2D
+// -----------------------------------------------------------------------------
+AliasTable2D::AliasTable2D(std::span<const Float> weights, const Vec2u& size)
+  : size_(size), conditional_(size.y)
+{
+  Assert(weights.size() == static_cast<size_t>(size.x) * size.y,
+         "weights don't match the table size");
+  std::vector<Float> row_sums(size.y);
+  parallelFor(BlockedRange<uint32_t>{ 0, size.y },
+              [&](const BlockedRange<uint32_t>& range) {
+                for (uint32_t y = range.begin(); y < range.end(); ++y) {
+                  conditional_[y] = AliasTable{ weights.subspan(
+                    static_cast<size_t>(y) * size.x, size.x) };
+                  row_sums[y] = static_cast<Float>(conditional_[y].sum());
+                }
+              });
+  marginal_ = AliasTable{ row_sums };
+}
+
+AliasTable2D::Vec2u AliasTable2D::sampleReuse(Point2f& u) const
+{
+  const uint32_t y{ marginal_.sampleReuse(u.y) };
+  const uint32_t x{ conditional_[y].sampleReuse(u.x) };
+  return { x, y };
+}
+} // namespace eldr
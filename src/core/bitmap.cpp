@@ -12,8 +12,11 @@ extern "C" {
 
 #include <png.h>
 
+#include <algorithm>
 #include <array>
+#include <bit>
 #include <memory>
+#include <stdexcept>
 #include <string>
 
 using namespace eldr::core;
@@ -200,9 +203,9 @@ void Bitmap::read(Stream* stream, FileFormat format)
     // case FileFormat::RGBE:
     //   read_rgbe(stream);
     //   break;
-    // case FileFormat::PFM:
-    //   read_pfm(stream);
-    //   break;
+    case FileFormat::PFM:
+      readPfm(stream);
+      break;
     // case FileFormat::PPM:
     //   read_ppm(stream);
     //   break;
@@ -217,6 +220,42 @@ void Bitmap::read(Stream* stream, FileFormat format)
   }
 }
 
+void Bitmap::write(const std::filesystem::path& path, FileFormat format) const
+{
+  if (format == FileFormat::Auto) {
+    std::string extension{ path.extension().string() };
+    std::transform(extension.begin(),
+                   extension.end(),
+                   extension.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    if (extension == ".pfm")
+      format = FileFormat::PFM;
+    else
+      Throw("Unable to deduce the file format of \"{}\"", path.string());
+  }
+  Log(Debug,
+      "Writing {} file \"{}\" ({}x{}, {}, {}) ..",
+      format,
+      path.string(),
+      size_.x,
+      size_.y,
+      pixel_format_,
+      component_format_);
+  auto fs = std::make_unique<FileStream>(path, FileStream::ETruncReadWrite);
+  write(fs.get(), format);
+}
+
+void Bitmap::write(Stream* stream, FileFormat format) const
+{
+  switch (format) {
+    case FileFormat::PFM:
+      writePfm(stream);
+      break;
+    default:
+      Throw("Writing is not implemented for FileFormat::'{}'", format);
+  }
+}
+
 Bitmap::FileFormat Bitmap::detectFileFormat(Stream* stream)
 {
   FileFormat format = FileFormat::Unknown;
@@ -232,9 +271,6 @@ Bitmap::FileFormat Bitmap::detectFileFormat(Stream* stream)
   //  else if (start[0] == '#' && start[1] == '?') {
   //    format = FileFormat::RGBE;
   //  }
-  //  else if (start[0] == 'P' && (start[1] == 'F' || start[1] == 'f')) {
-  //    format = FileFormat::PFM;
-  //  }
   //  else if (start[0] == 'P' && start[1] == '6') {
   //    format = FileFormat::PPM;
   //  }
@@ -244,6 +280,9 @@ Bitmap::FileFormat Bitmap::detectFileFormat(Stream* stream)
   else if (png_sig_cmp(start, 0, 8) == 0) {
     format = FileFormat::PNG;
   }
+  else if (start[0] == 'P' && (start[1] == 'F' || start[1] == 'f')) {
+    format = FileFormat::PFM;
+  }
   //  else if (Imf::isImfMagic((const char*) start)) {
   //    format = FileFormat::OpenEXR;
   //  }
@@ -671,6 +710,81 @@ void Bitmap::readPng(Stream* stream)
   delete[] rows;
 }
 
+void Bitmap::readPfm(Stream* stream)
+{
+  const std::string magic{ stream->readToken() };
+  if (magic != "PF" and magic != "Pf")
+    Throw("readPfm(): Invalid header {}", magic);
+  pixel_format_ = magic == "PF" ? PixelFormat::RGB : PixelFormat::Y;
+  // The sign of the scale gives the byte order, its magnitude is ignored
+  float scale;
+  try {
+    size_.x = static_cast<uint32_t>(std::stoul(stream->readToken()));
+    size_.y = static_cast<uint32_t>(std::stoul(stream->readToken()));
+    scale   = std::stof(stream->readToken());
+  }
+  catch (const std::logic_error&) {
+    Throw("readPfm(): Invalid image size or scale");
+  }
+  const bool little_endian{ scale < 0.f };
+
+  component_format_    = StructType::Float32;
+  srgb_gamma_          = false;
+  premultiplied_alpha_ = false;
+  rebuildStruct();
+
+  auto fs = dynamic_cast<FileStream*>(stream);
+  Log(Trace,
+      "Loading PFM file \"{}\" ({}x{}, {}) ..",
+      fs ? fs->path().string() : "<stream>",
+      size_.x,
+      size_.y,
+      pixel_format_);
+
+  data_      = std::make_unique<byte_t[]>(bufferSize());
+  owns_data_ = true;
+
+  // Scanlines are stored from bottom to top
+  const size_t row_bytes{ bytesPerPixel() * size_.x };
+  for (size_t y = 0; y < size_.y; ++y)
+    stream->read(data() + (size_.y - 1 - y) * row_bytes, row_bytes);
+
+  if (little_endian != (std::endian::native == std::endian::little)) {
+    auto* values{ reinterpret_cast<uint32_t*>(data()) };
+    for (size_t i = 0; i < bufferSize() / sizeof(uint32_t); ++i) {
+      const uint32_t v{ values[i] };
+      values[i] = (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) |
+                  (v << 24);
+    }
+  }
+}
+
+void Bitmap::writePfm(Stream* stream) const
+{
+  if (component_format_ != StructType::Float32)
+    Throw("writePfm(): Unsupported component format {}, expected {}",
+          component_format_,
+          StructType::Float32);
+  if (pixel_format_ != PixelFormat::Y and pixel_format_ != PixelFormat::RGB)
+    Throw("writePfm(): Unsupported pixel format {}, expected Y or RGB",
+          pixel_format_);
+
+  // A negative scale marks little endian data
+  const bool        little_endian{ std::endian::native == std::endian::little };
+  const std::string header{ fmt::format("{}\n{} {}\n{}\n",
+                                        pixel_format_ == PixelFormat::RGB ? "PF"
+                                                                          : "Pf",
+                                        size_.x,
+                                        size_.y,
+                                        little_endian ? "-1" : "1") };
+  stream->write(header.data(), header.size());
+
+  // Scanlines are stored from bottom to top
+  const size_t row_bytes{ bytesPerPixel() * size_.x };
+  for (size_t y = 0; y < size_.y; ++y)
+    stream->write(data() + (size_.y - 1 - y) * row_bytes, row_bytes);
+}
+
 void Bitmap::rgbToRgba()
 {
   if (pixel_format_ != PixelFormat::RGB)
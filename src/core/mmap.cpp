@@ -0,0 +1,93 @@
+#include <eldr/core/logger.hpp>
+#include <eldr/core/mmap.hpp>
+#include <eldr/core/platform.hpp>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <cerrno>
+#  include <cstring>
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace eldr {
+#if defined(_WIN32)
+MemoryMappedFile::MemoryMappedFile(const std::filesystem::path& path)
+  : path_(path)
+{
+  file_ = CreateFileW(path.c_str(),
+                      GENERIC_READ,
+                      FILE_SHARE_READ,
+                      nullptr,
+                      OPEN_EXISTING,
+                      FILE_ATTRIBUTE_NORMAL,
+                      nullptr);
+  if (file_ == INVALID_HANDLE_VALUE)
+    Throw("{}: could not open file for mapping", path.string());
+
+  LARGE_INTEGER size;
+  GetFileSizeEx(file_, &size);
+  size_ = static_cast<size_t>(size.QuadPart);
+  if (size_ == 0)
+    return;
+
+  mapping_ = CreateFileMappingW(file_, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+  if (mapping_ != nullptr)
+    data_ = MapViewOfFile(mapping_, FILE_MAP_COPY, 0, 0, 0);
+  if (data_ == nullptr) {
+    if (mapping_ != nullptr)
+      CloseHandle(mapping_);
+    CloseHandle(file_);
+    Throw("{}: could not map file", path.string());
+  }
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+  if (data_ != nullptr)
+    UnmapViewOfFile(data_);
+  if (mapping_ != nullptr)
+    CloseHandle(mapping_);
+  if (file_ != nullptr and file_ != INVALID_HANDLE_VALUE)
+    CloseHandle(file_);
+}
+#else
+MemoryMappedFile::MemoryMappedFile(const std::filesystem::path& path)
+  : path_(path)
+{
+  const int fd{ open(path.c_str(), O_RDONLY) };
+  if (fd == -1)
+    Throw("{}: could not open file for mapping: {}",
+          path.string(),
+          strerror(errno));
+
+  struct stat info;
+  if (fstat(fd, &info) == -1) {
+    close(fd);
+    Throw("{}: could not get file size: {}", path.string(), strerror(errno));
+  }
+  size_ = static_cast<size_t>(info.st_size);
+
+  if (size_ > 0) {
+    void* data{ mmap(
+      nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) };
+    if (data == MAP_FAILED) {
+      close(fd);
+      Throw("{}: could not map file: {}", path.string(), strerror(errno));
+    }
+    data_ = data;
+  }
+  // The mapping stays valid after the descriptor is closed
+  close(fd);
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+  if (data_ != nullptr)
+    munmap(data_, size_);
+}
+#endif
+} // namespace eldr
@@ -0,0 +1,204 @@
+#include <eldr/core/logger.hpp>
+#include <eldr/core/parallel.hpp>
+#include <eldr/core/thread.hpp>
+#include <eldr/core/util.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+namespace eldr::core {
+
+static std::unique_ptr<ThreadPool> global_pool{ nullptr };
+// Pool and queue index of the calling thread, if it is a worker
+static thread_local ThreadPool* local_pool{ nullptr };
+static thread_local uint32_t    local_index{ 0 };
+
+struct ThreadPool::ThreadPoolImpl {
+  // Each queue on its own cache line to avoid false sharing between workers
+  struct alignas(64) Queue {
+    std::mutex       mutex;
+    std::deque<Task> tasks;
+  };
+
+  /// One queue per worker, followed by the shared queue for other threads
+  std::vector<std::unique_ptr<Queue>>        queues;
+  std::vector<std::unique_ptr<WorkerThread>> workers;
+
+  /// Number of tasks sitting in any of the queues
+  std::atomic<uint32_t> pending{ 0 };
+  /// Number of workers waiting for `wakeup`
+  std::atomic<uint32_t>   sleeping{ 0 };
+  std::mutex              sleep_mutex;
+  std::condition_variable wakeup;
+  bool                    stop{ false };
+
+  [[nodiscard]] Queue& sharedQueue() { return *queues.back(); }
+};
+
+ThreadPool::ThreadPool(uint32_t thread_count)
+  : impl_(std::make_unique<ThreadPoolImpl>())
+{
+  thread_count = std::max(1u, thread_count);
+  for (uint32_t i = 0; i <= thread_count; ++i)
+    impl_->queues.push_back(std::make_unique<ThreadPoolImpl::Queue>());
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    impl_->workers.push_back(
+      std::make_unique<WorkerThread>("wrk", [this, i] { workerLoop(i); }));
+    impl_->workers.back()->start();
+  }
+  Log(Debug, "Started thread pool with {} workers", thread_count);
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard lock{ impl_->sleep_mutex };
+    impl_->stop = true;
+  }
+  impl_->wakeup.notify_all();
+  for (auto& worker : impl_->workers)
+    worker->join();
+}
+
+uint32_t ThreadPool::threadCount() const
+{
+  return static_cast<uint32_t>(impl_->workers.size());
+}
+
+void ThreadPool::submit(Task task)
+{
+  ThreadPoolImpl::Queue& queue{ local_pool == this
+                                  ? *impl_->queues[local_index]
+                                  : impl_->sharedQueue() };
+  {
+    std::lock_guard lock{ queue.mutex };
+    queue.tasks.push_back(std::move(task));
+  }
+  impl_->pending.fetch_add(1);
+  // Taking the lock makes sure that a worker which just found no work is
+  // either already waiting, or will see the new task before it does
+  if (impl_->sleeping.load() > 0) {
+    { std::lock_guard lock{ impl_->sleep_mutex }; }
+    impl_->wakeup.notify_one();
+  }
+}
+
+bool ThreadPool::runPendingTask()
+{
+  if (impl_->pending.load(std::memory_order_relaxed) == 0)
+    return false;
+
+  Task task;
+  auto pop_back = [&](ThreadPoolImpl::Queue& queue) {
+    std::lock_guard lock{ queue.mutex };
+    if (queue.tasks.empty())
+      return false;
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+  };
+  auto pop_front = [&](ThreadPoolImpl::Queue& queue) {
+    std::lock_guard lock{ queue.mutex };
+    if (queue.tasks.empty())
+      return false;
+    task = std::move(queue.tasks.front());
+    queue.tasks.pop_front();
+    return true;
+  };
+
+  // Newest local task first since its data is most likely still in cache,
+  // then the oldest shared task, then steal the oldest (i.e. largest) task
+  // from another worker
+  const bool is_worker{ local_pool == this };
+  const auto queue_count{ static_cast<uint32_t>(impl_->queues.size()) };
+  bool       found{ (is_worker and pop_back(*impl_->queues[local_index])) or
+              pop_front(impl_->sharedQueue()) };
+  const uint32_t first_victim{ is_worker ? local_index + 1 : 0 };
+  for (uint32_t i = 0; not found and i < queue_count - 1; ++i) {
+    const uint32_t victim{ (first_victim + i) % (queue_count - 1) };
+    if (is_worker and victim == local_index)
+      continue;
+    found = pop_front(*impl_->queues[victim]);
+  }
+  if (not found)
+    return false;
+
+  impl_->pending.fetch_sub(1);
+  try {
+    task();
+  }
+  catch (const std::exception& e) {
+    Log(Warn, "Uncaught exception in task: {}", e.what());
+  }
+  catch (...) {
+    Log(Warn, "Uncaught exception of unknown type in task");
+  }
+  return true;
+}
+
+void ThreadPool::workerLoop(uint32_t index)
+{
+  local_pool  = this;
+  local_index = index;
+  while (true) {
+    if (runPendingTask())
+      continue;
+    std::unique_lock lock{ impl_->sleep_mutex };
+    impl_->sleeping.fetch_add(1);
+    impl_->wakeup.wait(
+      lock, [this] { return impl_->stop or impl_->pending.load() > 0; });
+    impl_->sleeping.fetch_sub(1);
+    if (impl_->stop and impl_->pending.load() == 0)
+      break;
+  }
+  local_pool = nullptr;
+}
+
+void ThreadPool::createContext(uint32_t thread_count)
+{
+  Assert(not global_pool, "thread pool already exists");
+  if (thread_count == 0)
+    thread_count = util::coreCount();
+  global_pool = std::make_unique<ThreadPool>(thread_count);
+}
+
+void ThreadPool::releaseContext() { global_pool.reset(); }
+
+ThreadPool* ThreadPool::instance() { return global_pool.get(); }
+
+// -----------------------------------------------------------------------------
+// TaskGroup
+// -----------------------------------------------------------------------------
+TaskGroup::~TaskGroup()
+{
+  // Tasks reference the group, so they must not outlive it. Exceptions can't
+  // be propagated from here, wait() should have been called before.
+  while (pending_.load(std::memory_order_acquire) > 0) {
+    if (not pool_->runPendingTask())
+      std::this_thread::yield();
+  }
+}
+
+void TaskGroup::wait()
+{
+  while (pending_.load(std::memory_order_acquire) > 0) {
+    if (not pool_->runPendingTask())
+      std::this_thread::yield();
+  }
+  std::exception_ptr exception;
+  {
+    std::lock_guard lock{ exception_mutex_ };
+    std::swap(exception, exception_);
+  }
+  if (exception)
+    std::rethrow_exception(exception);
+}
+
+void TaskGroup::setException(std::exception_ptr exception)
+{
+  std::lock_guard lock{ exception_mutex_ };
+  if (not exception_)
+    exception_ = std::move(exception);
+}
+} // namespace eldr::core
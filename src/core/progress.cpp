@@ -63,9 +63,10 @@ void ProgressReporter::update(float progress)
     return;
   }
 
-  if (bar_size_ > 0) {
-    const size_t progress_count{ std::min(
-      bar_size_, static_cast<size_t>(std::round(bar_size_ * progress))) };
+  // Nothing to draw before the first '=' of the bar
+  const size_t progress_count{ std::min(
+    bar_size_, static_cast<size_t>(std::round(bar_size_ * progress))) };
+  if (progress_count > 0) {
     size_t       eta_pos{ bar_start_ + bar_size_ + 2 };
     size_t       arrowhead_pos{ bar_start_ + progress_count - 1 };
     // clang-format off
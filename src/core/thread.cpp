@@ -2,14 +2,14 @@
 #include <eldr/core/thread.hpp>
 #include <eldr/core/util.hpp>
 
-#include <thread>
+#include <cassert>
+#include <mutex>
 #include <unordered_map>
 
 namespace eldr::core {
 
 static std::shared_ptr<Thread>                  main_thread{ nullptr };
-static thread_local std::shared_ptr<Thread>     self{ nullptr };
-static std::thread::id                          this_thread_id;
+static thread_local Thread*                     self{ nullptr };
 static std::unordered_map<std::string, Thread*> thread_map;
 static std::mutex                               thread_map_mutex;
 
@@ -21,43 +21,61 @@ public:
   virtual void run() override { Log(Error, "Main thread is already running!"); }
 };
 
-class WorkerThread : public Thread {
-  WorkerThread(const std::string& prefix)
-    : Thread(fmt::format("{}{}", prefix, counter_++)) {};
+std::atomic<uint32_t> WorkerThread::counter_{ 0 };
 
-  virtual void run() override
-  {
-    Log(Error, "Worker thread is already running!");
-  }
+WorkerThread::WorkerThread(std::string_view prefix, std::function<void()> func)
+  : Thread(fmt::format("{}{}", prefix, counter_++)), func_(std::move(func))
+{
+}
 
-protected:
-  virtual ~WorkerThread()
+Thread::~Thread()
+{
+  if (thread_.joinable())
+    thread_.join();
+  std::lock_guard guard{ thread_map_mutex };
+  if (auto it{ thread_map.find(name_) }; it != thread_map.end() and
+                                         it->second == this)
+    thread_map.erase(it);
+}
+
+void Thread::start()
+{
+  Assert(not thread_.joinable(), "thread is already running");
+  // Share the sinks and formatter of the thread that spawned this one
+  if (Logger* parent_logger{ thread()->logger() }; parent_logger)
+    logger_ = std::make_unique<Logger>(*parent_logger);
   {
     std::lock_guard guard{ thread_map_mutex };
-    thread_map.erase(this->name());
-  };
-  static std::atomic<uint32_t> counter_;
-};
+    thread_map[name_] = this;
+  }
+  thread_ = std::thread([this] {
+    self = this;
+    try {
+      run();
+    }
+    catch (const std::exception& e) {
+      Log(Warn, "Uncaught exception in thread \"{}\": {}", name_, e.what());
+    }
+    self = nullptr;
+  });
+}
 
-std::atomic<uint32_t> WorkerThread::counter_{ 0 };
+void Thread::join()
+{
+  if (thread_.joinable())
+    thread_.join();
+}
 
 void Thread::createContext()
 {
   assert(not main_thread);
-  // global_thread_count = util::coreCount();
-  //  this_thread_id      = std::this_thread::get_id();
-
-  self = std::make_shared<MainThread>();
-
-  // self->d->running = true;
-  //  self->d->fresolver = new FileResolver();
-  main_thread = self;
+  main_thread = std::make_shared<MainThread>();
+  self        = main_thread.get();
 }
 
 Thread* Thread::thread()
 {
-  // notifier.ensureInitialized();
-  Thread* self_val = self.get();
+  Thread* self_val = self;
   assert(self_val);
   return self_val;
 }
@@ -1,7 +1,9 @@
 #include <eldr/core/util.hpp>
 #include <eldr/eldr.hpp>
 
+#include <algorithm>
 #include <sstream>
+#include <thread>
 
 #ifdef _WIN32
 #  include <windows.h>
@@ -31,6 +33,11 @@ std::string infoBuild(int thread_count)
   return oss.str();
 }
 
+uint32_t coreCount()
+{
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
 std::string infoCopyright()
 {
   std::ostringstream oss;
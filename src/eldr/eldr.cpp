@@ -1,20 +1,66 @@
 #include <eldr/app/app.hpp>
+#include <eldr/app/offline.hpp>
 #include <eldr/core/logger.hpp>
+#include <eldr/core/parallel.hpp>
 #include <eldr/core/util.hpp>
+#include <eldr/render/rfilter.hpp>
+#include <eldr/render/sampler.hpp>
 
 #include <cxxopts.hpp>
 
 #include <iostream>
+#include <memory>
+#include <optional>
 
 using namespace eldr::core;
 
 namespace {
 void help(std::string_view help)
 {
-  std::cout << util::infoBuild(1) << "\n";
+  std::cout << util::infoBuild(util::coreCount()) << "\n";
   std::cout << util::infoCopyright() << "\n";
   std::cout << help << "\n";
 }
+
+std::optional<eldr::TileOrder> parseTileOrder(std::string_view name)
+{
+  if (name == "scanline")
+    return eldr::TileOrder::Scanline;
+  if (name == "morton")
+    return eldr::TileOrder::Morton;
+  if (name == "spiral")
+    return eldr::TileOrder::Spiral;
+  return std::nullopt;
+}
+
+std::optional<eldr::ExecutionMode> parseExecutionMode(std::string_view name)
+{
+  if (name == "megakernel")
+    return eldr::ExecutionMode::Megakernel;
+  if (name == "wavefront")
+    return eldr::ExecutionMode::Wavefront;
+  return std::nullopt;
+}
+
+std::shared_ptr<eldr::ReconstructionFilter> parseFilter(std::string_view name)
+{
+  if (name == "box")
+    return std::make_shared<eldr::BoxFilter>();
+  if (name == "tent")
+    return std::make_shared<eldr::TentFilter>();
+  if (name == "gaussian")
+    return std::make_shared<eldr::GaussianFilter>();
+  return nullptr;
+}
+
+std::shared_ptr<eldr::Sampler> parseSampler(std::string_view name)
+{
+  if (name == "independent")
+    return std::make_shared<eldr::IndependentSampler>();
+  if (name == "sobol")
+    return std::make_shared<eldr::SobolSampler>();
+  return nullptr;
+}
 } // namespace
 
 int main(int argc, char* argv[])
@@ -28,6 +74,63 @@ int main(int argc, char* argv[])
     ("t,threads",
     "Number of threads to render with. 0 will maximize performance.",
     cxxopts::value<int>()->default_value("0"))
+    ("r,render",
+    "Render the scene with the CPU path tracer and write the image (PFM) to the given file instead of opening the viewer.",
+    cxxopts::value<std::string>())
+    ("scene",
+    "Scene to render, relative to ELDR_DIR.",
+    cxxopts::value<std::string>()->default_value("assets/models/Suzanne.gltf"))
+    ("spp",
+    "Samples per pixel of offline renders.",
+    cxxopts::value<uint32_t>()->default_value("16"))
+    ("frames",
+    "Number of frames of an offline turntable render, rotating the scene once around +z. Frame numbers are appended to the output file name.",
+    cxxopts::value<uint32_t>()->default_value("1"))
+    ("width",
+    "Width of offline renders in pixels.",
+    cxxopts::value<uint32_t>()->default_value("1280"))
+    ("height",
+    "Height of offline renders in pixels.",
+    cxxopts::value<uint32_t>()->default_value("720"))
+    ("tile-order",
+    "Order in which tiles of offline renders are scheduled: scanline, morton or spiral.",
+    cxxopts::value<std::string>()->default_value("spiral"))
+    ("mode",
+    "Execution mode of the path tracer for offline renders: megakernel or wavefront.",
+    cxxopts::value<std::string>()->default_value("megakernel"))
+    ("packet-size",
+    "Number of camera rays traced together in wavefront mode: 8, 16, or 0 for single rays.",
+    cxxopts::value<uint32_t>()->default_value("16"))
+    ("quantize-bvh",
+    "Store the BVH nodes of offline renders quantized to 8 bits, for less memory traffic on large scenes.")
+    ("environment",
+    "Equirectangular image (PFM, PNG or JPEG) lighting offline renders from all around, with +z up.",
+    cxxopts::value<std::string>()->default_value(""))
+    ("environment-scale",
+    "Factor applied to the radiance of the environment image.",
+    cxxopts::value<float>()->default_value("1"))
+    ("uniform-lights",
+    "Pick emitters uniformly for next event estimation in offline renders, instead of with the light BVH.")
+    ("guiding-passes",
+    "Number of training passes for path guiding in offline renders, doubling in samples per pixel. 0 disables guiding, which needs the megakernel mode.",
+    cxxopts::value<uint32_t>()->default_value("0"))
+    ("restir-candidates",
+    "Number of emitter candidates resampled per pixel with ReSTIR for the direct light in offline renders. 0 disables ReSTIR, which needs the megakernel mode and no path guiding.",
+    cxxopts::value<uint32_t>()->default_value("0"))
+    ("optimize-meshes",
+    "Reorder the triangles and vertices of meshes along a Morton curve when loading offline renders.")
+    ("bvh-cache",
+    "Directory to cache the BVHs of offline renders in, so they are only built on the first run. Disabled if empty.",
+    cxxopts::value<std::string>()->default_value(""))
+    ("adaptive-threshold",
+    "Relative error at which tiles of offline renders stop receiving samples. 0 disables adaptive sampling.",
+    cxxopts::value<float>()->default_value("0.01"))
+    ("sampler",
+    "Sample generator of offline renders: independent or sobol.",
+    cxxopts::value<std::string>()->default_value("sobol"))
+    ("filter",
+    "Pixel reconstruction filter of offline renders: box, tent or gaussian.",
+    cxxopts::value<std::string>()->default_value("gaussian"))
     ("h,help", "Prints help.");
   // clang-format on
 
@@ -38,23 +141,109 @@ int main(int argc, char* argv[])
     return 0;
   }
   const int threads{ result["threads"].as<int>() };
+  if (threads < 0) {
+    std::cerr << "Number of threads can't be negative\n";
+    return EXIT_FAILURE;
+  }
+
+  std::optional<eldr::app::OfflineRenderer::Settings> offline_settings;
+  if (result.count("render")) {
+    auto& settings{ offline_settings.emplace() };
+    settings.output_path    = result["render"].as<std::string>();
+    settings.model_path     = result["scene"].as<std::string>();
+    settings.width          = result["width"].as<uint32_t>();
+    settings.height         = result["height"].as<uint32_t>();
+    settings.frames         = result["frames"].as<uint32_t>();
+    settings.integrator.spp = result["spp"].as<uint32_t>();
+    const auto tile_order{ parseTileOrder(
+      result["tile-order"].as<std::string>()) };
+    if (not tile_order) {
+      std::cerr << "Unknown tile order\n";
+      return EXIT_FAILURE;
+    }
+    settings.integrator.tile_order = *tile_order;
+    const auto mode{ parseExecutionMode(result["mode"].as<std::string>()) };
+    if (not mode) {
+      std::cerr << "Unknown execution mode\n";
+      return EXIT_FAILURE;
+    }
+    settings.integrator.mode = *mode;
+    settings.integrator.packet_size = result["packet-size"].as<uint32_t>();
+    if (settings.integrator.packet_size != 0 and
+        settings.integrator.packet_size != 8 and
+        settings.integrator.packet_size != 16) {
+      std::cerr << "Packet size must be 0, 8 or 16\n";
+      return EXIT_FAILURE;
+    }
+    settings.integrator.adaptive_threshold =
+      result["adaptive-threshold"].as<float>();
+    settings.bvh.quantize_wide_nodes = result.count("quantize-bvh") > 0;
+    settings.bvh.cache_dir = result["bvh-cache"].as<std::string>();
+    settings.optimize_mesh_layout = result.count("optimize-meshes") > 0;
+    settings.integrator.use_light_bvh = result.count("uniform-lights") == 0;
+    settings.integrator.guiding_passes = result["guiding-passes"].as<uint32_t>();
+    if (settings.integrator.guiding_passes > 0 and
+        settings.integrator.mode != eldr::ExecutionMode::Megakernel) {
+      std::cerr << "Path guiding needs the megakernel mode\n";
+      return EXIT_FAILURE;
+    }
+    settings.integrator.restir_candidates =
+      result["restir-candidates"].as<uint32_t>();
+    if (settings.integrator.restir_candidates > 0 and
+        (settings.integrator.mode != eldr::ExecutionMode::Megakernel or
+         settings.integrator.guiding_passes > 0)) {
+      std::cerr << "ReSTIR needs the megakernel mode and no path guiding\n";
+      return EXIT_FAILURE;
+    }
+    settings.environment_path  = result["environment"].as<std::string>();
+    settings.environment_scale = result["environment-scale"].as<float>();
+    settings.filter = parseFilter(result["filter"].as<std::string>());
+    if (not settings.filter) {
+      std::cerr << "Unknown reconstruction filter\n";
+      return EXIT_FAILURE;
+    }
+    settings.sampler = parseSampler(result["sampler"].as<std::string>());
+    if (not settings.sampler) {
+      std::cerr << "Unknown sampler\n";
+      return EXIT_FAILURE;
+    }
+    if (settings.width == 0 or settings.height == 0 or
+        settings.integrator.spp == 0 or settings.frames == 0) {
+      std::cerr << "Image size, sample and frame counts must be positive\n";
+      return EXIT_FAILURE;
+    }
+    if (settings.integrator.adaptive_threshold < 0.f) {
+      std::cerr << "Adaptive sampling threshold can't be negative\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  ThreadPool::createContext(static_cast<uint32_t>(threads));
 
   std::cout <<
     R"(###########################################
 Running Eldr with the following settings:
     Number of threads: )"
-            << threads << R"(
+            << ThreadPool::instance()->threadCount() << R"(
 ###########################################
 )";
 
-  // Run Eldr main app
-  eldr::app::App main_app;
   try {
-    main_app.run();
+    if (offline_settings) {
+      eldr::app::OfflineRenderer renderer{ *offline_settings };
+      renderer.run();
+    }
+    else {
+      // Run Eldr main app
+      eldr::app::App main_app;
+      main_app.run();
+    }
   }
   catch (const std::exception& e) {
     Log(eldr::core::Critical, "{}", e.what());
+    ThreadPool::releaseContext();
     return EXIT_FAILURE;
   }
+  ThreadPool::releaseContext();
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,510 @@
+#include <eldr/core/fstream.hpp>
+#include <eldr/core/hash.hpp>
+#include <eldr/core/logger.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/core/mmap.hpp>
+#include <eldr/core/mstream.hpp>
+#include <eldr/core/parallel.hpp>
+#include <eldr/render/accel.hpp>
+#include <eldr/render/mesh.hpp>
+#include <eldr/render/scene.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <filesystem>
+#include <unordered_map>
+
+using namespace eldr::core;
+
+namespace eldr {
+namespace {
+/// Identifies BVH cache files, and that they were written with the same byte
+/// order
+constexpr uint32_t cache_magic{ 0x48564245 }; // "EBVH"
+/// Version of the cache file layout, bump when it changes
+constexpr uint32_t cache_version{ 2 };
+
+/// @brief Hash the settings that affect the built tree, for keying the cache.
+/// Node and triangle layouts are covered by their sizes, other layout changes
+/// by `cache_version`.
+uint64_t hashSettings(const BVHBuildSettings& settings)
+{
+  const uint32_t values[]{
+    settings.bin_count,
+    settings.max_leaf_size,
+    std::bit_cast<uint32_t>(settings.traversal_cost),
+    std::bit_cast<uint32_t>(settings.intersection_cost),
+    settings.quantize_wide_nodes,
+    static_cast<uint32_t>(sizeof(WideBVH8::Node)),
+    static_cast<uint32_t>(sizeof(QuantizedWideBVH8::Node)),
+    static_cast<uint32_t>(sizeof(TriangleBlock4)),
+  };
+  return hashBuffer(values, sizeof(values), cache_version);
+}
+
+/// @brief Get the largest distance any ray of a packet still needs to be
+/// traced to, given the closest hits found so far
+template <uint32_t Size>
+Float farthestHit(const RayPacket<Size>&         packet,
+                  const PreliminaryIntersection* pi)
+{
+  Float maxt{ 0.f };
+  for (uint32_t i = 0; i < Size; ++i) {
+    if (packet.isActive(i))
+      maxt = std::max(maxt, std::min(packet.maxt[i], pi[i].t));
+  }
+  return maxt;
+}
+
+/// @brief Get the bounds of `bbox` after transforming it by `m`
+template <typename Mat4f>
+BoundingBox3f transformBBox(const Mat4f& m, const BoundingBox3f& bbox)
+{
+  using Point3f = CoreAliases<Float>::Point3f;
+  using Vec4f   = CoreAliases<Float>::Vec4f;
+  BoundingBox3f result;
+  for (uint32_t corner = 0; corner < 8; ++corner) {
+    const Point3f p{ corner & 1 ? bbox.max.x : bbox.min.x,
+                     corner & 2 ? bbox.max.y : bbox.min.y,
+                     corner & 4 ? bbox.max.z : bbox.min.z };
+    result.expand(Point3f{ m * Vec4f{ p, 1.f } });
+  }
+  return result;
+}
+} // namespace
+
+// -----------------------------------------------------------------------------
+// MeshAccel
+// -----------------------------------------------------------------------------
+MeshAccel::MeshAccel(const Mesh& mesh, const BVHBuildSettings& settings)
+  : mesh_(&mesh), quantized_(settings.quantize_wide_nodes)
+{
+  if (settings.cache_dir.empty()) {
+    build(settings);
+    return;
+  }
+
+  const uint64_t geometry_hash{ mesh.geometryHash() };
+  const uint64_t settings_hash{ hashSettings(settings) };
+  const std::filesystem::path path{
+    settings.cache_dir /
+    fmt::format("{:016x}-{:016x}.bvh", geometry_hash, settings_hash)
+  };
+  if (loadCache(path, geometry_hash, settings_hash)) {
+    Log(Debug, "Loaded BVH of mesh \"{}\" from {}", mesh.name(), path.string());
+    return;
+  }
+  build(settings);
+  saveCache(path, geometry_hash, settings_hash);
+}
+
+void MeshAccel::build(const BVHBuildSettings& settings)
+{
+  const Mesh& mesh{ *mesh_ };
+  const auto& positions{ mesh.vtxPositions() };
+  std::vector<BoundingBox3f> prim_bounds;
+  prim_bounds.reserve(mesh.faceCount());
+  for (size_t f = 0; f < mesh.faceCount(); ++f) {
+    const Vec3u   idx{ mesh.faceIndices(f) };
+    BoundingBox3f bbox{ positions[idx.x] };
+    bbox.expand(positions[idx.y]);
+    bbox.expand(positions[idx.z]);
+    prim_bounds.push_back(bbox);
+  }
+  const BVH binary_bvh{ prim_bounds, settings };
+  if (quantized_)
+    quantized_bvh_.build(binary_bvh, Block::width);
+  else
+    bvh_.build(binary_bvh, Block::width);
+
+  // Pack the triangles into blocks in leaf order, so a leaf is intersected
+  // with one kernel call per block
+  const std::span<const uint32_t> prims{ visitBVH(
+    [](const auto& bvh) { return bvh.primIndices(); }) };
+  blocks_.resize((prims.size() + Block::width - 1) / Block::width);
+  for (size_t i = 0; i < prims.size(); ++i) {
+    if (prims[i] == WideBVH8::Node::invalid)
+      continue;
+    const Vec3u idx{ mesh.faceIndices(prims[i]) };
+    blocks_[i / Block::width].set(i % Block::width,
+                                  prims[i],
+                                  positions[idx.x],
+                                  positions[idx.y],
+                                  positions[idx.z]);
+  }
+}
+
+bool MeshAccel::intersectLeaf(const Ray3f&             ray,
+                              uint32_t                 first,
+                              uint32_t                 count,
+                              Float                    maxt,
+                              PreliminaryIntersection& pi) const
+{
+  bool           hit{ false };
+  const uint32_t end{ (first + count + Block::width - 1) / Block::width };
+  for (uint32_t b = first / Block::width; b < end; ++b) {
+    const Block&      block{ blocks_[b] };
+    alignas(32) Float t[Block::width], u[Block::width], v[Block::width];
+    uint32_t          mask{ block.intersect(ray, maxt, t, u, v) };
+    while (mask != 0) {
+      const auto i{ static_cast<uint32_t>(std::countr_zero(mask)) };
+      mask &= mask - 1;
+      if (t[i] >= maxt)
+        continue;
+      maxt          = t[i];
+      pi.t          = t[i];
+      pi.prim_uv    = { u[i], v[i] };
+      pi.prim_index = block.prim_index[i];
+      hit           = true;
+    }
+  }
+  return hit;
+}
+
+bool MeshAccel::occludedLeaf(const Ray3f& ray,
+                             uint32_t     first,
+                             uint32_t     count,
+                             Float        maxt) const
+{
+  const uint32_t end{ (first + count + Block::width - 1) / Block::width };
+  for (uint32_t b = first / Block::width; b < end; ++b) {
+    alignas(32) Float t[Block::width], u[Block::width], v[Block::width];
+    if (blocks_[b].intersect(ray, maxt, t, u, v) != 0)
+      return true;
+  }
+  return false;
+}
+
+bool MeshAccel::rayIntersect(const Ray3f&             ray,
+                             PreliminaryIntersection& pi) const
+{
+  return visitBVH([&](const auto& bvh) {
+    return bvh.traverseLeaves(
+      ray, [&](uint32_t first, uint32_t count, Float& maxt) {
+        if (not intersectLeaf(ray, first, count, std::min(maxt, pi.t), pi))
+          return false;
+        maxt = pi.t;
+        return true;
+      });
+  });
+}
+
+bool MeshAccel::occluded(const Ray3f& ray) const
+{
+  return visitBVH([&](const auto& bvh) {
+    return bvh.occludedLeaves(
+      ray, [&](uint32_t first, uint32_t count, Float maxt) {
+        return occludedLeaf(ray, first, count, maxt);
+      });
+  });
+}
+
+bool MeshAccel::loadCache(const std::filesystem::path& path,
+                          uint64_t                     geometry_hash,
+                          uint64_t                     settings_hash)
+{
+  if (not std::filesystem::exists(path))
+    return false;
+  try {
+    // Only the pages that are read get loaded, straight into the page cache
+    MemoryMappedFile file{ path };
+    MemoryStream     stream{ file.data(), file.size() };
+    uint32_t         magic, version;
+    uint64_t         file_geometry_hash, file_settings_hash, face_count;
+    stream.read(magic);
+    stream.read(version);
+    stream.read(file_geometry_hash);
+    stream.read(file_settings_hash);
+    stream.read(face_count);
+    if (magic != cache_magic or version != cache_version or
+        file_geometry_hash != geometry_hash or
+        file_settings_hash != settings_hash or
+        face_count != mesh_->faceCount())
+      return false;
+
+    if (quantized_)
+      quantized_bvh_.read(stream);
+    else
+      bvh_.read(stream);
+    uint64_t block_count;
+    stream.read(block_count);
+    // The stream doesn't fail on short reads, so a truncated file has to be
+    // caught by its size
+    if (block_count * sizeof(Block) != stream.size() - stream.tell())
+      Throw("unexpected file size {}", stream.size());
+    blocks_.resize(block_count);
+    stream.read(blocks_.data(), blocks_.size() * sizeof(Block));
+    // Leaves index the blocks through the primitive indices, and hits index
+    // the mesh through the blocks
+    const size_t prim_count{ visitBVH(
+      [](const auto& bvh) { return bvh.primIndices().size(); }) };
+    if (block_count != (prim_count + Block::width - 1) / Block::width)
+      Throw("{} blocks for {} primitives", block_count, prim_count);
+    for (const Block& block : blocks_)
+      for (const uint32_t prim : block.prim_index)
+        if (prim != Block::invalid and prim >= face_count)
+          Throw("invalid primitive index {}", prim);
+    return true;
+  }
+  catch (const std::exception& e) {
+    Log(Warn, "Ignoring BVH cache file {}: {}", path.string(), e.what());
+    return false;
+  }
+}
+
+void MeshAccel::saveCache(const std::filesystem::path& path,
+                          uint64_t                     geometry_hash,
+                          uint64_t                     settings_hash) const
+{
+  // Written under a temporary name and renamed, so other processes never see
+  // a partial file
+  std::filesystem::path tmp_path{ path };
+  tmp_path += fmt::format(".{:x}.tmp", reinterpret_cast<uintptr_t>(this));
+  try {
+    std::filesystem::create_directories(path.parent_path());
+    {
+      FileStream stream{ tmp_path, FileStream::ETruncReadWrite };
+      stream.write(cache_magic);
+      stream.write(cache_version);
+      stream.write(geometry_hash);
+      stream.write(settings_hash);
+      stream.write(static_cast<uint64_t>(mesh_->faceCount()));
+      visitBVH([&](const auto& bvh) { bvh.write(stream); });
+      stream.write(static_cast<uint64_t>(blocks_.size()));
+      stream.write(blocks_.data(), blocks_.size() * sizeof(Block));
+    }
+    std::filesystem::rename(tmp_path, path);
+  }
+  catch (const std::exception& e) {
+    Log(Warn, "Failed to write BVH cache file {}: {}", path.string(), e.what());
+    std::error_code ec;
+    std::filesystem::remove(tmp_path, ec);
+  }
+}
+
+template <uint32_t Size>
+uint32_t MeshAccel::rayIntersect(const RayPacket<Size>&   packet,
+                                 PreliminaryIntersection* pi) const
+{
+  uint32_t            hit_mask{ 0 };
+  const PacketFrustum frustum{ packet };
+  if (not frustum.coherent) {
+    for (uint32_t i = 0; i < Size; ++i) {
+      if (packet.isActive(i) and rayIntersect(packet.ray(i), pi[i]))
+        hit_mask |= 1u << i;
+    }
+    return hit_mask;
+  }
+
+  auto intersect_leaf = [&](uint32_t first, uint32_t count) {
+    for (uint32_t i = 0; i < Size; ++i) {
+      if (packet.isActive(i) and
+          intersectLeaf(packet.ray(i),
+                        first,
+                        count,
+                        std::min(packet.maxt[i], pi[i].t),
+                        pi[i]))
+        hit_mask |= 1u << i;
+    }
+    return farthestHit(packet, pi);
+  };
+  visitBVH([&](const auto& bvh) {
+    bvh.traversePacketLeaves(
+      frustum, farthestHit(packet, pi), intersect_leaf);
+  });
+  return hit_mask;
+}
+
+template uint32_t MeshAccel::rayIntersect(const RayPacket<8>&,
+                                          PreliminaryIntersection*) const;
+template uint32_t MeshAccel::rayIntersect(const RayPacket<16>&,
+                                          PreliminaryIntersection*) const;
+
+// -----------------------------------------------------------------------------
+// SceneAccel
+// -----------------------------------------------------------------------------
+SceneAccel::SceneAccel(const Scene& scene, const BVHBuildSettings& settings)
+  : settings_(settings)
+{
+  std::unordered_map<const Mesh*, const MeshAccel*> mesh_blas;
+  for (const auto& top_node : scene.top_nodes) {
+    top_node->map([&](SceneNode* node) {
+      const auto* mesh_node{ dynamic_cast<const MeshNode*>(node) };
+      if (not mesh_node or not mesh_node->mesh or
+          mesh_node->mesh->faceCount() == 0)
+        return;
+      const Mesh* mesh{ mesh_node->mesh.get() };
+      auto        it{ mesh_blas.find(mesh) };
+      if (it == mesh_blas.end()) {
+        blas_.push_back(std::make_unique<MeshAccel>(*mesh, settings));
+        it = mesh_blas.emplace(mesh, blas_.back().get()).first;
+      }
+      instances_.push_back({ mesh_node, it->second, Mat4f{ 1.f } });
+    });
+  }
+
+  updateInstanceBounds();
+  Log(Debug,
+      "Building top-level acceleration structure ({} instances of {} meshes)",
+      instances_.size(),
+      blas_.size());
+  tlas_.build(instance_bounds_, settings_);
+  tlas_build_cost_ = tlas_.stats().sah_cost;
+}
+
+void SceneAccel::update(const float rebuild_threshold)
+{
+  updateInstanceBounds();
+  tlas_.refit(instance_bounds_);
+  if (rebuild_threshold > 0.f and
+      tlas_.stats().sah_cost > rebuild_threshold * tlas_build_cost_) {
+    Log(Debug,
+        "Top-level BVH degraded (SAH cost {:.2f} -> {:.2f}), rebuilding",
+        tlas_build_cost_,
+        tlas_.stats().sah_cost);
+    tlas_.build(instance_bounds_, settings_);
+    tlas_build_cost_ = tlas_.stats().sah_cost;
+  }
+}
+
+void SceneAccel::updateInstanceBounds()
+{
+  instance_bounds_.resize(instances_.size());
+  parallelFor(BlockedRange<size_t>{ 0, instances_.size(), 1024 },
+              [&](const BlockedRange<size_t>& range) {
+                for (size_t i = range.begin(); i < range.end(); ++i) {
+                  Instance&    instance{ instances_[i] };
+                  const Mat4f& to_world{ instance.node->world_transform };
+                  instance.to_object  = glm::inverse(to_world);
+                  instance_bounds_[i] =
+                    transformBBox(to_world, instance.blas->bbox());
+                }
+              });
+}
+
+PreliminaryIntersection SceneAccel::rayIntersect(const Ray3f& ray) const
+{
+  PreliminaryIntersection pi;
+  tlas_.traverse(ray, [&](uint32_t instance_index, Float& maxt) {
+    const Instance& instance{ instances_[instance_index] };
+    // The direction is not normalized, so distances are the same in both
+    // spaces
+    const Ray3f local_ray{ Point3f{ instance.to_object * Vec4f{ ray.o, 1.f } },
+                           Vec3f{ instance.to_object * Vec4f{ ray.d, 0.f } },
+                           maxt };
+    if (not instance.blas->rayIntersect(local_ray, pi))
+      return false;
+    maxt              = pi.t;
+    pi.instance_index = instance_index;
+    pi.shape          = &instance.blas->mesh();
+    return true;
+  });
+  return pi;
+}
+
+template <uint32_t Size>
+void SceneAccel::rayIntersect(
+  const RayPacket<Size>&             packet,
+  std::span<PreliminaryIntersection> pi) const
+{
+  Assert(pi.size() == Size, "expected one intersection per ray");
+  std::fill(pi.begin(), pi.end(), PreliminaryIntersection{});
+  const PacketFrustum frustum{ packet };
+  if (not frustum.coherent) {
+    for (uint32_t i = 0; i < Size; ++i) {
+      if (packet.isActive(i))
+        pi[i] = rayIntersect(packet.ray(i));
+    }
+    return;
+  }
+
+  tlas_.traversePacket(
+    frustum, farthestHit(packet, pi.data()), [&](uint32_t instance_index) {
+      const Instance& instance{ instances_[instance_index] };
+      RayPacket<Size> local_packet;
+      for (uint32_t i = 0; i < Size; ++i) {
+        if (not packet.isActive(i))
+          continue;
+        const Ray3f ray{ packet.ray(i) };
+        local_packet.set(
+          i,
+          { Point3f{ instance.to_object * Vec4f{ ray.o, 1.f } },
+            Vec3f{ instance.to_object * Vec4f{ ray.d, 0.f } },
+            std::min(ray.maxt, pi[i].t) });
+      }
+      uint32_t hit_mask{ instance.blas->rayIntersect(local_packet,
+                                                     pi.data()) };
+      while (hit_mask != 0) {
+        const auto i{ static_cast<uint32_t>(std::countr_zero(hit_mask)) };
+        hit_mask &= hit_mask - 1;
+        pi[i].instance_index = instance_index;
+        pi[i].shape          = &instance.blas->mesh();
+      }
+      return farthestHit(packet, pi.data());
+    });
+}
+
+template void SceneAccel::rayIntersect(const RayPacket<8>&,
+                                       std::span<PreliminaryIntersection>) const;
+template void SceneAccel::rayIntersect(const RayPacket<16>&,
+                                       std::span<PreliminaryIntersection>) const;
+
+bool SceneAccel::occluded(const Ray3f& ray, Float tmax) const
+{
+  const Ray3f clipped_ray{ ray.o, ray.d, std::min(ray.maxt, tmax) };
+  return tlas_.occluded(clipped_ray, [&](uint32_t instance_index, Float maxt) {
+    const Instance& instance{ instances_[instance_index] };
+    const Ray3f local_ray{ Point3f{ instance.to_object * Vec4f{ ray.o, 1.f } },
+                           Vec3f{ instance.to_object * Vec4f{ ray.d, 0.f } },
+                           maxt };
+    return instance.blas->occluded(local_ray);
+  });
+}
+
+SurfaceInteraction
+SceneAccel::computeSurfaceInteraction(const Ray3f&                   ray,
+                                      const PreliminaryIntersection& pi) const
+{
+  SurfaceInteraction si;
+  if (not pi.isValid())
+    return si;
+
+  const Instance& instance{ instances_[pi.instance_index] };
+  const Mesh&     mesh{ *pi.shape };
+  const Vec3u     idx{ mesh.faceIndices(pi.prim_index) };
+  const Float     b1{ pi.prim_uv.x };
+  const Float     b2{ pi.prim_uv.y };
+  const Float     b0{ 1.f - b1 - b2 };
+
+  const auto&    positions{ mesh.vtxPositions() };
+  const Point3f& p0{ positions[idx.x] };
+  const Point3f& p1{ positions[idx.y] };
+  const Point3f& p2{ positions[idx.z] };
+  const Mat4f&   to_world{ instance.node->world_transform };
+  // Normals transform with the inverse transpose
+  const Mat3f normal_to_world{ glm::transpose(Mat3f{ instance.to_object }) };
+
+  si.t = pi.t;
+  si.p = Point3f{ to_world * Vec4f{ b0 * p0 + b1 * p1 + b2 * p2, 1.f } };
+  si.n = glm::normalize(normal_to_world * glm::cross(p1 - p0, p2 - p0));
+
+  const auto& normals{ mesh.vtxNormals() };
+  const Vec3f sh_n{ normal_to_world *
+                    (b0 * normals[idx.x] + b1 * normals[idx.y] +
+                     b2 * normals[idx.z]) };
+  const Float sh_n_len{ glm::length(sh_n) };
+  si.sh_frame = Frame3f{ sh_n_len > 0.f ? sh_n / sh_n_len : si.n };
+
+  const auto& texcoords{ mesh.vtxTexCoords() };
+  si.uv =
+    b0 * texcoords[idx.x] + b1 * texcoords[idx.y] + b2 * texcoords[idx.z];
+  si.wi = si.toLocal(-glm::normalize(ray.d));
+
+  const uint32_t surface_index{ mesh.surfaceIndex(pi.prim_index) };
+  si.shape = &mesh;
+  si.bsdf  = mesh.surfaces()[surface_index].bsdf.get();
+  if (const auto& emitters{ instance.node->emitters }; not emitters.empty())
+    si.emitter = emitters[surface_index].get();
+  return si;
+}
+} // namespace eldr
@@ -0,0 +1,44 @@
+#include <eldr/core/frame.hpp>
+#include <eldr/core/warp.hpp>
+#include <eldr/render/bsdf.hpp>
+#include <eldr/render/interaction.hpp>
+
+namespace eldr {
+// Both sides of a surface reflect, so `wo` only has to lie in the same
+// hemisphere as `wi`
+BSDF::Color3f BSDF::eval(const SurfaceInteraction& si, const Vec3f& wo) const
+{
+  const Float cos_theta_i{ Frame3f::cosTheta(si.wi) };
+  const Float cos_theta_o{ Frame3f::cosTheta(wo) };
+  if (cos_theta_i * cos_theta_o <= 0.f)
+    return Color3f{ 0.f };
+  return reflectance_ * (warp::inv_pi * std::abs(cos_theta_o));
+}
+
+Float BSDF::pdf(const SurfaceInteraction& si, const Vec3f& wo) const
+{
+  const Float cos_theta_i{ Frame3f::cosTheta(si.wi) };
+  const Float cos_theta_o{ Frame3f::cosTheta(wo) };
+  if (cos_theta_i * cos_theta_o <= 0.f)
+    return 0.f;
+  return warp::inv_pi * std::abs(cos_theta_o);
+}
+
+std::pair<BSDFSample3f, BSDF::Color3f>
+BSDF::sample(const SurfaceInteraction& si, const Point2f& sample) const
+{
+  BSDFSample3f bs;
+  const Float  cos_theta_i{ Frame3f::cosTheta(si.wi) };
+  if (cos_theta_i == 0.f)
+    return { bs, Color3f{ 0.f } };
+
+  bs.wo  = warp::squareToCosineHemisphere(sample);
+  bs.pdf = warp::squareToCosineHemispherePdf(bs.wo);
+  if (cos_theta_i < 0.f)
+    bs.wo.z = -bs.wo.z;
+  if (bs.pdf == 0.f)
+    return { bs, Color3f{ 0.f } };
+  // Cosine-weighted sampling cancels out everything but the reflectance
+  return { bs, reflectance_ };
+}
+} // namespace eldr
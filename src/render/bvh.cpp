@@ -0,0 +1,451 @@
+#include <eldr/core/logger.hpp>
+#include <eldr/core/parallel.hpp>
+#include <eldr/core/stopwatch.hpp>
+#include <eldr/render/bvh.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <limits>
+
+using namespace eldr::core;
+
+namespace eldr {
+namespace {
+constexpr uint32_t max_bin_count{ 64 };
+// Binning is split over several threads for nodes larger than this
+constexpr uint32_t parallel_binning_threshold{ 1u << 18 };
+
+struct Bin {
+  BoundingBox3f bbox;
+  BoundingBox3f centroid_bbox;
+  uint32_t      count{ 0 };
+};
+using AxisBins = std::array<Bin, max_bin_count>;
+using Bins     = std::array<AxisBins, 3>;
+
+/// @brief Get the depth up to which subtrees of unknown size are refitted as
+/// separate tasks
+uint32_t spawnDepth()
+{
+  const ThreadPool* pool{ ThreadPool::instance() };
+  return pool ? std::bit_width(pool->threadCount()) + 2 : 0;
+}
+
+/// @brief Run `a` and `b`, in parallel if `parallel` is true
+template <typename A, typename B> void forkJoin(bool parallel, A&& a, B&& b)
+{
+  if (not parallel) {
+    a();
+    b();
+    return;
+  }
+  TaskGroup group;
+  group.run(std::forward<A>(a));
+  b();
+  group.wait();
+}
+} // namespace
+
+struct BVH::BuildContext {
+  ELDR_IMPORT_CORE_TYPES()
+
+  /// Primitive bounds are copied next to their index and partitioned along
+  /// with it, so that binning reads memory sequentially
+  struct PrimRef {
+    BoundingBox3f bbox;
+    uint32_t      index;
+
+    [[nodiscard]] Point3f centroid() const { return bbox.center(); }
+  };
+
+  std::vector<PrimRef>  refs;
+  BVHBuildSettings      settings;
+  std::atomic<uint32_t> node_count{ 0 };
+
+  /// @brief Maps centroid coordinates to bins along each axis
+  struct BinMapping {
+    BinMapping(uint32_t bin_count, const BoundingBox3f& centroid_bbox)
+      : bin_count(bin_count), min(centroid_bbox.min)
+    {
+      const Vec3f extents{ centroid_bbox.extents() };
+      for (uint32_t axis = 0; axis < 3; ++axis) {
+        valid[axis] = extents[axis] > 0.f;
+        scale[axis] = valid[axis] ? bin_count / extents[axis] : 0.f;
+      }
+    }
+
+    [[nodiscard]] uint32_t index(Float c, uint32_t axis) const
+    {
+      const auto i{ static_cast<uint32_t>((c - min[axis]) * scale[axis]) };
+      return std::min(i, bin_count - 1);
+    }
+
+    uint32_t bin_count;
+    Point3f  min;
+    Vec3f    scale;
+    /// Whether the centroids have any extent along the axis
+    bool valid[3];
+  };
+
+  /// @brief Bin the centroids of the primitives in [begin, end)
+  void binRange(uint32_t          begin,
+                uint32_t          end,
+                const BinMapping& mapping,
+                Bins&             bins) const
+  {
+    for (uint32_t i = begin; i < end; ++i) {
+      const PrimRef& ref{ refs[i] };
+      const Point3f  c{ ref.centroid() };
+      for (uint32_t axis = 0; axis < 3; ++axis) {
+        if (not mapping.valid[axis])
+          continue;
+        Bin& bin{ bins[axis][mapping.index(c[axis], axis)] };
+        bin.bbox.expand(ref.bbox);
+        bin.centroid_bbox.expand(c);
+        bin.count++;
+      }
+    }
+  }
+};
+
+BVH::BVH(std::span<const BoundingBox3f> prim_bounds,
+         const BVHBuildSettings&        settings)
+{
+  build(prim_bounds, settings);
+}
+
+void BVH::build(std::span<const BoundingBox3f> prim_bounds,
+                const BVHBuildSettings&        settings)
+{
+  Assert(settings.bin_count > 1 and settings.bin_count <= max_bin_count);
+  Assert(settings.max_leaf_size > 0);
+  StopWatch timer;
+
+  nodes_.clear();
+  prim_indices_.clear();
+  settings_ = settings;
+  stats_    = {};
+  if (prim_bounds.empty())
+    return;
+
+  const auto prim_count{ static_cast<uint32_t>(prim_bounds.size()) };
+
+  BuildContext ctx;
+  ctx.settings = settings;
+
+  BoundingBox3f bbox, centroid_bbox;
+  ctx.refs.resize(prim_count);
+  for (uint32_t i = 0; i < prim_count; ++i) {
+    ctx.refs[i] = { prim_bounds[i], i };
+    bbox.expand(prim_bounds[i]);
+    centroid_bbox.expand(prim_bounds[i].center());
+  }
+
+  // A binary tree with n leaves has 2n - 1 nodes, which is an upper bound
+  nodes_.resize(2 * static_cast<size_t>(prim_count) - 1);
+  nodes_[0].bbox = bbox;
+  ctx.node_count = 1;
+  buildRecursive(ctx, 0, centroid_bbox, 0, prim_count, 0);
+  nodes_.resize(ctx.node_count);
+  nodes_.shrink_to_fit();
+
+  prim_indices_.resize(prim_count);
+  for (uint32_t i = 0; i < prim_count; ++i)
+    prim_indices_[i] = ctx.refs[i].index;
+
+  computeStats();
+  stats_.build_time_ms = timer.millis<float>();
+  Log(Debug,
+      "Built BVH over {} primitives in {:.1f} ms ({} nodes, {} leaves, max "
+      "depth {}, avg. leaf size {:.2f}, SAH cost {:.2f})",
+      stats_.prim_count,
+      stats_.build_time_ms,
+      stats_.node_count,
+      stats_.leaf_count,
+      stats_.max_depth,
+      stats_.avg_leaf_size,
+      stats_.sah_cost);
+}
+
+void BVH::buildRecursive(BuildContext&        ctx,
+                         const uint32_t       node_index,
+                         const BoundingBox3f& centroid_bbox,
+                         const uint32_t       begin,
+                         const uint32_t       end,
+                         const uint32_t       depth)
+{
+  const BVHBuildSettings& settings{ ctx.settings };
+  BVHNode&                node{ nodes_[node_index] };
+  const uint32_t          count{ end - begin };
+
+  auto make_leaf = [&] {
+    node.offset     = begin;
+    node.prim_count = count;
+  };
+
+  // The traversal stack limits the depth of the tree
+  if (count == 1 or depth + 2 >= max_depth) {
+    make_leaf();
+    return;
+  }
+
+  // ---------------------------------------------------------------------------
+  // Bin the primitive centroids along all axes
+  // ---------------------------------------------------------------------------
+  // Small nodes don't need as many bins to find a good split
+  const uint32_t bin_count{ std::min(settings.bin_count, std::max(count, 4u)) };
+  const BuildContext::BinMapping mapping{ bin_count, centroid_bbox };
+
+  // The bins are dead once the children are set up, before any recursion, so
+  // a scratch copy per thread saves constructing all of them for every node.
+  // Waiting for the parallel binning may run other nodes on this thread,
+  // so they are only cleared once nothing else can use them anymore.
+  thread_local Bins bins;
+  auto              clear_bins = [&] {
+    for (AxisBins& axis_bins : bins)
+      std::fill_n(axis_bins.begin(), bin_count, Bin{});
+  };
+  const bool parallel{ count >= settings.parallel_threshold };
+  if (parallel and count >= parallel_binning_threshold) {
+    constexpr uint32_t chunk_size{ parallel_binning_threshold / 4 };
+    const uint32_t     chunk_count{ (count + chunk_size - 1) / chunk_size };
+    std::vector<Bins>  chunk_bins(chunk_count);
+    parallelFor(BlockedRange<uint32_t>{ 0, chunk_count },
+                [&](const BlockedRange<uint32_t>& range) {
+                  for (uint32_t c = range.begin(); c < range.end(); ++c) {
+                    chunk_bins[c] = {};
+                    ctx.binRange(begin + c * chunk_size,
+                                 std::min(end, begin + (c + 1) * chunk_size),
+                                 mapping,
+                                 chunk_bins[c]);
+                  }
+                });
+    clear_bins();
+    for (const Bins& cb : chunk_bins) {
+      for (uint32_t axis = 0; axis < 3; ++axis) {
+        for (uint32_t b = 0; b < bin_count; ++b) {
+          bins[axis][b].bbox.expand(cb[axis][b].bbox);
+          bins[axis][b].centroid_bbox.expand(cb[axis][b].centroid_bbox);
+          bins[axis][b].count += cb[axis][b].count;
+        }
+      }
+    }
+  }
+  else {
+    clear_bins();
+    ctx.binRange(begin, end, mapping, bins);
+  }
+
+  // ---------------------------------------------------------------------------
+  // Find the split with the lowest SAH cost
+  // ---------------------------------------------------------------------------
+  const Float node_area{ node.bbox.surfaceArea() };
+  Float       best_cost{ std::numeric_limits<Float>::infinity() };
+  uint32_t    best_axis{ 0 };
+  uint32_t    best_split{ 0 }; // last bin of the left side
+  for (uint32_t axis = 0; axis < 3; ++axis) {
+    if (not mapping.valid[axis])
+      continue;
+    const AxisBins& axis_bins{ bins[axis] };
+
+    // Sweep from the right to get the cost of each right side
+    std::array<Float, max_bin_count> right_cost;
+    BoundingBox3f                    right_bbox;
+    uint32_t                         right_count{ 0 };
+    for (uint32_t b = bin_count - 1; b > 0; --b) {
+      right_bbox.expand(axis_bins[b].bbox);
+      right_count += axis_bins[b].count;
+      right_cost[b - 1] = right_bbox.surfaceArea() * right_count;
+    }
+
+    BoundingBox3f left_bbox;
+    uint32_t      left_count{ 0 };
+    for (uint32_t b = 0; b < bin_count - 1; ++b) {
+      left_bbox.expand(axis_bins[b].bbox);
+      left_count += axis_bins[b].count;
+      if (left_count == 0 or left_count == count)
+        continue;
+      const Float cost{ left_bbox.surfaceArea() * left_count + right_cost[b] };
+      if (cost < best_cost) {
+        best_cost  = cost;
+        best_axis  = axis;
+        best_split = b;
+      }
+    }
+  }
+
+  // All centroids coincide, so the SAH can't tell the primitives apart. Large
+  // nodes are halved anyway, which keeps leaves within `max_leaf_size` (and
+  // the 16 bit counts of quantized wide nodes) on degenerate geometry.
+  if (best_cost == std::numeric_limits<Float>::infinity()) {
+    if (count <= settings.max_leaf_size) {
+      make_leaf();
+      return;
+    }
+    const uint32_t mid{ begin + count / 2 };
+    BoundingBox3f  left_bbox, right_bbox;
+    for (uint32_t i = begin; i < mid; ++i)
+      left_bbox.expand(ctx.refs[i].bbox);
+    for (uint32_t i = mid; i < end; ++i)
+      right_bbox.expand(ctx.refs[i].bbox);
+
+    const uint32_t left{ ctx.node_count.fetch_add(2) };
+    node.offset           = left;
+    node.prim_count       = 0;
+    nodes_[left].bbox     = left_bbox;
+    nodes_[left + 1].bbox = right_bbox;
+    forkJoin(
+      parallel,
+      [&, left, mid] {
+        buildRecursive(ctx, left, centroid_bbox, begin, mid, depth + 1);
+      },
+      [&, left, mid] {
+        buildRecursive(ctx, left + 1, centroid_bbox, mid, end, depth + 1);
+      });
+    return;
+  }
+
+  best_cost = settings.traversal_cost +
+              settings.intersection_cost * best_cost / node_area;
+  const Float leaf_cost{ settings.intersection_cost * count };
+  if (count <= settings.max_leaf_size and leaf_cost <= best_cost) {
+    make_leaf();
+    return;
+  }
+
+  // ---------------------------------------------------------------------------
+  // Partition the primitives and build the children
+  // ---------------------------------------------------------------------------
+  const auto mid_it{ std::partition(
+    ctx.refs.begin() + begin,
+    ctx.refs.begin() + end,
+    [&](const BuildContext::PrimRef& ref) {
+      return mapping.index(ref.centroid()[best_axis], best_axis) <= best_split;
+    }) };
+  const auto mid{ static_cast<uint32_t>(mid_it - ctx.refs.begin()) };
+  Assert(mid > begin and mid < end);
+
+  BoundingBox3f left_bbox, right_bbox, left_centroids, right_centroids;
+  for (uint32_t b = 0; b < bin_count; ++b) {
+    const Bin& bin{ bins[best_axis][b] };
+    if (b <= best_split) {
+      left_bbox.expand(bin.bbox);
+      left_centroids.expand(bin.centroid_bbox);
+    }
+    else {
+      right_bbox.expand(bin.bbox);
+      right_centroids.expand(bin.centroid_bbox);
+    }
+  }
+
+  const uint32_t left{ ctx.node_count.fetch_add(2) };
+  node.offset             = left;
+  node.prim_count         = 0;
+  nodes_[left].bbox       = left_bbox;
+  nodes_[left + 1].bbox   = right_bbox;
+
+  forkJoin(
+    parallel,
+    [&, left, mid] {
+      buildRecursive(ctx, left, left_centroids, begin, mid, depth + 1);
+    },
+    [&, left, mid] {
+      buildRecursive(ctx, left + 1, right_centroids, mid, end, depth + 1);
+    });
+}
+
+void BVH::refit(std::span<const BoundingBox3f> prim_bounds)
+{
+  Assert(prim_bounds.size() == prim_indices_.size());
+  if (nodes_.empty())
+    return;
+  StopWatch timer;
+
+  // Scheduling tasks costs more than refitting small trees
+  const uint32_t spawn_depth{ prim_indices_.size() >= settings_.parallel_threshold
+                                ? spawnDepth()
+                                : 0 };
+  refitRecursive(prim_bounds, 0, 0, spawn_depth);
+
+  stats_.sah_cost      = sahCost();
+  stats_.refit_time_ms = timer.millis<float>();
+  Log(Trace,
+      "Refitted BVH over {} primitives in {:.3f} ms (SAH cost {:.2f})",
+      stats_.prim_count,
+      stats_.refit_time_ms,
+      stats_.sah_cost);
+}
+
+BoundingBox3f BVH::refitRecursive(std::span<const BoundingBox3f> prim_bounds,
+                                  const uint32_t                 node_index,
+                                  const uint32_t                 depth,
+                                  const uint32_t                 spawn_depth)
+{
+  BVHNode& node{ nodes_[node_index] };
+  if (node.isLeaf()) {
+    node.bbox = {};
+    for (uint32_t i = 0; i < node.prim_count; ++i)
+      node.bbox.expand(prim_bounds[prim_indices_[node.offset + i]]);
+    return node.bbox;
+  }
+
+  BoundingBox3f left_bbox, right_bbox;
+  forkJoin(
+    depth < spawn_depth,
+    [&] {
+      left_bbox = refitRecursive(prim_bounds, node.offset, depth + 1, spawn_depth);
+    },
+    [&] {
+      right_bbox =
+        refitRecursive(prim_bounds, node.offset + 1, depth + 1, spawn_depth);
+    });
+  node.bbox = BoundingBox3f::merge(left_bbox, right_bbox);
+  return node.bbox;
+}
+
+float BVH::sahCost() const
+{
+  if (nodes_.empty())
+    return 0.f;
+  const Float root_area{ nodes_[0].bbox.surfaceArea() };
+  if (root_area <= 0.f)
+    return static_cast<float>(nodes_.size());
+  double sah_cost{ 0. };
+  for (const BVHNode& node : nodes_) {
+    const double rel_area{ node.bbox.surfaceArea() / root_area };
+    sah_cost += rel_area * (node.isLeaf() ? node.prim_count : 1);
+  }
+  return static_cast<float>(sah_cost);
+}
+
+void BVH::computeStats()
+{
+  stats_.prim_count = prim_indices_.size();
+  stats_.node_count = nodes_.size();
+
+  struct Entry {
+    uint32_t node;
+    uint32_t depth;
+  };
+  std::vector<Entry> stack{ { 0, 1 } };
+  while (not stack.empty()) {
+    const Entry    entry{ stack.back() };
+    const BVHNode& node{ nodes_[entry.node] };
+    stack.pop_back();
+    stats_.max_depth = std::max(stats_.max_depth, entry.depth);
+    if (node.isLeaf()) {
+      stats_.leaf_count++;
+      stats_.max_leaf_size = std::max(stats_.max_leaf_size, node.prim_count);
+    }
+    else {
+      stack.push_back({ node.offset, entry.depth + 1 });
+      stack.push_back({ node.offset + 1, entry.depth + 1 });
+    }
+  }
+  stats_.avg_leaf_size =
+    static_cast<float>(stats_.prim_count) / std::max<size_t>(1, stats_.leaf_count);
+  stats_.sah_cost = sahCost();
+}
+} // namespace eldr
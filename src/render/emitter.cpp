@@ -0,0 +1,277 @@
+#include <eldr/core/bitmap.hpp>
+#include <eldr/core/logger.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/core/parallel.hpp>
+#include <eldr/core/warp.hpp>
+#include <eldr/render/emitter.hpp>
+#include <eldr/render/interaction.hpp>
+#include <eldr/render/mesh.hpp>
+#include <eldr/render/scene.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <numbers>
+
+using namespace eldr::core;
+
+namespace eldr {
+namespace {
+Float srgbToLinear(Float v)
+{
+  return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+}
+
+/// @brief Read the color of a pixel of an 8 bit, 16 bit or float bitmap, as
+/// linear RGB
+CoreAliases<Float>::Color3f readPixel(const Bitmap& bitmap, size_t index)
+{
+  const size_t channels{ bitmap.channelCount() };
+  // Gray images have one color channel, everything else at least three
+  const size_t color_channels{ channels < 3 ? 1u : 3u };
+  const size_t first{ index * channels };
+  Float        c[3];
+  for (size_t i = 0; i < color_channels; ++i) {
+    switch (bitmap.componentFormat()) {
+      case StructType::Float32:
+        c[i] = reinterpret_cast<const float*>(bitmap.data())[first + i];
+        break;
+      case StructType::UInt8:
+        c[i] = static_cast<Float>(bitmap.data()[first + i]) / 255.f;
+        break;
+      case StructType::UInt16:
+        c[i] = static_cast<Float>(reinterpret_cast<const uint16_t*>(
+                 bitmap.data())[first + i]) /
+               65535.f;
+        break;
+      default:
+        Throw("Unsupported component format {}", bitmap.componentFormat());
+    }
+    if (bitmap.srgbGamma())
+      c[i] = srgbToLinear(c[i]);
+  }
+  if (color_channels == 1)
+    return CoreAliases<Float>::Color3f{ c[0] };
+  return { c[0], c[1], c[2] };
+}
+} // namespace
+
+// -----------------------------------------------------------------------------
+// AreaEmitter
+// -----------------------------------------------------------------------------
+AreaEmitter::AreaEmitter(const MeshNode& node,
+                         uint32_t        surface_index,
+                         const Color3f&  radiance)
+  : radiance_(radiance)
+{
+  const Mesh&       mesh{ *node.mesh };
+  const GeoSurface& surface{ mesh.surfaces().at(surface_index) };
+  const Mat4f&      to_world{ node.world_transform };
+  const auto&       positions{ mesh.vtxPositions() };
+
+  const uint32_t first_face{ surface.start_index / 3 };
+  const uint32_t face_count{ surface.count / 3 };
+  triangles_.reserve(face_count);
+  std::vector<Float> areas;
+  areas.reserve(face_count);
+  for (uint32_t f = first_face; f < first_face + face_count; ++f) {
+    const Vec3u   idx{ mesh.faceIndices(f) };
+    const Point3f p0{ to_world * Vec4f{ positions[idx.x], 1.f } };
+    const Point3f p1{ to_world * Vec4f{ positions[idx.y], 1.f } };
+    const Point3f p2{ to_world * Vec4f{ positions[idx.z], 1.f } };
+    const Vec3f   e1{ p1 - p0 };
+    const Vec3f   e2{ p2 - p0 };
+    const Vec3f   c{ glm::cross(e1, e2) };
+    const Float   len{ glm::length(c) };
+    // Degenerate triangles can never be sampled
+    if (len == 0.f)
+      continue;
+    triangles_.push_back({ p0, e1, e2, c / len });
+    area_ += 0.5f * len;
+    areas.push_back(0.5f * len);
+
+    LightBounds tri_bounds;
+    tri_bounds.bbox = BoundingBox3f{ p0 };
+    tri_bounds.bbox.expand(p1);
+    tri_bounds.bbox.expand(p2);
+    tri_bounds.w   = c / len;
+    tri_bounds.phi = 0.5f * len;
+    bounds_        = LightBounds::merge(bounds_, tri_bounds);
+  }
+  // Diffuse emission from the front side, into the hemisphere around the
+  // normal
+  bounds_.phi         = pi * area_ * luminance(radiance);
+  bounds_.cos_theta_e = 0.f;
+  triangle_table_ = AliasTable{ areas };
+  if (triangles_.empty())
+    Log(Warn,
+        "Emissive surface {} of mesh \"{}\" has no area",
+        surface_index,
+        mesh.name());
+}
+
+std::pair<DirectionSample3f, AreaEmitter::Color3f>
+AreaEmitter::sampleDirection(const Point3f& ref, const Point2f& sample) const
+{
+  DirectionSample3f ds;
+  if (triangles_.empty())
+    return { ds, Color3f{ 0.f } };
+
+  // Pick a triangle proportional to its area and reuse the sample for picking
+  // a point on it
+  Point2f         remapped{ sample };
+  const Triangle& tri{ triangles_[triangle_table_.sampleReuse(remapped.x)] };
+  const Point2f   b{ warp::squareToUniformTriangle(remapped) };
+  ds.p       = tri.p0 + b.x * tri.e1 + b.y * tri.e2;
+  ds.n       = tri.n;
+  ds.emitter = this;
+  const Vec3f d{ ds.p - ref };
+  ds.dist = glm::length(d);
+  if (ds.dist == 0.f)
+    return { ds, Color3f{ 0.f } };
+  ds.d = d / ds.dist;
+
+  // Convert the area density to solid angle
+  const Float cos_theta{ -glm::dot(ds.n, ds.d) };
+  if (cos_theta <= 0.f)
+    return { ds, Color3f{ 0.f } };
+  ds.pdf = ds.dist * ds.dist / (cos_theta * area_);
+  return { ds, radiance_ / ds.pdf };
+}
+
+Float AreaEmitter::pdfDirection(const Point3f& /*ref*/,
+                                const DirectionSample3f& ds) const
+{
+  const Float cos_theta{ -glm::dot(ds.n, ds.d) };
+  if (cos_theta <= 0.f or area_ == 0.f)
+    return 0.f;
+  return ds.dist * ds.dist / (cos_theta * area_);
+}
+
+AreaEmitter::Color3f AreaEmitter::eval(const SurfaceInteraction& si) const
+{
+  return glm::dot(si.n, si.toWorld(si.wi)) > 0.f ? radiance_ : Color3f{ 0.f };
+}
+
+// -----------------------------------------------------------------------------
+// ConstantEmitter
+// -----------------------------------------------------------------------------
+std::pair<DirectionSample3f, ConstantEmitter::Color3f>
+ConstantEmitter::sampleDirection(const Point3f& ref,
+                                 const Point2f& sample) const
+{
+  DirectionSample3f ds;
+  ds.d       = warp::squareToUniformSphere(sample);
+  ds.n       = -ds.d;
+  ds.dist    = std::numeric_limits<Float>::infinity();
+  ds.p       = ref + ds.d;
+  ds.pdf     = warp::squareToUniformSpherePdf();
+  ds.emitter = this;
+  return { ds, radiance_ / ds.pdf };
+}
+
+Float ConstantEmitter::pdfDirection(const Point3f& /*ref*/,
+                                    const DirectionSample3f& /*ds*/) const
+{
+  return warp::squareToUniformSpherePdf();
+}
+
+ConstantEmitter::Color3f
+ConstantEmitter::eval(const SurfaceInteraction& /*si*/) const
+{
+  return radiance_;
+}
+
+// -----------------------------------------------------------------------------
+// EnvironmentEmitter
+// -----------------------------------------------------------------------------
+EnvironmentEmitter::EnvironmentEmitter(const Bitmap& bitmap, Float scale)
+  : size_(bitmap.size()), radiance_(bitmap.pixelCount())
+{
+  if (bitmap.pixelCount() == 0)
+    Throw("Environment image \"{}\" is empty", bitmap.name());
+
+  // Pixels near the poles cover less solid angle, so they are weighted by
+  // the sine of their polar angle
+  std::vector<Float> weights(radiance_.size());
+  parallelFor(BlockedRange<uint32_t>{ 0, size_.y },
+              [&](const BlockedRange<uint32_t>& range) {
+                for (uint32_t y = range.begin(); y < range.end(); ++y) {
+                  const Float sin_theta{ std::sin(
+                    pi * (static_cast<Float>(y) + .5f) /
+                    static_cast<Float>(size_.y)) };
+                  for (uint32_t x = 0; x < size_.x; ++x) {
+                    const size_t index{ static_cast<size_t>(y) * size_.x + x };
+                    radiance_[index] = readPixel(bitmap, index) * scale;
+                    weights[index] =
+                      std::max(luminance(radiance_[index]), 0.f) * sin_theta;
+                  }
+                }
+              });
+  pixel_table_ = AliasTable2D{ weights, size_ };
+}
+
+EnvironmentEmitter::Vec2u EnvironmentEmitter::pixel(const Vec3f& d) const
+{
+  const Float theta{ safeAcos(d.z) };
+  Float       phi{ std::atan2(d.y, d.x) };
+  if (phi < 0.f)
+    phi += 2.f * pi;
+  const Float u{ phi * 0.5f * std::numbers::inv_pi_v<Float> };
+  const Float v{ theta * std::numbers::inv_pi_v<Float> };
+  return { std::min(static_cast<uint32_t>(u * static_cast<Float>(size_.x)),
+                    size_.x - 1),
+           std::min(static_cast<uint32_t>(v * static_cast<Float>(size_.y)),
+                    size_.y - 1) };
+}
+
+Float EnvironmentEmitter::solidAnglePdf(const Vec2u& pixel,
+                                        Float        sin_theta) const
+{
+  if (sin_theta <= 0.f)
+    return 0.f;
+  // The pixel covers 1 / (width * height) of the unit square, which maps to
+  // the sphere with a Jacobian of 2 pi^2 sin(theta)
+  return pixel_table_.pmf(pixel) * static_cast<Float>(size_.x) *
+         static_cast<Float>(size_.y) / (2.f * pi * pi * sin_theta);
+}
+
+std::pair<DirectionSample3f, EnvironmentEmitter::Color3f>
+EnvironmentEmitter::sampleDirection(const Point3f& ref,
+                                    const Point2f& sample) const
+{
+  Point2f     u{ sample };
+  const Vec2u px{ pixel_table_.sampleReuse(u) };
+  const Float phi{ 2.f * pi * (static_cast<Float>(px.x) + u.x) /
+                   static_cast<Float>(size_.x) };
+  const Float theta{ pi * (static_cast<Float>(px.y) + u.y) /
+                     static_cast<Float>(size_.y) };
+  const Float sin_theta{ std::sin(theta) };
+
+  DirectionSample3f ds;
+  ds.d       = { sin_theta * std::cos(phi),
+                 sin_theta * std::sin(phi),
+                 std::cos(theta) };
+  ds.n       = -ds.d;
+  ds.dist    = std::numeric_limits<Float>::infinity();
+  ds.p       = ref + ds.d;
+  ds.pdf     = solidAnglePdf(px, sin_theta);
+  ds.emitter = this;
+  if (ds.pdf == 0.f)
+    return { ds, Color3f{ 0.f } };
+  return { ds, radiance_[static_cast<size_t>(px.y) * size_.x + px.x] / ds.pdf };
+}
+
+Float EnvironmentEmitter::pdfDirection(const Point3f& /*ref*/,
+                                       const DirectionSample3f& ds) const
+{
+  const Float sin_theta{ std::sqrt(std::max(1.f - ds.d.z * ds.d.z, 0.f)) };
+  return solidAnglePdf(pixel(ds.d), sin_theta);
+}
+
+EnvironmentEmitter::Color3f
+EnvironmentEmitter::eval(const SurfaceInteraction& si) const
+{
+  const Vec2u px{ pixel(-si.wi) };
+  return radiance_[static_cast<size_t>(px.y) * size_.x + px.x];
+}
+} // namespace eldr
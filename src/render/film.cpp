@@ -0,0 +1,77 @@
+#include <eldr/core/logger.hpp>
+#include <eldr/render/film.hpp>
+#include <eldr/render/rfilter.hpp>
+
+#include <algorithm>
+#include <atomic>
+
+using namespace eldr::core;
+
+namespace eldr {
+Film::Film(const Vec2u& size, std::shared_ptr<ReconstructionFilter> filter)
+  : size_(size), filter_(std::move(filter)),
+    storage_(size, *filter_, /*border=*/false)
+{
+  Assert(size.x > 0 and size.y > 0, "empty film");
+  clear();
+}
+
+void Film::put(const ImageBlock& block)
+{
+  // Clip the block, including its border, against the film
+  const int32_t border{ static_cast<int32_t>(block.borderSize()) };
+  const int32_t origin_x{ static_cast<int32_t>(block.offset().x) - border };
+  const int32_t origin_y{ static_cast<int32_t>(block.offset().y) - border };
+  const Vec2u   full_size{ block.fullSize() };
+  const int32_t x_begin{ std::max(0, origin_x) };
+  const int32_t y_begin{ std::max(0, origin_y) };
+  const int32_t x_end{ std::min(static_cast<int32_t>(size_.x),
+                                origin_x + static_cast<int32_t>(full_size.x)) };
+  const int32_t y_end{ std::min(static_cast<int32_t>(size_.y),
+                                origin_y + static_cast<int32_t>(full_size.y)) };
+  if (x_begin >= x_end or y_begin >= y_end)
+    return;
+
+  for (uint32_t c = 0; c < ImageBlock::channel_count; ++c) {
+    const float* src{ block.channel(c) };
+    float*       dst{ storage_.channel(c) };
+    for (int32_t y = y_begin; y < y_end; ++y) {
+      const float* src_row{ src + static_cast<size_t>(y - origin_y) *
+                                    block.rowStride() -
+                            origin_x };
+      float* dst_row{ dst + static_cast<size_t>(y) * storage_.rowStride() };
+      for (int32_t x = x_begin; x < x_end; ++x) {
+        // Pixels no sample reached are common in the border, skip them to
+        // save the atomic
+        if (src_row[x] != 0.f)
+          std::atomic_ref<float>{ dst_row[x] }.fetch_add(
+            src_row[x], std::memory_order_relaxed);
+      }
+    }
+  }
+}
+
+void Film::clear() { storage_.clear(); }
+
+Bitmap Film::develop() const
+{
+  Bitmap bitmap{ "film", Bitmap::PixelFormat::RGB, StructType::Float32, size_,
+                 3 };
+  auto*  out{ reinterpret_cast<float*>(bitmap.data()) };
+  const float* r{ storage_.channel(0) };
+  const float* g{ storage_.channel(1) };
+  const float* b{ storage_.channel(2) };
+  const float* w{ storage_.channel(ImageBlock::weight_channel) };
+  for (uint32_t y = 0; y < size_.y; ++y) {
+    const size_t row{ y * storage_.rowStride() };
+    for (uint32_t x = 0; x < size_.x; ++x) {
+      const size_t i{ row + x };
+      const float  inv_weight{ w[i] > 0.f ? 1.f / w[i] : 0.f };
+      *out++ = r[i] * inv_weight;
+      *out++ = g[i] * inv_weight;
+      *out++ = b[i] * inv_weight;
+    }
+  }
+  return bitmap;
+}
+} // namespace eldr
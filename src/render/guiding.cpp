@@ -0,0 +1,233 @@
+#include <eldr/core/logger.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/core/parallel.hpp>
+#include <eldr/core/warp.hpp>
+#include <eldr/render/guiding.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace eldr::core;
+
+namespace eldr {
+namespace {
+/// @brief Pick quadrant `x + 2 * y` of `p` and map `p` into it
+uint32_t descend(CoreAliases<Float>::Point2f& p)
+{
+  const uint32_t x{ p.x >= 0.5f ? 1u : 0u };
+  const uint32_t y{ p.y >= 0.5f ? 1u : 0u };
+  p.x = std::min(2.f * p.x - static_cast<Float>(x), one_minus_epsilon);
+  p.y = std::min(2.f * p.y - static_cast<Float>(y), one_minus_epsilon);
+  return x + 2 * y;
+}
+
+/// @brief Choose between two options in proportion to their weights, and
+/// remap `u` to a uniform sample in [0, 1)
+uint32_t choose(Float weight0, Float weight1, Float& u)
+{
+  const Float p0{ weight0 / (weight0 + weight1) };
+  if (u < p0) {
+    u = std::min(u / p0, one_minus_epsilon);
+    return 0;
+  }
+  u = std::min((u - p0) / (1.f - p0), one_minus_epsilon);
+  return 1;
+}
+} // namespace
+
+// -----------------------------------------------------------------------------
+// DirectionalQuadtree
+// -----------------------------------------------------------------------------
+DirectionalQuadtree::DirectionalQuadtree() : sampling_(1), building_(1) {}
+
+DirectionalQuadtree::Vec3f DirectionalQuadtree::sample(Point2f u) const
+{
+  if (not trained_)
+    return warp::squareToUniformSphere(u);
+
+  // Pick the column of the quadrant with `u.x` and its row with `u.y`, which
+  // keeps a bit of precision per level in each coordinate for the final
+  // position within the leaf
+  Point2f  origin{ 0.f };
+  Float    size{ 1.f };
+  uint32_t index{ 0 };
+  while (true) {
+    const Node&    node{ sampling_[index] };
+    const uint32_t x{ choose(
+      node.sum[0] + node.sum[2], node.sum[1] + node.sum[3], u.x) };
+    const uint32_t y{ choose(node.sum[x], node.sum[x + 2], u.y) };
+    const uint32_t quadrant{ x + 2 * y };
+    size *= 0.5f;
+    origin += Point2f{ static_cast<Float>(x), static_cast<Float>(y) } * size;
+    if (node.child[quadrant] == 0)
+      break;
+    index = node.child[quadrant];
+  }
+  return warp::squareToUniformSphere(origin + u * size);
+}
+
+Float DirectionalQuadtree::pdf(const Vec3f& d) const
+{
+  if (not trained_)
+    return warp::inv_four_pi;
+
+  Point2f  p{ warp::uniformSphereToSquare(d) };
+  Float    pdf{ warp::inv_four_pi };
+  uint32_t index{ 0 };
+  while (true) {
+    const Node&    node{ sampling_[index] };
+    const uint32_t quadrant{ descend(p) };
+    const Float    total{ node.total() };
+    if (total <= 0.f or node.sum[quadrant] <= 0.f)
+      return 0.f;
+    pdf *= 4.f * node.sum[quadrant] / total;
+    if (node.child[quadrant] == 0)
+      return pdf;
+    index = node.child[quadrant];
+  }
+}
+
+void DirectionalQuadtree::record(const Vec3f& d, Float value)
+{
+  std::atomic_ref<uint64_t>{ sample_count_ }.fetch_add(
+    1, std::memory_order_relaxed);
+  if (not(value > 0.f) or not std::isfinite(value))
+    return;
+
+  Point2f  p{ warp::uniformSphereToSquare(d) };
+  uint32_t index{ 0 };
+  while (true) {
+    Node&          node{ building_[index] };
+    const uint32_t quadrant{ descend(p) };
+    std::atomic_ref<float>{ node.sum[quadrant] }.fetch_add(
+      value, std::memory_order_relaxed);
+    if (node.child[quadrant] == 0)
+      break;
+    index = node.child[quadrant];
+  }
+}
+
+void DirectionalQuadtree::refine(Float threshold, uint32_t max_depth)
+{
+  // Keep the previous distribution for regions no path went through
+  if (sample_count_ == 0)
+    return;
+  sample_count_ = 0;
+
+  const float total{ building_[0].total() };
+  sampling_.swap(building_);
+  trained_ = total > 0.f;
+  building_.assign(1, Node{});
+  if (not trained_)
+    return;
+
+  // Subdivide the quadrants holding enough energy, following the recorded
+  // tree where it exists and splitting the energy evenly where it needs to
+  // go deeper
+  struct Item {
+    uint32_t             node;
+    std::array<float, 4> energy;
+    /// Nodes of the recorded tree subdividing the quadrants, zero if none
+    std::array<uint32_t, 4> source;
+    uint32_t                depth;
+  };
+  std::vector<Item> stack{
+    { 0, sampling_[0].sum, sampling_[0].child, 1 }
+  };
+  while (not stack.empty()) {
+    const Item item{ stack.back() };
+    stack.pop_back();
+    if (item.depth >= max_depth)
+      continue;
+    for (uint32_t quadrant = 0; quadrant < 4; ++quadrant) {
+      const float energy{ item.energy[quadrant] };
+      if (energy <= threshold * total)
+        continue;
+      const auto child{ static_cast<uint32_t>(building_.size()) };
+      building_[item.node].child[quadrant] = child;
+      building_.emplace_back();
+
+      Item next{ child, {}, {}, item.depth + 1 };
+      if (const uint32_t source{ item.source[quadrant] }; source != 0) {
+        next.energy = sampling_[source].sum;
+        next.source = sampling_[source].child;
+      }
+      else
+        next.energy.fill(0.25f * energy);
+      stack.push_back(next);
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// SDTree
+// -----------------------------------------------------------------------------
+SDTree::SDTree(const BoundingBox3f& bounds) : nodes_(1), quadtrees_(1)
+{
+  Assert(bounds.valid(), "path guiding needs valid scene bounds");
+  // Slightly enlarged so that points on the boundary are inside
+  const Vec3f extents{ bounds.extents() };
+  const Float size{ 1.001f *
+                    std::max({ extents.x, extents.y, extents.z, 1e-3f }) };
+  bounds_ = BoundingBox3f{ bounds.center() - Vec3f{ 0.5f * size },
+                           bounds.center() + Vec3f{ 0.5f * size } };
+}
+
+uint32_t SDTree::leaf(const Point3f& p) const
+{
+  Vec3f    pos{ glm::clamp((p - bounds_.min) / bounds_.extents(), 0.f, 1.f) };
+  uint32_t index{ 0 };
+  while (nodes_[index].child[0] != 0) {
+    const Node&   node{ nodes_[index] };
+    const uint8_t axis{ node.axis };
+    if (pos[axis] < 0.5f) {
+      pos[axis] *= 2.f;
+      index = node.child[0];
+    }
+    else {
+      pos[axis] = 2.f * pos[axis] - 1.f;
+      index     = node.child[1];
+    }
+  }
+  return nodes_[index].quadtree;
+}
+
+void SDTree::refine(uint32_t iteration)
+{
+  // The number of samples doubles every iteration, the threshold only grows
+  // with its square root so the spatial resolution increases as well
+  const Float threshold{ spatial_threshold *
+                         std::sqrt(std::exp2(static_cast<Float>(iteration))) };
+
+  // Split leaves in halves sharing their samples until each is below the
+  // threshold. New nodes are appended, so they are visited by the same loop.
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    if (nodes_[i].child[0] != 0)
+      continue;
+    const uint32_t quadtree{ nodes_[i].quadtree };
+    if (static_cast<Float>(quadtrees_[quadtree].sample_count_) <= threshold)
+      continue;
+
+    quadtrees_[quadtree].sample_count_ /= 2;
+    const auto copy{ static_cast<uint32_t>(quadtrees_.size()) };
+    quadtrees_.push_back(quadtrees_[quadtree]);
+
+    const auto    first{ static_cast<uint32_t>(nodes_.size()) };
+    const uint8_t axis{ static_cast<uint8_t>((nodes_[i].axis + 1) % 3) };
+    nodes_[i].child = { first, first + 1 };
+    nodes_.push_back({ {}, quadtree, axis });
+    nodes_.push_back({ {}, copy, axis });
+  }
+
+  parallelFor(BlockedRange<size_t>{ 0, quadtrees_.size(), 64 },
+              [&](const BlockedRange<size_t>& range) {
+                for (size_t i = range.begin(); i != range.end(); ++i)
+                  quadtrees_[i].refine(directional_threshold,
+                                       max_directional_depth);
+              });
+  Log(Debug,
+      "Path guiding iteration {}: {} spatial leaves",
+      iteration,
+      quadtrees_.size());
+}
+} // namespace eldr
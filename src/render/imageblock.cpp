@@ -0,0 +1,95 @@
+#include <eldr/core/logger.hpp>
+#include <eldr/render/imageblock.hpp>
+#include <eldr/render/rfilter.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace eldr::core;
+
+namespace eldr {
+namespace {
+/// Number of floats per cache line, rows are padded to a multiple of this
+constexpr size_t floats_per_line{ 64 / sizeof(float) };
+} // namespace
+
+ImageBlock::ImageBlock(const Vec2u&                size,
+                       const ReconstructionFilter& filter,
+                       bool                        border)
+  : filter_(&filter), border_size_(border ? filter.borderSize() : 0)
+{
+  Assert(border_size_ <= max_border_size, "filter radius is too large");
+  setSize(size);
+}
+
+void ImageBlock::setSize(const Vec2u& size)
+{
+  size_ = size;
+  const Vec2u full_size{ fullSize() };
+  row_stride_ = (full_size.x + floats_per_line - 1) / floats_per_line *
+                floats_per_line;
+  plane_size_ = row_stride_ * full_size.y;
+  data_.resize(channel_count * plane_size_);
+}
+
+void ImageBlock::clear() { std::fill(data_.begin(), data_.end(), 0.f); }
+
+float* ImageBlock::channel(uint32_t index)
+{
+  return data_.data() + index * plane_size_;
+}
+
+const float* ImageBlock::channel(uint32_t index) const
+{
+  return data_.data() + index * plane_size_;
+}
+
+void ImageBlock::put(const Point2f& pos, const Color3f& value)
+{
+  // Position relative to the top left of the border, shifted so that pixel
+  // centers are at integer coordinates
+  const Float border{ static_cast<Float>(border_size_) };
+  const Point2f p{ pos.x - 0.5f - (static_cast<Float>(offset_.x) - border),
+                   pos.y - 0.5f - (static_cast<Float>(offset_.y) - border) };
+  const Float   radius{ filter_->radius() };
+  const Vec2u   full_size{ fullSize() };
+
+  const auto x_begin{ static_cast<int32_t>(std::max(0.f, std::ceil(p.x - radius))) };
+  const auto y_begin{ static_cast<int32_t>(std::max(0.f, std::ceil(p.y - radius))) };
+  const auto x_end{ std::min(static_cast<int32_t>(std::floor(p.x + radius)) + 1,
+                             static_cast<int32_t>(full_size.x)) };
+  const auto y_end{ std::min(static_cast<int32_t>(std::floor(p.y + radius)) + 1,
+                             static_cast<int32_t>(full_size.y)) };
+  if (x_begin >= x_end or y_begin >= y_end)
+    return;
+
+  // The filter is separable, so it only has to be looked up once per row and
+  // column
+  constexpr uint32_t max_extent{ 2 * max_border_size + 1 };
+  Float              weights_x[max_extent];
+  Float              weights_y[max_extent];
+  for (int32_t x = x_begin; x < x_end; ++x)
+    weights_x[x - x_begin] =
+      filter_->evalDiscretized(static_cast<Float>(x) - p.x);
+  for (int32_t y = y_begin; y < y_end; ++y)
+    weights_y[y - y_begin] =
+      filter_->evalDiscretized(static_cast<Float>(y) - p.y);
+
+  float* r{ channel(0) };
+  float* g{ channel(1) };
+  float* b{ channel(2) };
+  float* w{ channel(weight_channel) };
+  for (int32_t y = y_begin; y < y_end; ++y) {
+    const Float  wy{ weights_y[y - y_begin] };
+    const size_t row{ static_cast<size_t>(y) * row_stride_ };
+    for (int32_t x = x_begin; x < x_end; ++x) {
+      const Float  weight{ wy * weights_x[x - x_begin] };
+      const size_t i{ row + static_cast<size_t>(x) };
+      r[i] += value.x * weight;
+      g[i] += value.y * weight;
+      b[i] += value.z * weight;
+      w[i] += weight;
+    }
+  }
+}
+} // namespace eldr
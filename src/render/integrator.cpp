@@ -0,0 +1,615 @@
+#include <eldr/core/logger.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/core/parallel.hpp>
+#include <eldr/core/progress.hpp>
+#include <eldr/core/stopwatch.hpp>
+#include <eldr/render/accel.hpp>
+#include <eldr/render/bsdf.hpp>
+#include <eldr/render/emitter.hpp>
+#include <eldr/render/film.hpp>
+#include <eldr/render/guiding.hpp>
+#include <eldr/render/imageblock.hpp>
+#include <eldr/render/integrator.hpp>
+#include <eldr/render/interaction.hpp>
+#include <eldr/render/lightbvh.hpp>
+#include <eldr/render/sampler.hpp>
+#include <eldr/render/scene.hpp>
+#include <eldr/render/sensor.hpp>
+#include <eldr/render/wavefront.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <thread>
+
+using namespace eldr::core;
+
+namespace eldr {
+namespace {
+/// @brief Power heuristic for combining two sampling strategies
+Float misWeight(Float pdf_a, Float pdf_b)
+{
+  pdf_a *= pdf_a;
+  pdf_b *= pdf_b;
+  return pdf_a > 0.f ? pdf_a / (pdf_a + pdf_b) : 0.f;
+}
+} // namespace
+
+// -----------------------------------------------------------------------------
+// Tiles
+// -----------------------------------------------------------------------------
+std::vector<Tile> generateTiles(const CoreAliases<Float>::Vec2u& image_size,
+                                uint32_t                         tile_size,
+                                TileOrder                        order)
+{
+  using Vec2u = CoreAliases<Float>::Vec2u;
+  using Vec2i = CoreAliases<Float>::Vec2i;
+  Assert(tile_size > 0, "tile size must be positive");
+
+  const Vec2u count{ (image_size.x + tile_size - 1) / tile_size,
+                     (image_size.y + tile_size - 1) / tile_size };
+  const size_t      total{ static_cast<size_t>(count.x) * count.y };
+  std::vector<Tile> tiles;
+  tiles.reserve(total);
+  auto add_tile = [&](uint32_t x, uint32_t y) {
+    const Vec2u offset{ x * tile_size, y * tile_size };
+    tiles.push_back({ offset,
+                      { std::min(tile_size, image_size.x - offset.x),
+                        std::min(tile_size, image_size.y - offset.y) } });
+  };
+
+  switch (order) {
+    case TileOrder::Scanline:
+      for (uint32_t y = 0; y < count.y; ++y)
+        for (uint32_t x = 0; x < count.x; ++x)
+          add_tile(x, y);
+      break;
+    case TileOrder::Morton: {
+      std::vector<std::pair<uint32_t, Vec2u>> codes;
+      codes.reserve(total);
+      for (uint32_t y = 0; y < count.y; ++y)
+        for (uint32_t x = 0; x < count.x; ++x)
+          codes.push_back({ mortonEncode2(x, y), { x, y } });
+      std::sort(codes.begin(), codes.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+      });
+      for (const auto& [code, pos] : codes)
+        add_tile(pos.x, pos.y);
+      break;
+    }
+    case TileOrder::Spiral: {
+      // Walk a square spiral around the center tile with runs of length
+      // 1, 1, 2, 2, 3, 3, ... skipping positions outside of the image
+      constexpr std::array<Vec2i, 4> directions{
+        Vec2i{ 1, 0 }, Vec2i{ 0, 1 }, Vec2i{ -1, 0 }, Vec2i{ 0, -1 }
+      };
+      Vec2i    pos{ (static_cast<int>(count.x) - 1) / 2,
+                 (static_cast<int>(count.y) - 1) / 2 };
+      uint32_t direction{ 0 };
+      for (int run = 1; tiles.size() < total; ++run) {
+        for (int leg = 0; leg < 2; ++leg) {
+          for (int i = 0; i < run; ++i) {
+            if (pos.x >= 0 and pos.y >= 0 and
+                pos.x < static_cast<int>(count.x) and
+                pos.y < static_cast<int>(count.y))
+              add_tile(static_cast<uint32_t>(pos.x),
+                       static_cast<uint32_t>(pos.y));
+            pos += directions[direction];
+          }
+          direction = (direction + 1) % 4;
+        }
+      }
+      break;
+    }
+  }
+  return tiles;
+}
+
+// -----------------------------------------------------------------------------
+// PathIntegrator
+// -----------------------------------------------------------------------------
+PathIntegrator::PathIntegrator(const Settings& settings) : settings_(settings)
+{
+  Assert(settings_.spp > 0, "at least one sample per pixel is required");
+  Assert(settings_.adaptive_pass_spp > 1,
+         "adaptive sampling needs at least two samples per pass");
+  Assert(settings_.wavefront_size > 0, "wavefront size must be positive");
+  Assert(settings_.packet_size == 0 or settings_.packet_size == 8 or
+           settings_.packet_size == 16,
+         "packets hold 8 or 16 rays");
+  Assert(settings_.guiding_passes == 0 or
+           settings_.mode == ExecutionMode::Megakernel,
+         "path guiding needs the megakernel execution mode");
+  Assert(settings_.guiding_bsdf_fraction > 0.f and
+           settings_.guiding_bsdf_fraction <= 1.f,
+         "the BSDF fraction of path guiding must be in (0, 1]");
+  Assert(settings_.restir_candidates == 0 or
+           (settings_.mode == ExecutionMode::Megakernel and
+            settings_.guiding_passes == 0),
+         "ReSTIR needs the megakernel execution mode and no path guiding");
+  if (settings_.restir_spatial_neighbors > max_restir_spatial_neighbors) {
+    Log(Warn,
+        "ReSTIR reuses at most {} neighbours, not {}",
+        max_restir_spatial_neighbors,
+        settings_.restir_spatial_neighbors);
+    settings_.restir_spatial_neighbors = max_restir_spatial_neighbors;
+  }
+}
+
+void PathIntegrator::PixelStatistics::add(const Color3f& sample)
+{
+  // Welford's online algorithm, numerically stable unlike sum of squares
+  const Float value{ luminance(sample) };
+  ++count;
+  const Float delta{ value - mean };
+  mean += delta / static_cast<Float>(count);
+  m2 += delta * (value - mean);
+}
+
+Float PathIntegrator::PixelStatistics::relativeError() const
+{
+  if (count < 2)
+    return std::numeric_limits<Float>::infinity();
+  const Float n{ static_cast<Float>(count) };
+  const Float variance{ m2 / (n - 1.f) };
+  // Standard error of the mean. The floor on the mean keeps nearly black
+  // pixels, where any noise is invisible, from never converging.
+  return std::sqrt(variance / n) / std::max(mean, min_relative_mean);
+}
+
+void PathIntegrator::render(const Scene&             scene,
+                            const SceneAccel&        accel,
+                            const PerspectiveCamera& camera,
+                            const Sampler&           sampler,
+                            Film&                    film) const
+{
+  const Vec2u size{ film.size() };
+  Assert(camera.filmSize() == size, "camera and film size differ");
+  if (settings_.restir_candidates > 0) {
+    renderReSTIR(scene, accel, camera, sampler, film);
+    return;
+  }
+  const std::vector<Tile> tiles{ generateTiles(
+    size, settings_.tile_size, settings_.tile_order) };
+  const size_t pixel_count{ static_cast<size_t>(size.x) * size.y };
+
+  // Without adaptive sampling everything is rendered in a single pass
+  const bool     adaptive{ settings_.adaptive_threshold > 0.f and
+                       settings_.adaptive_pass_spp < settings_.spp };
+  const uint32_t pass_spp{ adaptive ? settings_.adaptive_pass_spp
+                                    : settings_.spp };
+  std::vector<PixelStatistics> statistics(adaptive ? pixel_count : 0);
+
+  ThreadPool*    pool{ ThreadPool::instance() };
+  const uint32_t worker_count{ pool ? pool->threadCount() : 1 };
+  Log(Info,
+      "Rendering {}x{} pixels at {} spp ({} tiles, {} threads)",
+      size.x,
+      size.y,
+      settings_.spp,
+      tiles.size(),
+      worker_count);
+  if (adaptive)
+    Log(Info,
+        "Adaptive sampling in passes of {} spp down to a relative error of {}",
+        pass_spp,
+        settings_.adaptive_threshold);
+
+  std::unique_ptr<SDTree> guide;
+  if (settings_.guiding_passes > 0) {
+    guide = std::make_unique<SDTree>(accel.tlas().bbox());
+    Log(Info, "Path guiding with {} training passes", settings_.guiding_passes);
+  }
+
+  // Progress is counted in samples, converged tiles count as finished
+  const uint64_t        total_samples{ pixel_count * settings_.spp };
+  std::atomic<uint64_t> finished_samples{ 0 };
+  std::atomic<uint64_t> rendered_samples{ 0 };
+  StopWatch             timer;
+  ProgressReporter      progress{ "Rendering" };
+
+  std::vector<Tile> active_tiles{ tiles };
+  uint32_t          sample_count{ 0 };
+  for (uint32_t pass = 0, sample_offset = 0;
+       sample_offset < settings_.spp and not active_tiles.empty();
+       ++pass, sample_offset += sample_count) {
+    // Training passes double in size, so that the guiding tree is refined
+    // each time it has twice as much data to learn from. Their samples are
+    // as unbiased as any others and are kept in the film.
+    const bool training{ guide and pass < settings_.guiding_passes };
+    sample_count = std::min(training ? 1u << pass : pass_spp,
+                            settings_.spp - sample_offset);
+    const auto     tile_count{ static_cast<uint32_t>(active_tiles.size()) };
+    std::vector<uint8_t> converged(tile_count, 0);
+
+    // One long-running task per worker, each pulling tiles off a shared
+    // counter. This keeps the scheduling overhead at one atomic per tile and
+    // the load balanced, since cheap tiles simply make a worker come back
+    // sooner.
+    std::atomic<uint32_t> next_tile{ 0 };
+    std::atomic<uint32_t> active_workers{ worker_count };
+    TaskGroup             group{ pool };
+    for (uint32_t i = 0; i < worker_count; ++i) {
+      group.run([&] {
+        try {
+          // Each worker splats into its own block and only touches the film
+          // once per tile
+          ImageBlock block{ film.createBlock(Vec2u{ settings_.tile_size }) };
+          const std::unique_ptr<Sampler> worker_sampler{ sampler.clone() };
+          WavefrontQueues                queues;
+          for (uint32_t index{
+                 next_tile.fetch_add(1, std::memory_order_relaxed) };
+               index < tile_count;
+               index = next_tile.fetch_add(1, std::memory_order_relaxed)) {
+            const Tile& tile{ active_tiles[index] };
+            const Float error{
+              settings_.mode == ExecutionMode::Wavefront
+                ? renderTileWavefront(scene,
+                                      accel,
+                                      camera,
+                                      tile,
+                                      sample_offset,
+                                      sample_count,
+                                      *worker_sampler,
+                                      block,
+                                      statistics.data(),
+                                      queues)
+                : renderTile(scene,
+                             accel,
+                             camera,
+                             tile,
+                             sample_offset,
+                             sample_count,
+                             *worker_sampler,
+                             block,
+                             statistics.data(),
+                             guide.get(),
+                             training)
+            };
+            film.put(block);
+
+            const uint64_t tile_pixels{ static_cast<uint64_t>(tile.size.x) *
+                                        tile.size.y };
+            rendered_samples.fetch_add(tile_pixels * sample_count,
+                                       std::memory_order_relaxed);
+            if (adaptive and error <= settings_.adaptive_threshold) {
+              converged[index] = 1;
+              finished_samples.fetch_add(
+                tile_pixels * (settings_.spp - sample_offset),
+                std::memory_order_relaxed);
+            }
+            else
+              finished_samples.fetch_add(tile_pixels * sample_count,
+                                         std::memory_order_relaxed);
+          }
+        }
+        catch (...) {
+          // Make the other workers stop early, the exception is rethrown by
+          // `group.wait()`
+          next_tile.store(tile_count, std::memory_order_relaxed);
+          active_workers.fetch_sub(1, std::memory_order_release);
+          throw;
+        }
+        active_workers.fetch_sub(1, std::memory_order_release);
+      });
+    }
+
+    // The progress bar can only be drawn from this thread
+    using namespace std::chrono_literals;
+    while (active_workers.load(std::memory_order_acquire) > 0) {
+      progress.update(
+        static_cast<float>(finished_samples.load(std::memory_order_relaxed)) /
+        static_cast<float>(total_samples));
+      std::this_thread::sleep_for(100ms);
+    }
+    group.wait();
+    if (training)
+      guide->refine(pass);
+
+    // Converged tiles leave the schedule for good
+    size_t kept{ 0 };
+    for (uint32_t i = 0; i < tile_count; ++i)
+      if (not converged[i])
+        active_tiles[kept++] = active_tiles[i];
+    active_tiles.resize(kept);
+  }
+  progress.update(1.f);
+  Log(Info,
+      "Rendering finished in {:.2f} s ({:.1f} spp on average)",
+      timer.seconds<float>(),
+      static_cast<double>(rendered_samples.load()) /
+        static_cast<double>(pixel_count));
+}
+
+Float
+PathIntegrator::renderTile(const Scene&             scene,
+                           const SceneAccel&        accel,
+                           const PerspectiveCamera& camera,
+                           const Tile&              tile,
+                           uint32_t                 sample_offset,
+                           uint32_t                 sample_count,
+                           Sampler&                 sampler,
+                           ImageBlock&              block,
+                           PixelStatistics*         statistics,
+                           SDTree*                  guide,
+                           bool                     train) const
+{
+  block.setOffset(tile.offset);
+  block.setSize(tile.size);
+  block.clear();
+
+  const uint32_t width{ camera.filmSize().x };
+  Float          max_error{ 0.f };
+  for (uint32_t y = tile.offset.y; y < tile.offset.y + tile.size.y; ++y) {
+    for (uint32_t x = tile.offset.x; x < tile.offset.x + tile.size.x; ++x) {
+      const size_t pixel_index{ static_cast<size_t>(y) * width + x };
+      for (uint32_t s = 0; s < sample_count; ++s) {
+        sampler.startPixelSample({ x, y }, sample_offset + s);
+        const Point2f film_pos{ Point2f{ static_cast<Float>(x),
+                                         static_cast<Float>(y) } +
+                                sampler.next2D() };
+        const Color3f value{ sample(
+          scene, accel, camera.sampleRay(film_pos), sampler, guide, train) };
+        // Drop the occasional NaN/inf instead of ruining the whole pixel
+        if (not std::isfinite(value.x + value.y + value.z))
+          continue;
+        block.put(film_pos, value);
+        if (statistics)
+          statistics[pixel_index].add(value);
+      }
+      if (statistics)
+        max_error = std::max(max_error, statistics[pixel_index].relativeError());
+    }
+  }
+  return max_error;
+}
+
+PathIntegrator::Color3f PathIntegrator::sample(const Scene&      scene,
+                                               const SceneAccel& accel,
+                                               const Ray3f&      primary_ray,
+                                               Sampler&          sampler,
+                                               SDTree*           guide,
+                                               bool              train) const
+{
+  PathState state;
+  state.ray    = primary_ray;
+  state.prev_p = primary_ray.o;
+  return trace(scene, accel, state, 0, sampler, guide, train);
+}
+
+PathIntegrator::Color3f PathIntegrator::trace(const Scene&      scene,
+                                              const SceneAccel& accel,
+                                              PathState&        state,
+                                              uint32_t          depth,
+                                              Sampler&          sampler,
+                                              SDTree*           guide,
+                                              bool              train) const
+{
+  // Radiance found along the path also arrives at the earlier vertices, in
+  // the direction they continued in
+  thread_local std::vector<GuidingVertex> vertices;
+  vertices.clear();
+  auto add_radiance = [&](const Color3f& value) {
+    for (GuidingVertex& vertex : vertices)
+      vertex.radiance += value / glm::max(vertex.throughput, Color3f{ 1e-8f });
+  };
+
+  for (;; ++depth) {
+    std::optional<EmitterSample> emitter_sample;
+    const Color3f                result{ state.result };
+    const bool                   alive{ shade(scene,
+                                accel,
+                                accel.rayIntersect(state.ray),
+                                depth,
+                                state,
+                                sampler,
+                                emitter_sample,
+                                guide) };
+    if (train)
+      add_radiance(state.result - result);
+    if (emitter_sample and not accel.occluded(emitter_sample->shadow_ray)) {
+      state.result += emitter_sample->value;
+      if (train)
+        add_radiance(emitter_sample->value);
+    }
+    if (not alive)
+      break;
+    if (train)
+      vertices.push_back({ state.prev_p,
+                           state.ray.d,
+                           state.throughput,
+                           Color3f{ 0.f },
+                           state.prev_bsdf_pdf });
+  }
+
+  for (const GuidingVertex& vertex : vertices)
+    guide->quadtree(vertex.p).record(vertex.d,
+                                     luminance(vertex.radiance) / vertex.pdf);
+  return state.result;
+}
+
+bool PathIntegrator::shade(const Scene&                   scene,
+                           const SceneAccel&              accel,
+                           const PreliminaryIntersection& pi,
+                           uint32_t                       depth,
+                           PathState&                     state,
+                           Sampler&                       sampler,
+                           std::optional<EmitterSample>&  emitter_sample,
+                           const SDTree*                  guide) const
+{
+  const Ray3f& ray{ state.ray };
+
+  //----------------------------------------------------------------------------
+  // Emission
+  //----------------------------------------------------------------------------
+  if (not pi.isValid()) {
+    if (const Emitter* env{ scene.environment.get() }; env) {
+      SurfaceInteraction si;
+      si.wi = -ray.d;
+      Float weight{ 1.f };
+      if (depth > 0) {
+        DirectionSample3f ds;
+        ds.d       = ray.d;
+        ds.dist    = std::numeric_limits<Float>::infinity();
+        ds.emitter = env;
+        weight     = misWeight(
+          state.prev_bsdf_pdf,
+          env->pdfDirection(state.prev_p, ds) *
+            emitterPmf(scene, state.prev_p, state.prev_n, env));
+      }
+      state.result += state.throughput * env->eval(si) * weight;
+    }
+    return false;
+  }
+
+  const SurfaceInteraction si{ accel.computeSurfaceInteraction(ray, pi) };
+  if (si.emitter) {
+    Float weight{ 1.f };
+    if (depth > 0) {
+      DirectionSample3f ds;
+      ds.p       = si.p;
+      ds.n       = si.n;
+      ds.d       = ray.d;
+      ds.dist    = glm::distance(state.prev_p, si.p);
+      ds.emitter = si.emitter;
+      weight = misWeight(
+        state.prev_bsdf_pdf,
+        si.emitter->pdfDirection(state.prev_p, ds) *
+          emitterPmf(scene, state.prev_p, state.prev_n, si.emitter));
+    }
+    state.result += state.throughput * si.emitter->eval(si) * weight;
+  }
+
+  if (depth + 1 >= settings_.max_depth or not si.bsdf)
+    return false;
+  const BSDF& bsdf{ *si.bsdf };
+
+  // With guiding, directions are sampled from a mix of the BSDF and the
+  // learned incident light, so both next event estimation and emitters hit
+  // later are weighted against the density of the mix
+  const DirectionalQuadtree* quadtree{ nullptr };
+  if (guide)
+    if (const DirectionalQuadtree& q{ guide->quadtree(si.p) }; q.trained())
+      quadtree = &q;
+  const Float bsdf_fraction{ quadtree ? settings_.guiding_bsdf_fraction : 1.f };
+  auto scatter_pdf = [&](const Vec3f& wo_local, const Vec3f& wo) {
+    Float pdf{ bsdf_fraction * bsdf.pdf(si, wo_local) };
+    if (quadtree)
+      pdf += (1.f - bsdf_fraction) * quadtree->pdf(wo);
+    return pdf;
+  };
+
+  //----------------------------------------------------------------------------
+  // Next event estimation
+  //----------------------------------------------------------------------------
+  if (not scene.emitters.empty()) {
+    // Both samples are drawn even if no emitter is picked, so the sampler
+    // dimensions of the following bounces don't depend on it
+    const auto [emitter, emitter_pdf] =
+      sampleEmitter(scene, si.p, si.n, sampler.next1D());
+    const Point2f emitter_sample_2d{ sampler.next2D() };
+    const auto [ds, emitter_weight] =
+      emitter ? emitter->sampleDirection(si.p, emitter_sample_2d)
+              : std::pair<DirectionSample3f, Color3f>{};
+    if (ds.pdf > 0.f) {
+      const Vec3f   wo{ si.toLocal(ds.d) };
+      const Color3f bsdf_value{ bsdf.eval(si, wo) };
+      if (bsdf_value != Color3f{ 0.f }) {
+        const Float weight{ misWeight(ds.pdf * emitter_pdf,
+                                      scatter_pdf(wo, ds.d)) };
+        emitter_sample = EmitterSample{
+          std::isinf(ds.dist) ? si.spawnRay(ds.d) : si.spawnRayTo(ds.p),
+          state.throughput * bsdf_value * emitter_weight *
+            (weight / emitter_pdf)
+        };
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // BSDF sampling
+  //----------------------------------------------------------------------------
+  // The strategy is picked even without a trained distribution, so the
+  // sampler dimensions of the following bounces don't depend on it
+  const Float   strategy_sample{ guide ? sampler.next1D() : 0.f };
+  const Point2f direction_sample{ sampler.next2D() };
+  Vec3f         wo;
+  Float         pdf;
+  if (strategy_sample < bsdf_fraction) {
+    const auto [bs, bsdf_weight] = bsdf.sample(si, direction_sample);
+    if (bs.pdf == 0.f)
+      return false;
+    wo = si.toWorld(bs.wo);
+    if (quadtree) {
+      pdf = scatter_pdf(bs.wo, wo);
+      state.throughput *= bsdf.eval(si, bs.wo) / pdf;
+    }
+    else {
+      pdf = bs.pdf;
+      state.throughput *= bsdf_weight;
+    }
+  }
+  else {
+    wo = quadtree->sample(direction_sample);
+    const Vec3f   wo_local{ si.toLocal(wo) };
+    const Color3f value{ bsdf.eval(si, wo_local) };
+    pdf = scatter_pdf(wo_local, wo);
+    if (pdf == 0.f or value == Color3f{ 0.f })
+      return false;
+    state.throughput *= value / pdf;
+  }
+  state.prev_p        = si.p;
+  state.prev_n        = si.n;
+  state.prev_bsdf_pdf = pdf;
+  state.ray           = si.spawnRay(wo);
+
+  //----------------------------------------------------------------------------
+  // Russian roulette
+  //----------------------------------------------------------------------------
+  if (depth + 1 >= settings_.rr_depth) {
+    const Float q{ std::min(
+      std::max({ state.throughput.x, state.throughput.y, state.throughput.z }),
+      0.95f) };
+    if (sampler.next1D() >= q)
+      return false;
+    state.throughput /= q;
+  }
+  return true;
+}
+
+std::pair<const Emitter*, Float>
+PathIntegrator::sampleEmitter(const Scene&   scene,
+                              const Point3f& p,
+                              const Vec3f&   n,
+                              Float          u) const
+{
+  if (settings_.use_light_bvh and scene.light_bvh) {
+    const SampledEmitter sampled{ scene.light_bvh->sample(p, n, u) };
+    return { sampled.emitter, sampled.pmf };
+  }
+  const auto emitter_count{ static_cast<uint32_t>(scene.emitters.size()) };
+  if (emitter_count == 0)
+    return { nullptr, 0.f };
+  const uint32_t index{ std::min(static_cast<uint32_t>(u * emitter_count),
+                                 emitter_count - 1) };
+  return { scene.emitters[index].get(),
+           1.f / static_cast<Float>(emitter_count) };
+}
+
+Float PathIntegrator::emitterPmf(const Scene&   scene,
+                                 const Point3f& p,
+                                 const Vec3f&   n,
+                                 const Emitter* emitter) const
+{
+  if (settings_.use_light_bvh and scene.light_bvh)
+    return scene.light_bvh->pmf(p, n, emitter);
+  return scene.emitters.empty()
+           ? 0.f
+           : 1.f / static_cast<Float>(scene.emitters.size());
+}
+} // namespace eldr
@@ -0,0 +1,334 @@
+#include <eldr/core/logger.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/render/emitter.hpp>
+#include <eldr/render/lightbvh.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+using namespace eldr::core;
+
+namespace eldr {
+namespace {
+/// Number of buckets per axis the build evaluates splits with
+constexpr uint32_t bucket_count{ 12 };
+
+/// @brief Cosine of the difference of two angles, clamped to one if the
+/// difference is negative
+Float cosSubClamped(Float sin_a, Float cos_a, Float sin_b, Float cos_b)
+{
+  return cos_a > cos_b ? 1.f : cos_a * cos_b + sin_a * sin_b;
+}
+
+/// @brief Sine of the difference of two angles, clamped to zero if the
+/// difference is negative
+Float sinSubClamped(Float sin_a, Float cos_a, Float sin_b, Float cos_b)
+{
+  return cos_a > cos_b ? 0.f : sin_a * cos_b - cos_a * sin_b;
+}
+
+/// @brief Estimate the cost of a node for the split heuristic, the power of
+/// the node weighted by the solid angle it emits into and its surface area
+Float splitCost(const LightBounds& b, const BoundingBox3f& parent, uint32_t axis)
+{
+  const Float theta_o{ safeAcos(b.cos_theta_o) };
+  const Float theta_e{ safeAcos(b.cos_theta_e) };
+  const Float theta_w{ std::min(theta_o + theta_e, pi) };
+  const Float sin_theta_o{ safeSqrt(1.f - b.cos_theta_o * b.cos_theta_o) };
+  const Float m_omega{ 2.f * pi * (1.f - b.cos_theta_o) +
+                       pi / 2.f *
+                         (2.f * theta_w * sin_theta_o -
+                          std::cos(theta_o - 2.f * theta_w) -
+                          2.f * theta_o * sin_theta_o + b.cos_theta_o) };
+  // Penalize thin slabs, which don't bound the emitters well when splitting
+  // across their short side
+  const auto  extents{ parent.extents() };
+  const Float kr{ std::max({ extents.x, extents.y, extents.z }) /
+                  std::max(extents[axis], 1e-6f) };
+  return b.phi * m_omega * kr * b.bbox.surfaceArea();
+}
+} // namespace
+
+// -----------------------------------------------------------------------------
+// LightBounds
+// -----------------------------------------------------------------------------
+LightBounds LightBounds::merge(const LightBounds& a, const LightBounds& b)
+{
+  if (a.phi == 0.f)
+    return b;
+  if (b.phi == 0.f)
+    return a;
+
+  LightBounds result;
+  result.bbox = a.bbox;
+  result.bbox.expand(b.bbox);
+  result.phi         = a.phi + b.phi;
+  result.cos_theta_e = std::min(a.cos_theta_e, b.cos_theta_e);
+  result.two_sided   = a.two_sided or b.two_sided;
+
+  // Smallest cone containing both normal cones
+  const Float theta_a{ safeAcos(a.cos_theta_o) };
+  const Float theta_b{ safeAcos(b.cos_theta_o) };
+  const Float theta_d{ safeAcos(glm::dot(a.w, b.w)) };
+  if (std::min(theta_d + theta_b, pi) <= theta_a) {
+    result.w           = a.w;
+    result.cos_theta_o = a.cos_theta_o;
+    return result;
+  }
+  if (std::min(theta_d + theta_a, pi) <= theta_b) {
+    result.w           = b.w;
+    result.cos_theta_o = b.cos_theta_o;
+    return result;
+  }
+  const Float theta_o{ (theta_a + theta_d + theta_b) / 2.f };
+  const Vec3f axis{ glm::cross(a.w, b.w) };
+  result.w = a.w;
+  if (theta_o >= pi or glm::length(axis) == 0.f) {
+    result.cos_theta_o = -1.f;
+    return result;
+  }
+  // Rotate the axis of `a` towards `b` until the cone touches both
+  const Vec3f k{ glm::normalize(axis) };
+  const Float theta_r{ theta_o - theta_a };
+  result.w = glm::normalize(a.w * std::cos(theta_r) +
+                            glm::cross(k, a.w) * std::sin(theta_r) +
+                            k * glm::dot(k, a.w) * (1.f - std::cos(theta_r)));
+  result.cos_theta_o = std::cos(theta_o);
+  return result;
+}
+
+Float LightBounds::importance(const Point3f& p, const Vec3f& n) const
+{
+  const Point3f center{ bbox.center() };
+  const Float   radius{ glm::length(bbox.extents()) / 2.f };
+  const Vec3f   to_p{ p - center };
+  // Don't let the distance fall below the size of the bounds, light sources
+  // right next to the point would get all the samples otherwise
+  const Float d2{ std::max(glm::dot(to_p, to_p), radius) };
+  const Float dist{ std::sqrt(glm::dot(to_p, to_p)) };
+
+  // Angle between the cone axis and the direction towards `p`
+  Float cos_theta_w{ dist > 0.f ? glm::dot(w, to_p) / dist : 1.f };
+  if (two_sided)
+    cos_theta_w = std::abs(cos_theta_w);
+  const Float sin_theta_w{ safeSqrt(1.f - cos_theta_w * cos_theta_w) };
+
+  // Angle subtended by the bounds as seen from `p`
+  Float cos_theta_b{ -1.f };
+  if (dist > radius) {
+    const Float sin2_theta_b{ radius * radius / (dist * dist) };
+    cos_theta_b = safeSqrt(1.f - sin2_theta_b);
+  }
+  const Float sin_theta_b{ safeSqrt(1.f - cos_theta_b * cos_theta_b) };
+
+  // Smallest angle between an emitting direction and a direction towards p
+  const Float sin_theta_o{ safeSqrt(1.f - cos_theta_o * cos_theta_o) };
+  const Float cos_theta_x{ cosSubClamped(
+    sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o) };
+  const Float sin_theta_x{ sinSubClamped(
+    sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o) };
+  const Float cos_theta_p{ cosSubClamped(
+    sin_theta_x, cos_theta_x, sin_theta_b, cos_theta_b) };
+  if (cos_theta_p <= cos_theta_e)
+    return 0.f;
+
+  Float result{ phi * cos_theta_p / d2 };
+  if (n != Vec3f{ 0.f } and dist > 0.f) {
+    // Smallest angle between the normal at `p` and a direction towards the
+    // bounds
+    const Float cos_theta_i{ std::abs(glm::dot(-to_p, n)) / dist };
+    const Float sin_theta_i{ safeSqrt(1.f - cos_theta_i * cos_theta_i) };
+    result *= cosSubClamped(sin_theta_i, cos_theta_i, sin_theta_b, cos_theta_b);
+  }
+  return std::max(result, 0.f);
+}
+
+// -----------------------------------------------------------------------------
+// LightBVH
+// -----------------------------------------------------------------------------
+LightBVH::LightBVH(std::span<const std::shared_ptr<Emitter>> emitters)
+{
+  std::vector<std::pair<uint32_t, LightBounds>> bounds;
+  for (const auto& emitter : emitters) {
+    const std::optional<LightBounds> b{ emitter->bounds() };
+    if (not b) {
+      unbounded_.push_back(emitter.get());
+      continue;
+    }
+    // Emitters without power never contribute, so they are never picked
+    if (b->phi <= 0.f)
+      continue;
+    bounds.emplace_back(static_cast<uint32_t>(bounded_.size()), *b);
+    bounded_.push_back(emitter.get());
+  }
+  if (not bounds.empty()) {
+    nodes_.reserve(2 * bounds.size() - 1);
+    build(bounds, 0, bounds.size(), 0, 0);
+  }
+  Log(Debug,
+      "Built light BVH with {} nodes over {} emitters, {} emitters unbounded",
+      nodes_.size(),
+      bounded_.size(),
+      unbounded_.size());
+}
+
+uint32_t
+LightBVH::build(std::vector<std::pair<uint32_t, LightBounds>>& emitters,
+                size_t                                         first,
+                size_t                                         last,
+                uint64_t                                       bits,
+                uint32_t                                       depth)
+{
+  const auto index{ static_cast<uint32_t>(nodes_.size()) };
+  if (last - first == 1) {
+    nodes_.push_back({ emitters[first].second, emitters[first].first, true });
+    emitter_bits_[bounded_[emitters[first].first]] = bits;
+    return index;
+  }
+
+  BoundingBox3f bbox, centroid_bbox;
+  for (size_t i = first; i < last; ++i) {
+    bbox.expand(emitters[i].second.bbox);
+    centroid_bbox.expand(emitters[i].second.bbox.center());
+  }
+
+  // Find the bucket boundary with the lowest cost over all axes
+  Float    best_cost{ std::numeric_limits<Float>::infinity() };
+  uint32_t best_axis{ 0 }, best_bucket{ 0 };
+  auto     bucket_of = [&](const LightBounds& b, uint32_t axis) {
+    const Float extent{ centroid_bbox.max[axis] - centroid_bbox.min[axis] };
+    const auto  bucket{ static_cast<uint32_t>(
+      bucket_count * (b.bbox.center()[axis] - centroid_bbox.min[axis]) /
+      extent) };
+    return std::min(bucket, bucket_count - 1);
+  };
+  for (uint32_t axis = 0; axis < 3; ++axis) {
+    if (centroid_bbox.max[axis] == centroid_bbox.min[axis])
+      continue;
+    std::array<LightBounds, bucket_count> buckets;
+    for (size_t i = first; i < last; ++i) {
+      LightBounds& bucket{ buckets[bucket_of(emitters[i].second, axis)] };
+      bucket = LightBounds::merge(bucket, emitters[i].second);
+    }
+    for (uint32_t split = 1; split < bucket_count; ++split) {
+      LightBounds below, above;
+      for (uint32_t b = 0; b < split; ++b)
+        below = LightBounds::merge(below, buckets[b]);
+      for (uint32_t b = split; b < bucket_count; ++b)
+        above = LightBounds::merge(above, buckets[b]);
+      if (below.phi == 0.f or above.phi == 0.f)
+        continue;
+      const Float cost{ splitCost(below, bbox, axis) +
+                        splitCost(above, bbox, axis) };
+      if (cost < best_cost) {
+        best_cost   = cost;
+        best_axis   = axis;
+        best_bucket = split;
+      }
+    }
+  }
+
+  size_t mid{ (first + last) / 2 };
+  // Splitting in the middle bounds the depth, so the bits always fit
+  if (best_cost < std::numeric_limits<Float>::infinity() and depth < 32) {
+    const auto it{ std::partition(
+      emitters.begin() + first,
+      emitters.begin() + last,
+      [&](const auto& e) { return bucket_of(e.second, best_axis) < best_bucket; }) };
+    const auto split{ static_cast<size_t>(it - emitters.begin()) };
+    if (split != first and split != last)
+      mid = split;
+  }
+  Assert(depth < 64, "light BVH is too deep");
+
+  nodes_.push_back({});
+  const uint32_t first_child{ build(emitters, first, mid, bits, depth + 1) };
+  const uint32_t second_child{ build(
+    emitters, mid, last, bits | (uint64_t{ 1 } << depth), depth + 1) };
+  nodes_[index] = { LightBounds::merge(nodes_[first_child].bounds,
+                                       nodes_[second_child].bounds),
+                    second_child,
+                    false };
+  return index;
+}
+
+Float LightBVH::treeProbability() const
+{
+  if (nodes_.empty())
+    return 0.f;
+  return 1.f / static_cast<Float>(unbounded_.size() + 1);
+}
+
+SampledEmitter
+LightBVH::sample(const Point3f& p, const Vec3f& n, Float u) const
+{
+  const Float tree_prob{ treeProbability() };
+  if (u >= tree_prob) {
+    if (unbounded_.empty())
+      return {};
+    const Float    unbounded_prob{ 1.f - tree_prob };
+    const auto     count{ static_cast<uint32_t>(unbounded_.size()) };
+    const uint32_t index{ std::min(
+      static_cast<uint32_t>((u - tree_prob) / unbounded_prob * count),
+      count - 1) };
+    return { unbounded_[index], unbounded_prob / static_cast<Float>(count) };
+  }
+  u = std::min(u / tree_prob, one_minus_epsilon);
+
+  Float    pmf{ tree_prob };
+  uint32_t index{ 0 };
+  while (not nodes_[index].leaf) {
+    const Node& node{ nodes_[index] };
+    const Float first{ nodes_[index + 1].bounds.importance(p, n) };
+    const Float second{ nodes_[node.offset].bounds.importance(p, n) };
+    if (first == 0.f and second == 0.f)
+      return {};
+    const Float first_prob{ first / (first + second) };
+    if (u < first_prob) {
+      index = index + 1;
+      u     = std::min(u / first_prob, one_minus_epsilon);
+      pmf *= first_prob;
+    }
+    else {
+      index = node.offset;
+      u     = std::min((u - first_prob) / (1.f - first_prob), one_minus_epsilon);
+      pmf *= 1.f - first_prob;
+    }
+  }
+  // Interior nodes already reject emitters that can't reach `p`, only a tree
+  // of a single leaf has to be checked here
+  if (index == 0 and nodes_[0].bounds.importance(p, n) == 0.f)
+    return {};
+  return { bounded_[nodes_[index].offset], pmf };
+}
+
+Float LightBVH::pmf(const Point3f& p, const Vec3f& n, const Emitter* emitter)
+  const
+{
+  const auto it{ emitter_bits_.find(emitter) };
+  if (it == emitter_bits_.end()) {
+    if (std::find(unbounded_.begin(), unbounded_.end(), emitter) ==
+        unbounded_.end())
+      return 0.f;
+    return (1.f - treeProbability()) / static_cast<Float>(unbounded_.size());
+  }
+
+  Float    pmf{ treeProbability() };
+  uint64_t bits{ it->second };
+  uint32_t index{ 0 };
+  while (not nodes_[index].leaf) {
+    const Node& node{ nodes_[index] };
+    const Float first{ nodes_[index + 1].bounds.importance(p, n) };
+    const Float second{ nodes_[node.offset].bounds.importance(p, n) };
+    if (first == 0.f and second == 0.f)
+      return 0.f;
+    const bool second_taken{ (bits & 1) != 0 };
+    pmf *= (second_taken ? second : first) / (first + second);
+    index = second_taken ? node.offset : index + 1;
+    bits >>= 1;
+  }
+  return pmf;
+}
+} // namespace eldr
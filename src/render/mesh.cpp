@@ -1,20 +1,130 @@
+#include <eldr/core/bbox.hpp>
+#include <eldr/core/hash.hpp>
 #include <eldr/core/logger.hpp>
+#include <eldr/core/math.hpp>
 #include <eldr/render/mesh.hpp>
 #include <eldr/vulkan/engine.hpp>
 
+#include <algorithm>
+
 namespace eldr {
+namespace {
+/// @brief Reorder `values` so that element `i` moves to `new_index[i]`.
+/// Attributes a mesh doesn't have are left empty.
+template <typename T>
+void permute(std::vector<T>& values, const std::vector<uint32_t>& new_index)
+{
+  if (values.empty())
+    return;
+  Assert(values.size() == new_index.size(), "vertex attribute size mismatch");
+  std::vector<T> permuted(values.size());
+  for (size_t i = 0; i < values.size(); ++i)
+    permuted[new_index[i]] = std::move(values[i]);
+  values = std::move(permuted);
+}
+} // namespace
 
 Mesh::Mesh(std::string_view          name,
            std::vector<Point3f>&&    positions,
            std::vector<Point2f>&&    texcoords,
            std::vector<Color4f>&&    colors,
            std::vector<Vec3f>&&      normals,
+           std::vector<uint32_t>&&   indices,
            std::vector<GeoSurface>&& surfaces)
-  : Shape(name, ShapeType::Mesh), vtx_positions_(positions),
-    vtx_texcoords_(texcoords), vtx_colors_(colors), vtx_normals_(normals),
-    surfaces_(surfaces)
+  : Shape(name, ShapeType::Mesh), vtx_positions_(std::move(positions)),
+    vtx_texcoords_(std::move(texcoords)), vtx_colors_(std::move(colors)),
+    vtx_normals_(std::move(normals)), indices_(std::move(indices)),
+    surfaces_(std::move(surfaces))
+
+{
+}
+
+uint32_t Mesh::surfaceIndex(size_t index) const
+{
+  // Surfaces are sorted by their first index and meshes rarely have more than
+  // a handful of them
+  const auto first_index{ static_cast<uint32_t>(3 * index) };
+  const auto it{ std::upper_bound(
+    surfaces_.begin(),
+    surfaces_.end(),
+    first_index,
+    [](uint32_t i, const GeoSurface& s) { return i < s.start_index; }) };
+  Assert(it != surfaces_.begin(), "face is not part of any surface");
+  return static_cast<uint32_t>(it - surfaces_.begin() - 1);
+}
 
+uint64_t Mesh::geometryHash() const
 {
+  const uint64_t positions_hash{ hashBuffer(
+    vtx_positions_.data(), vtx_positions_.size() * sizeof(Point3f)) };
+  return hashBuffer(
+    indices_.data(), indices_.size() * sizeof(uint32_t), positions_hash);
 }
 
+void Mesh::optimizeLayout()
+{
+  const size_t face_count{ faceCount() };
+  if (face_count == 0)
+    return;
+
+  std::vector<Point3f> centroids(face_count);
+  BoundingBox3f        bounds;
+  for (size_t f = 0; f < face_count; ++f) {
+    const Vec3u idx{ faceIndices(f) };
+    centroids[f] = (vtx_positions_[idx.x] + vtx_positions_[idx.y] +
+                    vtx_positions_[idx.z]) /
+                   3.f;
+    bounds.expand(centroids[f]);
+  }
+
+  // Sort the faces of each surface by the Morton code of their centroid on a
+  // 1024^3 grid. The face index in the lower bits keeps the order stable.
+  constexpr uint32_t grid_size{ 1024 };
+  const Vec3f        extents{ glm::max(bounds.extents(), Vec3f{ 1e-6f }) };
+  const Vec3f        scale{ static_cast<Float>(grid_size) / extents };
+  auto               cell = [&](const Point3f& c, uint32_t axis) {
+    const Float v{ (c[axis] - bounds.min[axis]) * scale[axis] };
+    return static_cast<uint32_t>(
+      std::clamp(v, 0.f, static_cast<Float>(grid_size - 1)));
+  };
+  std::vector<uint64_t> keys;
+  std::vector<uint32_t> indices(indices_);
+  for (const GeoSurface& surface : surfaces_) {
+    const size_t first{ surface.start_index / 3 };
+    const size_t last{ (surface.start_index + surface.count) / 3 };
+    keys.clear();
+    for (size_t f = first; f < last; ++f) {
+      const uint32_t morton{ mortonEncode3(cell(centroids[f], 0),
+                                           cell(centroids[f], 1),
+                                           cell(centroids[f], 2)) };
+      keys.push_back((static_cast<uint64_t>(morton) << 32) | f);
+    }
+    std::sort(keys.begin(), keys.end());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      const size_t f{ keys[i] & 0xffffffff };
+      for (size_t k = 0; k < 3; ++k)
+        indices[3 * (first + i) + k] = indices_[3 * f + k];
+    }
+  }
+  indices_ = std::move(indices);
+
+  // Number the vertices by first use. Vertices no face refers to keep their
+  // relative order at the end.
+  constexpr uint32_t    unused{ ~0u };
+  std::vector<uint32_t> new_index(vtx_positions_.size(), unused);
+  uint32_t              next{ 0 };
+  for (uint32_t& index : indices_) {
+    if (new_index[index] == unused)
+      new_index[index] = next++;
+    index = new_index[index];
+  }
+  for (uint32_t& index : new_index) {
+    if (index == unused)
+      index = next++;
+  }
+  permute(vtx_positions_, new_index);
+  permute(vtx_texcoords_, new_index);
+  permute(vtx_colors_, new_index);
+  permute(vtx_normals_, new_index);
+}
 } // namespace eldr
@@ -0,0 +1,350 @@
+#include <eldr/core/logger.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/core/parallel.hpp>
+#include <eldr/core/progress.hpp>
+#include <eldr/core/stopwatch.hpp>
+#include <eldr/core/warp.hpp>
+#include <eldr/render/accel.hpp>
+#include <eldr/render/bsdf.hpp>
+#include <eldr/render/emitter.hpp>
+#include <eldr/render/film.hpp>
+#include <eldr/render/imageblock.hpp>
+#include <eldr/render/integrator.hpp>
+#include <eldr/render/restir.hpp>
+#include <eldr/render/sampler.hpp>
+#include <eldr/render/scene.hpp>
+#include <eldr/render/sensor.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <memory>
+
+using namespace eldr::core;
+
+namespace eldr {
+namespace {
+using Float   = CoreAliases<Float>::Float;
+using Vec3f   = CoreAliases<Float>::Vec3f;
+using Color3f = CoreAliases<Float>::Color3f;
+
+/// @brief Get the direction from `si` towards a light sample and the
+/// geometry term converting its area density to solid angle, zero if the
+/// light leaves the other side of the emitter
+Float geometry(const SurfaceInteraction& si, const LightSample& y, Vec3f& d)
+{
+  if (y.infinite) {
+    d = y.p;
+    return 1.f;
+  }
+  const Vec3f v{ y.p - si.p };
+  const Float dist2{ glm::dot(v, v) };
+  if (dist2 == 0.f)
+    return 0.f;
+  d = v / std::sqrt(dist2);
+  return std::max(-glm::dot(y.n, d), 0.f) / dist2;
+}
+
+/// @brief Get the unshadowed contribution of a light sample at `si`, in area
+/// measure. Its luminance is the target function of the resampling.
+Color3f contribution(const SurfaceInteraction& si, const LightSample& y)
+{
+  Vec3f       d;
+  const Float g{ geometry(si, y, d) };
+  if (g == 0.f)
+    return Color3f{ 0.f };
+  return si.bsdf->eval(si, si.toLocal(d)) * y.radiance * g;
+}
+
+Float targetPdf(const SurfaceInteraction& si, const LightSample& y)
+{
+  return luminance(contribution(si, y));
+}
+
+Ray3f shadowRay(const SurfaceInteraction& si, const LightSample& y)
+{
+  return y.infinite ? si.spawnRay(y.p) : si.spawnRayTo(y.p);
+}
+
+/// @brief Set the contribution weight of a reservoir at `si` after its
+/// candidates were added
+/// @param z Number of candidates that could have produced the sample, `r.M`
+/// unless some were merged from shading points the sample can't reach
+void finalize(Reservoir& r, const SurfaceInteraction& si, Float z)
+{
+  const Float p_hat{ r.y.emitter ? targetPdf(si, r.y) : 0.f };
+  r.W = p_hat > 0.f and z > 0.f ? r.w_sum / (z * p_hat) : 0.f;
+}
+
+void finalize(Reservoir& r, const SurfaceInteraction& si)
+{
+  finalize(r, si, r.M);
+}
+
+/// @brief Add the sample of `other` to `r`, resampled for `si`
+void merge(Reservoir&                r,
+           const Reservoir&          other,
+           const SurfaceInteraction& si,
+           Float                     u)
+{
+  const Float p_hat{ other.y.emitter ? targetPdf(si, other.y) : 0.f };
+  r.update(other.y, p_hat * other.W * other.M, u);
+  r.M += other.M;
+}
+
+/// @brief Check whether two primary hits are on similar enough surfaces to
+/// share light samples: reusing across edges darkens them
+bool similar(const ReSTIRBuffers::Primary& a, const ReSTIRBuffers::Primary& b)
+{
+  return a.depth > 0.f and b.depth > 0.f and glm::dot(a.n, b.n) > 0.9f and
+         std::abs(a.depth - b.depth) < 0.1f * a.depth;
+}
+} // namespace
+
+void PathIntegrator::renderReSTIR(const Scene&             scene,
+                                  const SceneAccel&        accel,
+                                  const PerspectiveCamera& camera,
+                                  const Sampler&           sampler,
+                                  Film&                    film) const
+{
+  const Vec2u             size{ film.size() };
+  const std::vector<Tile> tiles{ generateTiles(
+    size, settings_.tile_size, settings_.tile_order) };
+  const size_t pixel_count{ static_cast<size_t>(size.x) * size.y };
+  const auto   candidates{ static_cast<Float>(settings_.restir_candidates) };
+
+  ThreadPool*    pool{ ThreadPool::instance() };
+  const uint32_t worker_count{ pool ? pool->threadCount() : 1 };
+  // Bounds the neighbours remembered per pixel below
+  const uint32_t neighbor_target{ std::min(settings_.restir_spatial_neighbors,
+                                           max_restir_spatial_neighbors) };
+  Log(Info,
+      "Rendering {}x{} pixels at {} spp with ReSTIR direct lighting ({} "
+      "candidates, {} neighbours, {} threads)",
+      size.x,
+      size.y,
+      settings_.spp,
+      settings_.restir_candidates,
+      neighbor_target,
+      worker_count);
+
+  ReSTIRBuffers buffers;
+  buffers.resize(pixel_count);
+  auto pixel_index = [&](uint32_t x, uint32_t y) {
+    return static_cast<size_t>(y) * size.x + x;
+  };
+  // Whether the light sample of a reservoir could have been picked at
+  // another shading point: only if it contributes there, occlusion included
+  auto reaches = [&](const ReSTIRBuffers::Primary& primary,
+                     const LightSample&            y) {
+    const SurfaceInteraction si{ accel.computeSurfaceInteraction(
+      primary.ray, primary.pi) };
+    return si.bsdf and targetPdf(si, y) > 0.f and
+           not accel.occluded(shadowRay(si, y));
+  };
+
+  // Call `func(x, y, sampler)` for every pixel, in parallel over the tiles
+  auto for_each_pixel = [&](auto&& func, auto&& end_tile) {
+    parallelFor(
+      BlockedRange<size_t>{ 0, tiles.size() },
+      [&](const BlockedRange<size_t>& range) {
+        const std::unique_ptr<Sampler> worker_sampler{ sampler.clone() };
+        ImageBlock block{ film.createBlock(Vec2u{ settings_.tile_size }) };
+        for (size_t t = range.begin(); t < range.end(); ++t) {
+          const Tile& tile{ tiles[t] };
+          block.setOffset(tile.offset);
+          block.setSize(tile.size);
+          block.clear();
+          for (uint32_t y = tile.offset.y; y < tile.offset.y + tile.size.y; ++y)
+            for (uint32_t x = tile.offset.x; x < tile.offset.x + tile.size.x;
+                 ++x)
+              func(x, y, *worker_sampler, block);
+          end_tile(block);
+        }
+      });
+  };
+
+  StopWatch        timer;
+  ProgressReporter progress{ "Rendering" };
+  for (uint32_t frame = 0; frame < settings_.spp; ++frame) {
+    //--------------------------------------------------------------------------
+    // Candidates and temporal reuse
+    //--------------------------------------------------------------------------
+    const bool temporal{ frame > 0 and settings_.restir_history_limit > 0.f };
+    for_each_pixel(
+      [&](uint32_t x, uint32_t y, Sampler& pixel_sampler, ImageBlock&) {
+        const size_t             index{ pixel_index(x, y) };
+        ReSTIRBuffers::Primary&  primary{ buffers.primary[index] };
+        Reservoir&               r{ buffers.reservoirs[index] };
+        pixel_sampler.startPixelSample({ x, y }, frame);
+        primary.film_pos = Point2f{ static_cast<Float>(x),
+                                    static_cast<Float>(y) } +
+                           pixel_sampler.next2D();
+        primary.ray   = camera.sampleRay(primary.film_pos);
+        primary.pi    = accel.rayIntersect(primary.ray);
+        primary.depth = 0.f;
+        r             = Reservoir{};
+
+        if (primary.pi.isValid()) {
+          const SurfaceInteraction si{ accel.computeSurfaceInteraction(
+            primary.ray, primary.pi) };
+          primary.n     = si.sh_frame.n;
+          primary.depth = si.t;
+          if (si.bsdf and not scene.emitters.empty()) {
+            // Resample the candidates in proportion to their unshadowed
+            // contribution. The weights are in area measure, like the
+            // samples, so that they can be moved to other shading points.
+            for (uint32_t i = 0; i < settings_.restir_candidates; ++i) {
+              const auto [emitter, emitter_pdf] =
+                sampleEmitter(scene, si.p, si.n, pixel_sampler.next1D());
+              const Point2f sample_2d{ pixel_sampler.next2D() };
+              const Float   u{ pixel_sampler.next1D() };
+              r.M += 1.f;
+              if (not emitter)
+                continue;
+              const auto [ds, emitter_weight] =
+                emitter->sampleDirection(si.p, sample_2d);
+              if (ds.pdf == 0.f)
+                continue;
+              const bool        infinite{ std::isinf(ds.dist) };
+              const LightSample candidate{ infinite ? ds.d : ds.p,
+                                           ds.n,
+                                           emitter_weight * ds.pdf,
+                                           emitter,
+                                           infinite };
+              Vec3f       d;
+              const Float g{ geometry(si, candidate, d) };
+              if (g == 0.f)
+                continue;
+              r.update(candidate,
+                       targetPdf(si, candidate) / (emitter_pdf * ds.pdf * g),
+                       u);
+            }
+            finalize(r, si);
+
+            const Float u{ pixel_sampler.next1D() };
+            const ReSTIRBuffers::Primary& previous{ buffers.previous[index] };
+            if (temporal and similar(primary, previous)) {
+              Reservoir history{ buffers.history[index] };
+              history.M =
+                std::min(history.M, settings_.restir_history_limit * candidates);
+              Reservoir combined;
+              merge(combined, r, si, 0.f);
+              merge(combined, history, si, u);
+              finalize(combined,
+                       si,
+                       r.M + (reaches(previous, combined.y) ? history.M : 0.f));
+              r = combined;
+            }
+
+            // Samples that turn out occluded keep their place in the
+            // reservoir, but with no weight they don't spread to neighbours.
+            // Every reservoir passed on thus reaches its own shading point.
+            if (r.W > 0.f and accel.occluded(shadowRay(si, r.y)))
+              r.W = 0.f;
+          }
+        }
+        primary.dimension = pixel_sampler.dimension();
+      },
+      [](ImageBlock&) {});
+
+    //--------------------------------------------------------------------------
+    // Spatial reuse and shading
+    //--------------------------------------------------------------------------
+    for_each_pixel(
+      [&](uint32_t x, uint32_t y, Sampler& pixel_sampler, ImageBlock& block) {
+        const size_t                  index{ pixel_index(x, y) };
+        const ReSTIRBuffers::Primary& primary{ buffers.primary[index] };
+        Reservoir&                    r{ buffers.reused[index] };
+        pixel_sampler.startPixelSample({ x, y }, frame);
+        pixel_sampler.setDimension(primary.dimension);
+        r = buffers.reservoirs[index];
+
+        Color3f value{ 0.f };
+        if (not primary.pi.isValid()) {
+          if (const Emitter* env{ scene.environment.get() }; env) {
+            SurfaceInteraction si;
+            si.wi = -primary.ray.d;
+            value = env->eval(si);
+          }
+        }
+        else {
+          const SurfaceInteraction si{ accel.computeSurfaceInteraction(
+            primary.ray, primary.pi) };
+          if (si.emitter)
+            value += si.emitter->eval(si);
+
+          if (si.bsdf and settings_.max_depth > 1) {
+            // Neighbours on different surfaces are rejected. The others only
+            // count towards the candidates of the result if its sample
+            // reaches their shading point, which keeps shadow edges from
+            // darkening.
+            Reservoir combined;
+            merge(combined, r, si, 0.f);
+            std::array<size_t, max_restir_spatial_neighbors> neighbors;
+            uint32_t neighbor_count{ 0 };
+            for (uint32_t i = 0; i < neighbor_target; ++i) {
+              const Point2f offset{ warp::squareToUniformDiskConcentric(
+                                      pixel_sampler.next2D()) *
+                                    settings_.restir_spatial_radius };
+              const Float   u{ pixel_sampler.next1D() };
+              const auto    nx{ static_cast<int64_t>(
+                std::floor(static_cast<Float>(x) + offset.x)) };
+              const auto    ny{ static_cast<int64_t>(
+                std::floor(static_cast<Float>(y) + offset.y)) };
+              if (nx < 0 or ny < 0 or nx >= size.x or ny >= size.y or
+                  (nx == x and ny == y))
+                continue;
+              const size_t neighbor{ pixel_index(static_cast<uint32_t>(nx),
+                                                 static_cast<uint32_t>(ny)) };
+              if (similar(primary, buffers.primary[neighbor])) {
+                merge(combined, buffers.reservoirs[neighbor], si, u);
+                neighbors[neighbor_count++] = neighbor;
+              }
+            }
+            Float z{ r.M };
+            if (combined.y.emitter)
+              for (uint32_t i = 0; i < neighbor_count; ++i)
+                if (reaches(buffers.primary[neighbors[i]], combined.y))
+                  z += buffers.reservoirs[neighbors[i]].M;
+            finalize(combined, si, z);
+            r = combined;
+
+            if (r.W > 0.f) {
+              if (accel.occluded(shadowRay(si, r.y)))
+                r.W = 0.f;
+              else
+                value += contribution(si, r.y) * r.W;
+            }
+
+            // Indirect light is path traced. A zero BSDF density gives the
+            // emitters hit by the next bounce no weight, since their direct
+            // light is already accounted for by the reservoirs.
+            const auto [bs, bsdf_weight] =
+              si.bsdf->sample(si, pixel_sampler.next2D());
+            if (bs.pdf > 0.f) {
+              PathState state;
+              state.throughput    = bsdf_weight;
+              state.prev_p        = si.p;
+              state.prev_n        = si.n;
+              state.prev_bsdf_pdf = 0.f;
+              state.ray           = si.spawnRay(si.toWorld(bs.wo));
+              value +=
+                trace(scene, accel, state, 1, pixel_sampler, nullptr, false);
+            }
+          }
+        }
+        if (std::isfinite(value.x + value.y + value.z))
+          block.put(primary.film_pos, value);
+      },
+      [&](ImageBlock& block) { film.put(block); });
+
+    std::swap(buffers.history, buffers.reused);
+    std::swap(buffers.previous, buffers.primary);
+    progress.update(static_cast<float>(frame + 1) /
+                    static_cast<float>(settings_.spp));
+  }
+  Log(Info, "Rendering finished in {:.2f} s", timer.seconds<float>());
+}
+} // namespace eldr
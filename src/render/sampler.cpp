@@ -0,0 +1,76 @@
+#include <eldr/core/sobol.hpp>
+#include <eldr/render/sampler.hpp>
+
+namespace eldr {
+// -----------------------------------------------------------------------------
+// IndependentSampler
+// -----------------------------------------------------------------------------
+std::unique_ptr<Sampler> IndependentSampler::clone() const
+{
+  return std::make_unique<IndependentSampler>(*this);
+}
+
+void IndependentSampler::startPixelSample(const Vec2u& pixel,
+                                          uint32_t     sample_index)
+{
+  Sampler::startPixelSample(pixel, sample_index);
+  setDimension(0);
+}
+
+void IndependentSampler::setDimension(uint32_t dim)
+{
+  Sampler::setDimension(dim);
+  rng_.seed(pixel_seed_);
+  // Leave room for 2^16 dimensions per sample, far more than a path uses
+  rng_.advance((static_cast<int64_t>(sample_index_) << 16) + dim);
+}
+
+Float IndependentSampler::next1D()
+{
+  ++dimension_;
+  return rng_.nextFloat();
+}
+
+IndependentSampler::Point2f IndependentSampler::next2D()
+{
+  dimension_ += 2;
+  const Float x{ rng_.nextFloat() };
+  return { x, rng_.nextFloat() };
+}
+
+// -----------------------------------------------------------------------------
+// SobolSampler
+// -----------------------------------------------------------------------------
+std::unique_ptr<Sampler> SobolSampler::clone() const
+{
+  return std::make_unique<SobolSampler>(*this);
+}
+
+uint32_t SobolSampler::sampleDimension(uint32_t dim) const
+{
+  // Past the tables, the matrices are reused in rounds. Shuffling the points
+  // once per round keeps the dimensions of a round a proper Sobol point set
+  // while decorrelating it from the previous rounds.
+  const uint32_t round{ dim / sobol::dimension_count };
+  uint32_t       index{ sample_index_ };
+  if (round > 0)
+    index = sobol::owenScramble(
+      index, static_cast<uint32_t>(mix64(pixel_seed_ ^ round) >> 32));
+  return sobol::owenScramble(
+    sobol::sample(index, dim % sobol::dimension_count),
+    static_cast<uint32_t>(mix64(pixel_seed_ + dim)));
+}
+
+Float SobolSampler::next1D()
+{
+  return sobol::toFloat(sampleDimension(dimension_++));
+}
+
+SobolSampler::Point2f SobolSampler::next2D()
+{
+  const Float x{ sobol::toFloat(sampleDimension(dimension_)) };
+  const Float y{ sobol::toFloat(sampleDimension(dimension_ + 1)) };
+  dimension_ += 2;
+  return { x, y };
+}
+} // namespace eldr
@@ -1,4 +1,7 @@
 #include <eldr/core/math.hpp>
+#include <eldr/render/bsdf.hpp>
+#include <eldr/render/emitter.hpp>
+#include <eldr/render/lightbvh.hpp>
 #include <eldr/render/mesh.hpp>
 #include <eldr/render/scene.hpp>
 #include <eldr/vulkan/descriptorallocator.hpp> // SceneData
@@ -11,6 +14,8 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
+#include <algorithm>
+
 // Ignore warnings from fastgltf
 #ifdef __GNUG__
 #  pragma GCC diagnostic push
@@ -128,7 +133,9 @@ void Scene::draw(const Mat4f& top_matrix, DrawContext& ctx) const
 }
 
 std::optional<std::shared_ptr<Scene>>
-Scene::loadGltf(const vk::VulkanEngine& engine, std::filesystem::path file_path)
+Scene::loadGltf(const vk::VulkanEngine* engine,
+                std::filesystem::path   file_path,
+                bool                    optimize_mesh_layout)
 {
   namespace fg = fastgltf;
   Log(Trace, "Loading glTF: {}", file_path.c_str());
@@ -169,7 +176,7 @@ Scene::loadGltf(const vk::VulkanEngine& engine, std::filesystem::path file_path)
     auto load =
       parser.loadGltfBinary(data.get(), file_path.parent_path(), gltf_options);
     const fg::Error error{ load.error() };
-    if (error != fg::Error::None) {
+    if (error == fg::Error::None) {
       gltf = std::move(load.get());
     }
     else {
@@ -185,37 +192,43 @@ Scene::loadGltf(const vk::VulkanEngine& engine, std::filesystem::path file_path)
     return std::nullopt;
   }
 
-  auto scene           = std::make_shared<Scene>();
-  scene->vk_scene_data = std::make_shared<vk::SceneData>();
-  // Just an estimate of what will be needed
-  const std::vector<vk::PoolSizeRatio> sizes{
-    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3 },
-    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3 },
-    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 }
-  };
-  scene->vk_scene_data->descriptors =
-    vk::DescriptorAllocator{ static_cast<uint32_t>(gltf.materials.size()),
-                             sizes };
-
-  scene->vk_scene_data->material_buffer = {
-    engine.device(),
-    "Material buffer",
-    gltf.materials.size(),
-    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-    // VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-  };
+  auto scene = std::make_shared<Scene>();
+  if (engine) {
+    scene->vk_scene_data = std::make_shared<vk::SceneData>();
+    // Just an estimate of what will be needed
+    const std::vector<vk::PoolSizeRatio> sizes{
+      { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3 },
+      { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3 },
+      { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 }
+    };
+    scene->vk_scene_data->descriptors =
+      vk::DescriptorAllocator{ static_cast<uint32_t>(gltf.materials.size()),
+                               sizes };
+
+    scene->vk_scene_data->material_buffer = {
+      engine->device(),
+      "Material buffer",
+      gltf.materials.size(),
+      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      // VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+    };
 
-  //----------------------------------------------------------------------------
-  // Load Samplers
-  //----------------------------------------------------------------------------
-  for (fg::Sampler& sampler : gltf.samplers) {
-    VkFilter            min_filter{ extractFilter(
-      sampler.minFilter.value_or(fg::Filter::Nearest)) };
-    VkFilter            mag_filter{ extractFilter(
-      sampler.magFilter.value_or(fg::Filter::Nearest)) };
-    VkSamplerMipmapMode mipmap_mode{ extractMipmapMode(fg::Filter::Nearest) };
-    scene->vk_scene_data->samplers.emplace_back(
-      engine.device(), min_filter, mag_filter, mipmap_mode, VK_LOD_CLAMP_NONE);
+    //--------------------------------------------------------------------------
+    // Load Samplers
+    //--------------------------------------------------------------------------
+    for (fg::Sampler& sampler : gltf.samplers) {
+      VkFilter            min_filter{ extractFilter(
+        sampler.minFilter.value_or(fg::Filter::Nearest)) };
+      VkFilter            mag_filter{ extractFilter(
+        sampler.magFilter.value_or(fg::Filter::Nearest)) };
+      VkSamplerMipmapMode mipmap_mode{ extractMipmapMode(
+        fg::Filter::Nearest) };
+      scene->vk_scene_data->samplers.emplace_back(engine->device(),
+                                                  min_filter,
+                                                  mag_filter,
+                                                  mipmap_mode,
+                                                  VK_LOD_CLAMP_NONE);
+    }
   }
 
   int data_index{ 0 };
@@ -237,7 +250,20 @@ Scene::loadGltf(const vk::VulkanEngine& engine, std::filesystem::path file_path)
   // Load materials
   //----------------------------------------------------------------------------
   std::vector<std::shared_ptr<Material>> materials;
+  std::vector<std::shared_ptr<BSDF>>     bsdfs;
+  std::vector<Color3f>                   emissions;
   for (fg::Material& mat : gltf.materials) {
+    // CPU renderer side of the material. Textures aren't supported there yet,
+    // so only the constant factors are used.
+    bsdfs.push_back(std::make_shared<BSDF>(
+      Color3f{ mat.pbrData.baseColorFactor[0],
+               mat.pbrData.baseColorFactor[1],
+               mat.pbrData.baseColorFactor[2] }));
+    emissions.push_back(Color3f{ mat.emissiveFactor[0],
+                                 mat.emissiveFactor[1],
+                                 mat.emissiveFactor[2] } *
+                        static_cast<Float>(mat.emissiveStrength));
+
     GltfMetallicRoughness::MaterialConstants constants;
     constants.color_factors.x = mat.pbrData.baseColorFactor[0];
     constants.color_factors.y = mat.pbrData.baseColorFactor[1];
@@ -255,30 +281,6 @@ Scene::loadGltf(const vk::VulkanEngine& engine, std::filesystem::path file_path)
       pass_type = MaterialPass::Transparent;
     }
 
-    GltfMetallicRoughness::MaterialResources material_resources{
-      // default the material textures
-      .color_texture       = &engine.whiteImage(),
-      .color_sampler       = &engine.defaultSamplerLinear(),
-      .metal_rough_texture = &engine.whiteImage(),
-      .metal_rough_sampler = &engine.defaultSamplerLinear(),
-
-      // set the uniform buffer for the material data
-      .data_buffer = &scene->vk_scene_data->material_buffer,
-      .data_index  = static_cast<size_t>(data_index),
-    };
-    // grab textures from gltf file
-    if (mat.pbrData.baseColorTexture.has_value()) {
-      size_t img =
-        gltf.textures[mat.pbrData.baseColorTexture.value().textureIndex]
-          .imageIndex.value();
-      size_t sampler =
-        gltf.textures[mat.pbrData.baseColorTexture.value().textureIndex]
-          .samplerIndex.value();
-
-      //    material_resources.color_texture = &images[img];
-      material_resources.color_sampler =
-        &scene->vk_scene_data->samplers[sampler];
-    }
     // build material
     auto material = std::make_shared<Material>();
     materials.push_back(material);
@@ -287,11 +289,38 @@ Scene::loadGltf(const vk::VulkanEngine& engine, std::filesystem::path file_path)
     if (unlikely(not res.second)) {
       Log(Warn, "Scene contains duplicate material name ({}).", mat.name);
     }
-    material->data = engine.metalRoughMaterial().writeMaterial(
-      engine.device(),
-      pass_type,
-      material_resources,
-      scene->vk_scene_data->descriptors);
+
+    if (engine) {
+      GltfMetallicRoughness::MaterialResources material_resources{
+        // default the material textures
+        .color_texture       = &engine->whiteImage(),
+        .color_sampler       = &engine->defaultSamplerLinear(),
+        .metal_rough_texture = &engine->whiteImage(),
+        .metal_rough_sampler = &engine->defaultSamplerLinear(),
+
+        // set the uniform buffer for the material data
+        .data_buffer = &scene->vk_scene_data->material_buffer,
+        .data_index  = static_cast<size_t>(data_index),
+      };
+      // grab textures from gltf file
+      if (mat.pbrData.baseColorTexture.has_value()) {
+        size_t img =
+          gltf.textures[mat.pbrData.baseColorTexture.value().textureIndex]
+            .imageIndex.value();
+        size_t sampler =
+          gltf.textures[mat.pbrData.baseColorTexture.value().textureIndex]
+            .samplerIndex.value();
+
+        //    material_resources.color_texture = &images[img];
+        material_resources.color_sampler =
+          &scene->vk_scene_data->samplers[sampler];
+      }
+      material->data = engine->metalRoughMaterial().writeMaterial(
+        engine->device(),
+        pass_type,
+        material_resources,
+        scene->vk_scene_data->descriptors);
+    }
 
     data_index++;
   }
@@ -299,15 +328,15 @@ Scene::loadGltf(const vk::VulkanEngine& engine, std::filesystem::path file_path)
     Log(Error, "glTF file contains no materials, at least one is required");
     return std::nullopt;
   }
-  scene->vk_scene_data->material_buffer.uploadData(scene_material_constants);
+  if (engine)
+    scene->vk_scene_data->material_buffer.uploadData(scene_material_constants);
 
   //----------------------------------------------------------------------------
   // Load meshes
   //----------------------------------------------------------------------------
   std::vector<std::shared_ptr<Mesh>> meshes;
   for (fg::Mesh& mesh : gltf.meshes) {
-    std::vector<uint32_t> indices; // currently not giving this to the mesh,
-                                   // TODO: might be needed
+    std::vector<uint32_t>   indices;
     std::vector<Point3f>    vertices;
     std::vector<Point2f>    texcoords;
     std::vector<Color4f>    colors;
@@ -381,13 +410,16 @@ Scene::loadGltf(const vk::VulkanEngine& engine, std::filesystem::path file_path)
           [&](Color4f c, size_t index) { colors[initial_vtx + index] = c; });
       }
 
+      size_t material_index{ 0 };
       if (p.materialIndex.has_value()) {
-        surface.material = materials[p.materialIndex.value()];
+        material_index = p.materialIndex.value();
       }
       else {
         Log(Warn, "Missing primitive material index, using index 0 instead.");
-        surface.material = materials[0];
       }
+      surface.material = materials[material_index];
+      surface.bsdf     = bsdfs[material_index];
+      surface.emission = emissions[material_index];
       surfaces.push_back(surface);
     }
 
@@ -403,7 +435,10 @@ Scene::loadGltf(const vk::VulkanEngine& engine, std::filesystem::path file_path)
                                           std::move(texcoords),
                                           std::move(colors),
                                           std::move(normals),
+                                          std::move(indices),
                                           std::move(surfaces));
+    if (optimize_mesh_layout)
+      newmesh->optimizeLayout();
     meshes.emplace_back(newmesh);
     const auto res =
       scene->meshes.insert(std::make_pair(mesh.name, std::move(newmesh)));
@@ -434,7 +469,7 @@ Scene::loadGltf(const vk::VulkanEngine& engine, std::filesystem::path file_path)
 
     std::visit(fg::visitor{ [&](fg::math::fmat4x4 matrix) {
                              for (size_t i = 0; i < matrix.rows(); ++i) {
-                               for (size_t j = 0; i < matrix.columns(); ++j) {
+                               for (size_t j = 0; j < matrix.columns(); ++j) {
                                  scene_node->local_transform[i][j] =
                                    matrix[i][j];
                                }
@@ -479,11 +514,31 @@ Scene::loadGltf(const vk::VulkanEngine& engine, std::filesystem::path file_path)
       node->refreshTransform(Mat4f{ 1.f });
     }
   }
+
+  //----------------------------------------------------------------------------
+  // Create area emitters, now that the world transforms are known
+  //----------------------------------------------------------------------------
+  for (auto& node : nodes) {
+    auto* mesh_node{ dynamic_cast<MeshNode*>(node.get()) };
+    if (not mesh_node)
+      continue;
+    const auto& surfaces{ mesh_node->mesh->surfaces() };
+    for (uint32_t i = 0; i < surfaces.size(); ++i) {
+      if (surfaces[i].emission == Color3f{ 0.f })
+        continue;
+      mesh_node->emitters.resize(surfaces.size());
+      mesh_node->emitters[i] =
+        std::make_shared<AreaEmitter>(*mesh_node, i, surfaces[i].emission);
+      scene->emitters.push_back(mesh_node->emitters[i]);
+    }
+  }
+  scene->buildLightBVH();
   Log(Trace,
-      "Loaded {} meshes, {} materials and {} nodes",
+      "Loaded {} meshes, {} materials, {} nodes and {} emitters",
       scene->meshes.size(),
       scene->materials.size(),
-      scene->nodes.size());
+      scene->nodes.size(),
+      scene->emitters.size());
   return scene;
 }
 
@@ -552,7 +607,7 @@ Scene::loadGltf(const vk::VulkanEngine& engine, std::filesystem::path file_path)
 // }
 
 std::optional<std::shared_ptr<Scene>>
-Scene::load(const vk::VulkanEngine& engine, const SceneInfo& scene_info)
+Scene::load(const vk::VulkanEngine* engine, const SceneInfo& scene_info)
 {
   const char* env_p = std::getenv("ELDR_DIR");
   if (env_p == nullptr) {
@@ -567,9 +622,51 @@ Scene::load(const vk::VulkanEngine& engine, const SceneInfo& scene_info)
   }
 
   // TODO: determine file type obj/gltf if obj is to be supported too
-  auto scene = Scene::loadGltf(engine, filepath);
+  auto scene =
+    Scene::loadGltf(engine, filepath, scene_info.optimize_mesh_layout);
 
   return scene;
 }
 
+void Scene::setEnvironment(std::shared_ptr<Emitter> emitter)
+{
+  if (environment)
+    std::erase(emitters, environment);
+  environment = std::move(emitter);
+  if (environment)
+    emitters.push_back(environment);
+  buildLightBVH();
+}
+
+void Scene::setTransform(const Mat4f& transform)
+{
+  for (auto& node : top_nodes)
+    node->refreshTransform(transform);
+
+  // Area emitters store their triangles in world space, so replace them at the
+  // same position in `emitters`
+  for (auto& node : top_nodes) {
+    node->map([&](SceneNode* child) {
+      auto* mesh_node{ dynamic_cast<MeshNode*>(child) };
+      if (not mesh_node)
+        return;
+      const auto& surfaces{ mesh_node->mesh->surfaces() };
+      for (uint32_t i = 0; i < mesh_node->emitters.size(); ++i) {
+        auto& emitter{ mesh_node->emitters[i] };
+        if (not emitter)
+          continue;
+        auto moved{ std::make_shared<AreaEmitter>(
+          *mesh_node, i, surfaces[i].emission) };
+        std::ranges::replace(emitters, emitter, moved);
+        emitter = std::move(moved);
+      }
+    });
+  }
+  buildLightBVH();
+}
+
+void Scene::buildLightBVH()
+{
+  light_bvh = std::make_shared<const LightBVH>(emitters);
+}
 } // namespace eldr
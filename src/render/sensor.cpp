@@ -0,0 +1,40 @@
+#include <eldr/core/logger.hpp>
+#include <eldr/render/sensor.hpp>
+
+#include <cmath>
+
+namespace eldr {
+PerspectiveCamera::PerspectiveCamera(const Mat4f& to_world,
+                                     const Float  fov_y,
+                                     const Vec2u& film_size)
+  : to_world_(to_world), film_size_(film_size)
+{
+  Assert(film_size.x > 0 and film_size.y > 0, "empty film");
+  const Float half_height{ std::tan(glm::radians(0.5f * fov_y)) };
+  const Float half_width{ half_height * static_cast<Float>(film_size.x) /
+                          static_cast<Float>(film_size.y) };
+
+  const Vec3f right{ to_world * Vec4f{ 1.f, 0.f, 0.f, 0.f } };
+  const Vec3f up{ to_world * Vec4f{ 0.f, 1.f, 0.f, 0.f } };
+  const Vec3f forward{ to_world * Vec4f{ 0.f, 0.f, -1.f, 0.f } };
+  origin_     = Point3f{ to_world * Vec4f{ 0.f, 0.f, 0.f, 1.f } };
+  corner_dir_ = forward - half_width * right + half_height * up;
+  dx_         = right * (2.f * half_width / static_cast<Float>(film_size.x));
+  dy_         = -up * (2.f * half_height / static_cast<Float>(film_size.y));
+}
+
+PerspectiveCamera PerspectiveCamera::lookAt(const Point3f& origin,
+                                            const Point3f& target,
+                                            const Vec3f&   up,
+                                            const Float    fov_y,
+                                            const Vec2u&   film_size)
+{
+  return { glm::inverse(glm::lookAt(origin, target, up)), fov_y, film_size };
+}
+
+Ray3f PerspectiveCamera::sampleRay(const Point2f& film_pos) const
+{
+  const Vec3f d{ corner_dir_ + film_pos.x * dx_ + film_pos.y * dy_ };
+  return { origin_, glm::normalize(d) };
+}
+} // namespace eldr
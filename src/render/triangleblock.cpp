@@ -0,0 +1,288 @@
+#include <eldr/render/triangleblock.hpp>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  define ELDR_X86 1
+#  include <immintrin.h>
+#endif
+
+namespace eldr {
+namespace {
+// -----------------------------------------------------------------------------
+// Triangle kernels
+// -----------------------------------------------------------------------------
+template <uint32_t Width>
+using IntersectFn = uint32_t (*)(const TriangleBlock<Width>& block,
+                                 const Ray3f&                ray,
+                                 Float                       maxt,
+                                 Float*                      t,
+                                 Float*                      u,
+                                 Float*                      v);
+
+template <uint32_t Width>
+uint32_t intersectTrianglesScalar(const TriangleBlock<Width>& block,
+                                  const Ray3f&                ray,
+                                  Float                       maxt,
+                                  Float*                      t,
+                                  Float*                      u,
+                                  Float*                      v)
+{
+  uint32_t mask{ 0 };
+  for (uint32_t i = 0; i < Width; ++i) {
+    const float e1x{ block.e1[0][i] }, e1y{ block.e1[1][i] },
+      e1z{ block.e1[2][i] };
+    const float e2x{ block.e2[0][i] }, e2y{ block.e2[1][i] },
+      e2z{ block.e2[2][i] };
+
+    const float px{ ray.d.y * e2z - ray.d.z * e2y };
+    const float py{ ray.d.z * e2x - ray.d.x * e2z };
+    const float pz{ ray.d.x * e2y - ray.d.y * e2x };
+    const float det{ e1x * px + e1y * py + e1z * pz };
+    if (det == 0.f)
+      continue;
+    const float inv_det{ 1.f / det };
+
+    const float tx{ ray.o.x - block.p0[0][i] };
+    const float ty{ ray.o.y - block.p0[1][i] };
+    const float tz{ ray.o.z - block.p0[2][i] };
+    u[i] = (tx * px + ty * py + tz * pz) * inv_det;
+
+    const float qx{ ty * e1z - tz * e1y };
+    const float qy{ tz * e1x - tx * e1z };
+    const float qz{ tx * e1y - ty * e1x };
+    v[i] = (ray.d.x * qx + ray.d.y * qy + ray.d.z * qz) * inv_det;
+    t[i] = (e2x * qx + e2y * qy + e2z * qz) * inv_det;
+
+    const bool hit{ u[i] >= 0.f and v[i] >= 0.f and u[i] + v[i] <= 1.f and
+                    t[i] > 0.f and t[i] < maxt };
+    mask |= static_cast<uint32_t>(hit) << i;
+  }
+  return mask;
+}
+
+#ifdef ELDR_X86
+/// @brief Intersect four triangles starting at slot `first` of the block. SSE
+/// is part of x86-64, so this kernel needs no runtime check.
+template <uint32_t Width>
+uint32_t intersectTrianglesSSE(const TriangleBlock<Width>& block,
+                               uint32_t                    first,
+                               const Ray3f&                ray,
+                               Float                       maxt,
+                               Float*                      t,
+                               Float*                      u,
+                               Float*                      v)
+{
+  const __m128 dx{ _mm_set1_ps(ray.d.x) };
+  const __m128 dy{ _mm_set1_ps(ray.d.y) };
+  const __m128 dz{ _mm_set1_ps(ray.d.z) };
+  const __m128 e1x{ _mm_load_ps(block.e1[0] + first) };
+  const __m128 e1y{ _mm_load_ps(block.e1[1] + first) };
+  const __m128 e1z{ _mm_load_ps(block.e1[2] + first) };
+  const __m128 e2x{ _mm_load_ps(block.e2[0] + first) };
+  const __m128 e2y{ _mm_load_ps(block.e2[1] + first) };
+  const __m128 e2z{ _mm_load_ps(block.e2[2] + first) };
+
+  // pvec = d x e2
+  const __m128 px{ _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y)) };
+  const __m128 py{ _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z)) };
+  const __m128 pz{ _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x)) };
+  const __m128 det{ _mm_add_ps(
+    _mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz)) };
+  const __m128 inv_det{ _mm_div_ps(_mm_set1_ps(1.f), det) };
+
+  // tvec = o - p0
+  const __m128 tx{ _mm_sub_ps(_mm_set1_ps(ray.o.x),
+                              _mm_load_ps(block.p0[0] + first)) };
+  const __m128 ty{ _mm_sub_ps(_mm_set1_ps(ray.o.y),
+                              _mm_load_ps(block.p0[1] + first)) };
+  const __m128 tz{ _mm_sub_ps(_mm_set1_ps(ray.o.z),
+                              _mm_load_ps(block.p0[2] + first)) };
+  const __m128 u4{ _mm_mul_ps(
+    _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)),
+               _mm_mul_ps(tz, pz)),
+    inv_det) };
+
+  // qvec = tvec x e1
+  const __m128 qx{ _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y)) };
+  const __m128 qy{ _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z)) };
+  const __m128 qz{ _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x)) };
+  const __m128 v4{ _mm_mul_ps(
+    _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)),
+               _mm_mul_ps(dz, qz)),
+    inv_det) };
+  const __m128 t4{ _mm_mul_ps(
+    _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)),
+               _mm_mul_ps(e2z, qz)),
+    inv_det) };
+
+  const __m128 zero{ _mm_setzero_ps() };
+  __m128       hit{ _mm_cmpneq_ps(det, zero) };
+  hit = _mm_and_ps(hit, _mm_cmpge_ps(u4, zero));
+  hit = _mm_and_ps(hit, _mm_cmpge_ps(v4, zero));
+  hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u4, v4), _mm_set1_ps(1.f)));
+  hit = _mm_and_ps(hit, _mm_cmpgt_ps(t4, zero));
+  hit = _mm_and_ps(hit, _mm_cmplt_ps(t4, _mm_set1_ps(maxt)));
+  _mm_storeu_ps(t + first, t4);
+  _mm_storeu_ps(u + first, u4);
+  _mm_storeu_ps(v + first, v4);
+  return static_cast<uint32_t>(_mm_movemask_ps(hit)) << first;
+}
+
+uint32_t intersectTrianglesSSE4(const TriangleBlock<4>& block,
+                                const Ray3f&            ray,
+                                Float                   maxt,
+                                Float*                  t,
+                                Float*                  u,
+                                Float*                  v)
+{
+  return intersectTrianglesSSE(block, 0, ray, maxt, t, u, v);
+}
+
+/// 8-wide blocks on CPUs without AVX2 are processed as two 4-wide halves
+uint32_t intersectTrianglesSSE8(const TriangleBlock<8>& block,
+                                const Ray3f&            ray,
+                                Float                   maxt,
+                                Float*                  t,
+                                Float*                  u,
+                                Float*                  v)
+{
+  return intersectTrianglesSSE(block, 0, ray, maxt, t, u, v) |
+         intersectTrianglesSSE(block, 4, ray, maxt, t, u, v);
+}
+
+/// Same operations as the SSE kernel, without FMA, so that both produce the
+/// same hits
+__attribute__((target("avx2"))) uint32_t
+intersectTrianglesAVX2(const TriangleBlock<8>& block,
+                       const Ray3f&            ray,
+                       Float                   maxt,
+                       Float*                  t,
+                       Float*                  u,
+                       Float*                  v)
+{
+  const __m256 dx{ _mm256_set1_ps(ray.d.x) };
+  const __m256 dy{ _mm256_set1_ps(ray.d.y) };
+  const __m256 dz{ _mm256_set1_ps(ray.d.z) };
+  const __m256 e1x{ _mm256_load_ps(block.e1[0]) };
+  const __m256 e1y{ _mm256_load_ps(block.e1[1]) };
+  const __m256 e1z{ _mm256_load_ps(block.e1[2]) };
+  const __m256 e2x{ _mm256_load_ps(block.e2[0]) };
+  const __m256 e2y{ _mm256_load_ps(block.e2[1]) };
+  const __m256 e2z{ _mm256_load_ps(block.e2[2]) };
+
+  const __m256 px{ _mm256_sub_ps(_mm256_mul_ps(dy, e2z),
+                                 _mm256_mul_ps(dz, e2y)) };
+  const __m256 py{ _mm256_sub_ps(_mm256_mul_ps(dz, e2x),
+                                 _mm256_mul_ps(dx, e2z)) };
+  const __m256 pz{ _mm256_sub_ps(_mm256_mul_ps(dx, e2y),
+                                 _mm256_mul_ps(dy, e2x)) };
+  const __m256 det{ _mm256_add_ps(
+    _mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)),
+    _mm256_mul_ps(e1z, pz)) };
+  const __m256 inv_det{ _mm256_div_ps(_mm256_set1_ps(1.f), det) };
+
+  const __m256 tx{ _mm256_sub_ps(_mm256_set1_ps(ray.o.x),
+                                 _mm256_load_ps(block.p0[0])) };
+  const __m256 ty{ _mm256_sub_ps(_mm256_set1_ps(ray.o.y),
+                                 _mm256_load_ps(block.p0[1])) };
+  const __m256 tz{ _mm256_sub_ps(_mm256_set1_ps(ray.o.z),
+                                 _mm256_load_ps(block.p0[2])) };
+  const __m256 u8{ _mm256_mul_ps(
+    _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, px), _mm256_mul_ps(ty, py)),
+                  _mm256_mul_ps(tz, pz)),
+    inv_det) };
+
+  const __m256 qx{ _mm256_sub_ps(_mm256_mul_ps(ty, e1z),
+                                 _mm256_mul_ps(tz, e1y)) };
+  const __m256 qy{ _mm256_sub_ps(_mm256_mul_ps(tz, e1x),
+                                 _mm256_mul_ps(tx, e1z)) };
+  const __m256 qz{ _mm256_sub_ps(_mm256_mul_ps(tx, e1y),
+                                 _mm256_mul_ps(ty, e1x)) };
+  const __m256 v8{ _mm256_mul_ps(
+    _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)),
+                  _mm256_mul_ps(dz, qz)),
+    inv_det) };
+  const __m256 t8{ _mm256_mul_ps(
+    _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx),
+                                _mm256_mul_ps(e2y, qy)),
+                  _mm256_mul_ps(e2z, qz)),
+    inv_det) };
+
+  const __m256 zero{ _mm256_setzero_ps() };
+  __m256       hit{ _mm256_cmp_ps(det, zero, _CMP_NEQ_UQ) };
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(u8, zero, _CMP_GE_OQ));
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(v8, zero, _CMP_GE_OQ));
+  hit = _mm256_and_ps(hit,
+                      _mm256_cmp_ps(_mm256_add_ps(u8, v8),
+                                    _mm256_set1_ps(1.f),
+                                    _CMP_LE_OQ));
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(t8, zero, _CMP_GT_OQ));
+  hit = _mm256_and_ps(hit,
+                      _mm256_cmp_ps(t8, _mm256_set1_ps(maxt), _CMP_LT_OQ));
+  _mm256_storeu_ps(t, t8);
+  _mm256_storeu_ps(u, u8);
+  _mm256_storeu_ps(v, v8);
+  return static_cast<uint32_t>(_mm256_movemask_ps(hit));
+}
+#endif // ELDR_X86
+
+enum class Kernel { Scalar, SSE, AVX2 };
+
+Kernel detectKernel(uint32_t width)
+{
+#ifdef ELDR_X86
+  if (width == 8) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      return Kernel::AVX2;
+  }
+  return Kernel::SSE;
+#else
+  (void) width;
+  return Kernel::Scalar;
+#endif
+}
+
+template <uint32_t Width> IntersectFn<Width> selectKernel()
+{
+  switch (detectKernel(Width)) {
+#ifdef ELDR_X86
+    case Kernel::AVX2:
+      if constexpr (Width == 8)
+        return intersectTrianglesAVX2;
+      break;
+    case Kernel::SSE:
+      if constexpr (Width == 4)
+        return intersectTrianglesSSE4;
+      else
+        return intersectTrianglesSSE8;
+#endif
+    default:
+      break;
+  }
+  return intersectTrianglesScalar<Width>;
+}
+} // namespace
+
+template <uint32_t Width>
+uint32_t TriangleBlock<Width>::intersect(
+  const Ray3f& ray, Float maxt, Float* t, Float* u, Float* v) const
+{
+  static const IntersectFn<Width> kernel{ selectKernel<Width>() };
+  return kernel(*this, ray, maxt, t, u, v);
+}
+
+template <uint32_t Width> const char* TriangleBlock<Width>::kernelName()
+{
+  switch (detectKernel(Width)) {
+    case Kernel::AVX2:
+      return "AVX2";
+    case Kernel::SSE:
+      return Width == 8 ? "SSE (2x4)" : "SSE";
+    default:
+      return "scalar";
+  }
+}
+
+template struct TriangleBlock<4>;
+template struct TriangleBlock<8>;
+} // namespace eldr
@@ -0,0 +1,282 @@
+#include <eldr/core/bbox.hpp>
+#include <eldr/core/logger.hpp>
+#include <eldr/core/math.hpp>
+#include <eldr/render/accel.hpp>
+#include <eldr/render/imageblock.hpp>
+#include <eldr/render/integrator.hpp>
+#include <eldr/render/mesh.hpp>
+#include <eldr/render/packet.hpp>
+#include <eldr/render/sampler.hpp>
+#include <eldr/render/sensor.hpp>
+#include <eldr/render/wavefront.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <span>
+
+using namespace eldr::core;
+
+namespace eldr {
+namespace {
+/// Resolution of the grid ray origins are sorted by, per axis
+constexpr uint32_t origin_grid_size{ 1u << 9 };
+
+/// @brief Sort the rays of `queues.rays` by direction octant first and the
+/// grid cell of their origin second. Rays that start close together and point
+/// the same way visit largely the same BVH nodes, so tracing them one after
+/// another keeps those nodes in cache.
+void sortRays(WavefrontQueues& queues, const BoundingBox3f& bounds)
+{
+  using Vec3f = CoreAliases<Float>::Vec3f;
+
+  RayQueue&    rays{ queues.rays };
+  const size_t count{ rays.size() };
+  const Vec3f  extents{ glm::max(bounds.extents(), Vec3f{ 1e-6f }) };
+  const Vec3f  scale{ static_cast<Float>(origin_grid_size) / extents };
+  auto         cell = [&](Float v, uint32_t axis) {
+    const Float c{ (v - bounds.min[axis]) * scale[axis] };
+    return static_cast<uint32_t>(
+      std::clamp(c, 0.f, static_cast<Float>(origin_grid_size - 1)));
+  };
+
+  queues.keys.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    const uint32_t octant{ (rays.dx[i] < 0.f ? 1u : 0u) |
+                           (rays.dy[i] < 0.f ? 2u : 0u) |
+                           (rays.dz[i] < 0.f ? 4u : 0u) };
+    const uint32_t morton{ mortonEncode3(cell(rays.ox[i], 0),
+                                         cell(rays.oy[i], 1),
+                                         cell(rays.oz[i], 2)) };
+    const uint64_t key{ (static_cast<uint64_t>(octant) << 27) | morton };
+    queues.keys[i] = (key << 32) | i;
+  }
+  std::sort(queues.keys.begin(), queues.keys.end());
+
+  RayQueue& sorted{ queues.next_rays };
+  sorted.clear();
+  for (const uint64_t key : queues.keys)
+    sorted.push(rays.path[key & 0xffffffff], rays.ray(key & 0xffffffff));
+  std::swap(rays, sorted);
+}
+
+/// @brief Intersect consecutive rays of the queue as packets. Camera rays of
+/// the same tile are sorted next to each other, so a packet spans a small
+/// cone and culls most nodes for all its rays at once.
+template <uint32_t Size>
+void intersectPackets(const SceneAccel& accel, WavefrontQueues& queues)
+{
+  const RayQueue& rays{ queues.rays };
+  for (size_t first = 0; first < rays.size(); first += Size) {
+    const auto      count{ static_cast<uint32_t>(
+      std::min<size_t>(Size, rays.size() - first)) };
+    RayPacket<Size> packet;
+    for (uint32_t i = 0; i < count; ++i)
+      packet.set(i, rays.ray(first + i));
+    std::array<PreliminaryIntersection, Size> pi;
+    accel.rayIntersect(packet, std::span{ pi });
+    std::copy_n(pi.begin(), count, queues.hits.begin() + first);
+  }
+}
+} // namespace
+
+Float PathIntegrator::renderTileWavefront(const Scene&             scene,
+                                          const SceneAccel&        accel,
+                                          const PerspectiveCamera& camera,
+                                          const Tile&              tile,
+                                          uint32_t                 sample_offset,
+                                          uint32_t                 sample_count,
+                                          Sampler&                 sampler,
+                                          ImageBlock&              block,
+                                          PixelStatistics*         statistics,
+                                          WavefrontQueues& queues) const
+{
+  block.setOffset(tile.offset);
+  block.setSize(tile.size);
+  block.clear();
+
+  const uint32_t tile_pixels{ tile.size.x * tile.size.y };
+  // Split the samples of the tile into batches that fit the wavefront
+  const uint32_t batch_spp{ std::clamp(
+    settings_.wavefront_size / tile_pixels, 1u, sample_count) };
+  const BoundingBox3f bounds{ accel.instances().empty()
+                                ? BoundingBox3f{ Point3f{ 0.f } }
+                                : accel.tlas().bbox() };
+
+  auto load_state = [&](uint32_t path, const Ray3f& ray) {
+    PathState state;
+    state.ray           = ray;
+    state.throughput    = { queues.throughput_r[path],
+                            queues.throughput_g[path],
+                            queues.throughput_b[path] };
+    state.result        = { queues.result_r[path],
+                            queues.result_g[path],
+                            queues.result_b[path] };
+    state.prev_p        = { queues.prev_px[path],
+                            queues.prev_py[path],
+                            queues.prev_pz[path] };
+    state.prev_n        = { queues.prev_nx[path],
+                            queues.prev_ny[path],
+                            queues.prev_nz[path] };
+    state.prev_bsdf_pdf = queues.prev_bsdf_pdf[path];
+    return state;
+  };
+  auto store_state = [&](uint32_t path, const PathState& state) {
+    queues.throughput_r[path]  = state.throughput.x;
+    queues.throughput_g[path]  = state.throughput.y;
+    queues.throughput_b[path]  = state.throughput.z;
+    queues.result_r[path]      = state.result.x;
+    queues.result_g[path]      = state.result.y;
+    queues.result_b[path]      = state.result.z;
+    queues.prev_px[path]       = state.prev_p.x;
+    queues.prev_py[path]       = state.prev_p.y;
+    queues.prev_pz[path]       = state.prev_p.z;
+    queues.prev_nx[path]       = state.prev_n.x;
+    queues.prev_ny[path]       = state.prev_n.y;
+    queues.prev_nz[path]       = state.prev_n.z;
+    queues.prev_bsdf_pdf[path] = state.prev_bsdf_pdf;
+  };
+
+  Float max_error{ 0.f };
+  for (uint32_t batch_offset = 0; batch_offset < sample_count;
+       batch_offset += batch_spp) {
+    const uint32_t batch_count{ std::min(batch_spp,
+                                         sample_count - batch_offset) };
+    queues.resizePaths(static_cast<size_t>(tile_pixels) * batch_count);
+    queues.rays.clear();
+
+    //--------------------------------------------------------------------------
+    // Generate camera rays, the samples of a pixel are consecutive paths
+    //--------------------------------------------------------------------------
+    uint32_t path{ 0 };
+    for (uint32_t y = tile.offset.y; y < tile.offset.y + tile.size.y; ++y) {
+      for (uint32_t x = tile.offset.x; x < tile.offset.x + tile.size.x; ++x) {
+        for (uint32_t s = 0; s < batch_count; ++s, ++path) {
+          const uint32_t index{ sample_offset + batch_offset + s };
+          sampler.startPixelSample({ x, y }, index);
+          const Point2f film_pos{ Point2f{ static_cast<Float>(x),
+                                           static_cast<Float>(y) } +
+                                  sampler.next2D() };
+          const Ray3f ray{ camera.sampleRay(film_pos) };
+
+          PathState state;
+          state.prev_p = ray.o;
+          store_state(path, state);
+          queues.film_x[path]       = film_pos.x;
+          queues.film_y[path]       = film_pos.y;
+          queues.pixel_x[path]      = x;
+          queues.pixel_y[path]      = y;
+          queues.sample_index[path] = index;
+          queues.dimension[path]    = sampler.dimension();
+          queues.rays.push(path, ray);
+        }
+      }
+    }
+
+    for (uint32_t depth = 0; not queues.rays.empty(); ++depth) {
+      const size_t count{ queues.rays.size() };
+
+      //------------------------------------------------------------------------
+      // Intersect, in coherent order
+      //------------------------------------------------------------------------
+      sortRays(queues, bounds);
+      queues.hits.resize(count);
+      // Only camera rays are coherent enough to benefit from packets
+      if (depth == 0 and settings_.packet_size == 8)
+        intersectPackets<8>(accel, queues);
+      else if (depth == 0 and settings_.packet_size == 16)
+        intersectPackets<16>(accel, queues);
+      else {
+        for (size_t i = 0; i < count; ++i)
+          queues.hits[i] = accel.rayIntersect(queues.rays.ray(i));
+      }
+
+      //------------------------------------------------------------------------
+      // Shade, grouped by material. Each path resumes its own sample, so the
+      // order doesn't change the result.
+      //------------------------------------------------------------------------
+      queues.materials.resize(count);
+      for (size_t i = 0; i < count; ++i) {
+        const PreliminaryIntersection& pi{ queues.hits[i] };
+        const BSDF*                    bsdf{ nullptr };
+        if (pi.isValid())
+          bsdf = pi.shape->surfaces()[pi.shape->surfaceIndex(pi.prim_index)]
+                   .bsdf.get();
+        queues.materials[i] = { bsdf, static_cast<uint32_t>(i) };
+      }
+      std::sort(queues.materials.begin(), queues.materials.end());
+
+      queues.next_rays.clear();
+      queues.shadow_rays.clear();
+      queues.shadow_r.clear();
+      queues.shadow_g.clear();
+      queues.shadow_b.clear();
+      for (const auto& [bsdf, i] : queues.materials) {
+        const uint32_t p{ queues.rays.path[i] };
+        sampler.startPixelSample({ queues.pixel_x[p], queues.pixel_y[p] },
+                                 queues.sample_index[p]);
+        sampler.setDimension(queues.dimension[p]);
+
+        PathState                    state{ load_state(p, queues.rays.ray(i)) };
+        std::optional<EmitterSample> emitter_sample;
+        const bool                   alive{ shade(scene,
+                                  accel,
+                                  queues.hits[i],
+                                  depth,
+                                  state,
+                                  sampler,
+                                  emitter_sample) };
+        store_state(p, state);
+        queues.dimension[p] = sampler.dimension();
+        if (emitter_sample) {
+          queues.shadow_rays.push(p, emitter_sample->shadow_ray);
+          queues.shadow_r.push_back(emitter_sample->value.x);
+          queues.shadow_g.push_back(emitter_sample->value.y);
+          queues.shadow_b.push_back(emitter_sample->value.z);
+        }
+        if (alive)
+          queues.next_rays.push(p, state.ray);
+      }
+
+      //------------------------------------------------------------------------
+      // Shadow rays
+      //------------------------------------------------------------------------
+      for (size_t i = 0; i < queues.shadow_rays.size(); ++i) {
+        if (accel.occluded(queues.shadow_rays.ray(i)))
+          continue;
+        const uint32_t p{ queues.shadow_rays.path[i] };
+        queues.result_r[p] += queues.shadow_r[i];
+        queues.result_g[p] += queues.shadow_g[i];
+        queues.result_b[p] += queues.shadow_b[i];
+      }
+
+      std::swap(queues.rays, queues.next_rays);
+    }
+
+    //--------------------------------------------------------------------------
+    // Splat the finished paths
+    //--------------------------------------------------------------------------
+    const uint32_t width{ camera.filmSize().x };
+    for (uint32_t i = 0; i < path; ++i) {
+      const Color3f value{ queues.result_r[i],
+                           queues.result_g[i],
+                           queues.result_b[i] };
+      const size_t  pixel_index{ static_cast<size_t>(queues.pixel_y[i]) *
+                                  width +
+                                queues.pixel_x[i] };
+      // Drop the occasional NaN/inf instead of ruining the whole pixel
+      if (std::isfinite(value.x + value.y + value.z)) {
+        block.put({ queues.film_x[i], queues.film_y[i] }, value);
+        if (statistics)
+          statistics[pixel_index].add(value);
+      }
+      // The last sample of a pixel in the batch
+      if (statistics and (i + 1) % batch_count == 0 and
+          batch_offset + batch_count == sample_count)
+        max_error =
+          std::max(max_error, statistics[pixel_index].relativeError());
+    }
+  }
+  return max_error;
+}
+} // namespace eldr
@@ -0,0 +1,600 @@
+#include <eldr/core/logger.hpp>
+#include <eldr/core/stream.hpp>
+#include <eldr/render/widebvh.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  define ELDR_X86 1
+#  include <immintrin.h>
+#endif
+
+using namespace eldr::core;
+
+namespace eldr {
+namespace {
+constexpr float inf{ std::numeric_limits<float>::infinity() };
+
+// -----------------------------------------------------------------------------
+// Node kernels
+// -----------------------------------------------------------------------------
+template <uint32_t Width>
+uint32_t intersectChildrenScalar(const WideBVHNode<Width>& node,
+                                 const WideRay&            ray,
+                                 float                     maxt,
+                                 float*                    tnear)
+{
+  uint32_t mask{ 0 };
+  for (uint32_t i = 0; i < Width; ++i) {
+    float tn{ 0.f }, tf{ maxt };
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+      const float rcp{ ray.d_rcp[axis] };
+      const float o_rcp{ ray.o_rcp[axis] };
+      tn = std::max(tn, node.bounds[ray.near[axis]][i] * rcp - o_rcp);
+      tf = std::min(tf, node.bounds[ray.far[axis]][i] * rcp - o_rcp);
+    }
+    tnear[i] = tn;
+    mask |= static_cast<uint32_t>(tn <= tf) << i;
+  }
+  return mask;
+}
+
+#ifdef ELDR_X86
+/// SSE is part of x86-64, so this kernel needs no runtime check
+uint32_t intersectChildrenSSE(const float (&bounds)[6][4],
+                              const WideRay& ray,
+                              float          maxt,
+                              float*         tnear)
+{
+  __m128 tn{ _mm_setzero_ps() };
+  __m128 tf{ _mm_set1_ps(maxt) };
+  for (uint32_t axis = 0; axis < 3; ++axis) {
+    const __m128 rcp{ _mm_set1_ps(ray.d_rcp[axis]) };
+    const __m128 o_rcp{ _mm_set1_ps(ray.o_rcp[axis]) };
+    const __m128 t_near{ _mm_sub_ps(
+      _mm_mul_ps(_mm_loadu_ps(bounds[ray.near[axis]]), rcp), o_rcp) };
+    const __m128 t_far{ _mm_sub_ps(
+      _mm_mul_ps(_mm_loadu_ps(bounds[ray.far[axis]]), rcp), o_rcp) };
+    tn = _mm_max_ps(tn, t_near);
+    tf = _mm_min_ps(tf, t_far);
+  }
+  _mm_storeu_ps(tnear, tn);
+  return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(tn, tf)));
+}
+
+uint32_t intersectChildrenSSE4(const WideBVHNode<4>& node,
+                               const WideRay&        ray,
+                               float                 maxt,
+                               float*                tnear)
+{
+  return intersectChildrenSSE(node.bounds, ray, maxt, tnear);
+}
+
+/// 8-wide nodes on CPUs without AVX2 are processed as two 4-wide halves
+uint32_t intersectChildrenSSE8(const WideBVHNode<8>& node,
+                               const WideRay&        ray,
+                               float                 maxt,
+                               float*                tnear)
+{
+  float lo[6][4], hi[6][4];
+  for (uint32_t row = 0; row < 6; ++row) {
+    std::copy_n(node.bounds[row], 4, lo[row]);
+    std::copy_n(node.bounds[row] + 4, 4, hi[row]);
+  }
+  return intersectChildrenSSE(lo, ray, maxt, tnear) |
+         (intersectChildrenSSE(hi, ray, maxt, tnear + 4) << 4);
+}
+
+__attribute__((target("avx2,fma"))) uint32_t
+intersectChildrenAVX2(const WideBVHNode<8>& node,
+                      const WideRay&        ray,
+                      float                 maxt,
+                      float*                tnear)
+{
+  __m256 tn{ _mm256_setzero_ps() };
+  __m256 tf{ _mm256_set1_ps(maxt) };
+  for (uint32_t axis = 0; axis < 3; ++axis) {
+    const __m256 rcp{ _mm256_set1_ps(ray.d_rcp[axis]) };
+    const __m256 o_rcp{ _mm256_set1_ps(ray.o_rcp[axis]) };
+    tn = _mm256_max_ps(
+      tn, _mm256_fmsub_ps(_mm256_load_ps(node.bounds[ray.near[axis]]), rcp, o_rcp));
+    tf = _mm256_min_ps(
+      tf, _mm256_fmsub_ps(_mm256_load_ps(node.bounds[ray.far[axis]]), rcp, o_rcp));
+  }
+  _mm256_storeu_ps(tnear, tn);
+  return static_cast<uint32_t>(
+    _mm256_movemask_ps(_mm256_cmp_ps(tn, tf, _CMP_LE_OQ)));
+}
+
+/// @brief Test four children of a quantized node starting at slot `first`.
+/// With the plane of a child at origin + q * scale, the slab distance
+/// (plane - o) / d becomes q * (scale / d) + (origin - o) / d, a single
+/// multiply-add per plane once the two factors are set up per node.
+template <uint32_t Width>
+uint32_t intersectQuantizedSSE(const QuantizedWideBVHNode<Width>& node,
+                               uint32_t                           first,
+                               const WideRay&                     ray,
+                               float                              maxt,
+                               float*                             tnear)
+{
+  // Widen four 8-bit cells to floats, SSE2 only
+  auto load = [&](uint32_t row) {
+    int32_t packed;
+    std::memcpy(&packed, node.bounds[row] + first, sizeof(packed));
+    const __m128i zero{ _mm_setzero_si128() };
+    const __m128i q{ _mm_unpacklo_epi16(
+      _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero) };
+    return _mm_cvtepi32_ps(q);
+  };
+
+  __m128 tn{ _mm_setzero_ps() };
+  __m128 tf{ _mm_set1_ps(maxt) };
+  for (uint32_t axis = 0; axis < 3; ++axis) {
+    const __m128 a{ _mm_set1_ps(node.scale(axis) * ray.d_rcp[axis]) };
+    const __m128 b{ _mm_set1_ps(node.origin[axis] * ray.d_rcp[axis] -
+                                ray.o_rcp[axis]) };
+    tn = _mm_max_ps(tn, _mm_add_ps(_mm_mul_ps(load(ray.near[axis]), a), b));
+    tf = _mm_min_ps(tf, _mm_add_ps(_mm_mul_ps(load(ray.far[axis]), a), b));
+  }
+  _mm_storeu_ps(tnear + first, tn);
+  const auto mask{ static_cast<uint32_t>(
+    _mm_movemask_ps(_mm_cmple_ps(tn, tf))) };
+  return (mask << first) & node.child_mask;
+}
+
+uint32_t intersectQuantizedSSE4(const QuantizedWideBVHNode<4>& node,
+                                const WideRay&                 ray,
+                                float                          maxt,
+                                float*                         tnear)
+{
+  return intersectQuantizedSSE(node, 0, ray, maxt, tnear);
+}
+
+uint32_t intersectQuantizedSSE8(const QuantizedWideBVHNode<8>& node,
+                                const WideRay&                 ray,
+                                float                          maxt,
+                                float*                         tnear)
+{
+  return intersectQuantizedSSE(node, 0, ray, maxt, tnear) |
+         intersectQuantizedSSE(node, 4, ray, maxt, tnear);
+}
+
+/// @brief Widen eight 8-bit cells to floats
+__attribute__((target("avx2"))) inline __m256 loadCellsAVX2(const uint8_t* row)
+{
+  return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+    _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row))));
+}
+
+__attribute__((target("avx2,fma"))) uint32_t
+intersectQuantizedAVX2(const QuantizedWideBVHNode<8>& node,
+                       const WideRay&                 ray,
+                       float                          maxt,
+                       float*                         tnear)
+{
+  __m256 tn{ _mm256_setzero_ps() };
+  __m256 tf{ _mm256_set1_ps(maxt) };
+  for (uint32_t axis = 0; axis < 3; ++axis) {
+    const __m256 a{ _mm256_set1_ps(node.scale(axis) * ray.d_rcp[axis]) };
+    const __m256 b{ _mm256_set1_ps(node.origin[axis] * ray.d_rcp[axis] -
+                                   ray.o_rcp[axis]) };
+    tn = _mm256_max_ps(
+      tn, _mm256_fmadd_ps(loadCellsAVX2(node.bounds[ray.near[axis]]), a, b));
+    tf = _mm256_min_ps(
+      tf, _mm256_fmadd_ps(loadCellsAVX2(node.bounds[ray.far[axis]]), a, b));
+  }
+  _mm256_storeu_ps(tnear, tn);
+  return static_cast<uint32_t>(
+           _mm256_movemask_ps(_mm256_cmp_ps(tn, tf, _CMP_LE_OQ))) &
+         node.child_mask;
+}
+#endif // ELDR_X86
+
+template <uint32_t Width>
+uint32_t intersectQuantizedScalar(const QuantizedWideBVHNode<Width>& node,
+                                  const WideRay&                     ray,
+                                  float                              maxt,
+                                  float*                             tnear)
+{
+  float a[3], b[3];
+  for (uint32_t axis = 0; axis < 3; ++axis) {
+    a[axis] = node.scale(axis) * ray.d_rcp[axis];
+    b[axis] = node.origin[axis] * ray.d_rcp[axis] - ray.o_rcp[axis];
+  }
+  uint32_t mask{ 0 };
+  for (uint32_t i = 0; i < Width; ++i) {
+    float tn{ 0.f }, tf{ maxt };
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+      tn = std::max(tn, node.bounds[ray.near[axis]][i] * a[axis] + b[axis]);
+      tf = std::min(tf, node.bounds[ray.far[axis]][i] * a[axis] + b[axis]);
+    }
+    tnear[i] = tn;
+    mask |= static_cast<uint32_t>(tn <= tf) << i;
+  }
+  return mask & node.child_mask;
+}
+
+/// @brief Get the float `2^exponent`
+float exp2i(int32_t exponent)
+{
+  return std::bit_cast<float>(static_cast<uint32_t>(exponent + 127) << 23);
+}
+
+/// @brief Compress a node, rounding the child bounds outwards to the grid
+template <uint32_t Width>
+QuantizedWideBVHNode<Width> quantize(const WideBVHNode<Width>& node,
+                                     uint32_t                  node_index)
+{
+  QuantizedWideBVHNode<Width> result;
+  BoundingBox3f               bbox;
+  for (uint32_t i = 0; i < Width; ++i) {
+    if (not node.isEmpty(i))
+      bbox.expand(node.childBBox(i));
+  }
+
+  result.child_mask = 0;
+  for (uint32_t axis = 0; axis < 3; ++axis) {
+    const float origin{ bbox.min[axis] };
+    const float extent{ bbox.max[axis] - origin };
+    // Smallest power of two cell size for which 255 cells cover the node,
+    // kept in the range of normal floats
+    int32_t exponent{ -126 };
+    if (extent > 0.f)
+      exponent = std::max(
+        exponent, static_cast<int32_t>(std::ceil(std::log2(extent / 255.f))));
+    while (origin + 255.f * exp2i(exponent) < bbox.max[axis])
+      ++exponent;
+    result.origin[axis]   = origin;
+    result.exponent[axis] = static_cast<int8_t>(exponent);
+  }
+
+  for (uint32_t i = 0; i < Width; ++i) {
+    if (node.isEmpty(i)) {
+      for (uint32_t axis = 0; axis < 3; ++axis) {
+        result.bounds[axis][i]     = 0;
+        result.bounds[3 + axis][i] = 0;
+      }
+      result.child[i]      = QuantizedWideBVHNode<Width>::invalid;
+      result.prim_count[i] = 0;
+      continue;
+    }
+    result.child_mask |= 1u << i;
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+      const float origin{ result.origin[axis] };
+      const float scale{ result.scale(axis) };
+      auto        decode = [&](int32_t q) { return origin + q * scale; };
+      const float cmin{ node.bounds[axis][i] };
+      const float cmax{ node.bounds[3 + axis][i] };
+
+      auto qmin{ static_cast<int32_t>(std::floor((cmin - origin) / scale)) };
+      qmin = std::clamp(qmin, 0, 255);
+      while (qmin > 0 and decode(qmin) > cmin)
+        --qmin;
+      auto qmax{ static_cast<int32_t>(std::ceil((cmax - origin) / scale)) };
+      qmax = std::clamp(qmax, 0, 255);
+      while (qmax < 255 and decode(qmax) < cmax)
+        ++qmax;
+      result.bounds[axis][i]     = static_cast<uint8_t>(qmin);
+      result.bounds[3 + axis][i] = static_cast<uint8_t>(qmax);
+    }
+    if (node.isLeaf(i)) {
+      // Only reachable at the depth limit of the binary BVH
+      if (node.prim_count[i] > std::numeric_limits<uint16_t>::max())
+        Throw("WideBVH: leaf of {} primitives is too large for a quantized "
+              "node",
+              node.prim_count[i]);
+      result.child[i]      = node.child[i];
+      result.prim_count[i] = static_cast<uint16_t>(node.prim_count[i]);
+    }
+    else {
+      // Children are always created after their parent
+      result.child[i]      = node.child[i] - node_index;
+      result.prim_count[i] = 0;
+    }
+  }
+  return result;
+}
+
+enum class Kernel { Scalar, SSE, AVX2 };
+
+Kernel detectKernel(uint32_t width)
+{
+#ifdef ELDR_X86
+  if (width == 8) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") and __builtin_cpu_supports("fma"))
+      return Kernel::AVX2;
+  }
+  return Kernel::SSE;
+#else
+  (void) width;
+  return Kernel::Scalar;
+#endif
+}
+
+template <uint32_t Width, bool Quantized>
+typename WideBVH<Width, Quantized>::IntersectFn selectKernel()
+{
+  switch (detectKernel(Width)) {
+#ifdef ELDR_X86
+    case Kernel::AVX2:
+      if constexpr (Width == 8 and Quantized)
+        return intersectQuantizedAVX2;
+      else if constexpr (Width == 8)
+        return intersectChildrenAVX2;
+      break;
+    case Kernel::SSE:
+      if constexpr (Width == 4 and Quantized)
+        return intersectQuantizedSSE4;
+      else if constexpr (Quantized)
+        return intersectQuantizedSSE8;
+      else if constexpr (Width == 4)
+        return intersectChildrenSSE4;
+      else
+        return intersectChildrenSSE8;
+#endif
+    default:
+      break;
+  }
+  if constexpr (Quantized)
+    return intersectQuantizedScalar<Width>;
+  else
+    return intersectChildrenScalar<Width>;
+}
+} // namespace
+
+template <uint32_t Width, bool Quantized>
+WideBVH<Width, Quantized>::WideBVH()
+  : intersect_children_(selectKernel<Width, Quantized>())
+{
+}
+
+template <uint32_t Width, bool Quantized>
+WideBVH<Width, Quantized>::WideBVH(const BVH& bvh, uint32_t leaf_alignment)
+  : WideBVH()
+{
+  build(bvh, leaf_alignment);
+}
+
+template <uint32_t Width, bool Quantized>
+const char* WideBVH<Width, Quantized>::kernelName()
+{
+  switch (detectKernel(Width)) {
+    case Kernel::AVX2:
+      return "AVX2";
+    case Kernel::SSE:
+      return Width == 8 ? "SSE (2x4)" : "SSE";
+    default:
+      return "scalar";
+  }
+}
+
+template <uint32_t Width, bool Quantized>
+void WideBVH<Width, Quantized>::build(const BVH& bvh, uint32_t leaf_alignment)
+{
+  Assert(leaf_alignment > 0, "leaf alignment must be positive");
+  nodes_.clear();
+  prim_indices_.clear();
+  stats_          = {};
+  bbox_           = {};
+  leaf_alignment_ = leaf_alignment;
+  if (bvh.empty())
+    return;
+
+  // The leaves are laid out in the order they are collapsed in, so
+  // primitives of nearby leaves stay close in memory
+  prim_indices_.reserve(bvh.primIndices().size());
+  // Each wide node replaces at least one binary interior node
+  std::vector<WideBVHNode<Width>> nodes;
+  nodes.reserve(std::max<size_t>(1, bvh.nodes().size() / 2));
+  bbox_ = bvh.bbox();
+  collapse(bvh, 0, nodes);
+  prim_indices_.shrink_to_fit();
+  if constexpr (Quantized) {
+    nodes_.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i)
+      nodes_[i] = quantize(nodes[i], static_cast<uint32_t>(i));
+  }
+  else {
+    nodes.shrink_to_fit();
+    nodes_ = std::move(nodes);
+  }
+
+  size_t child_count{ 0 };
+  for (const Node& node : nodes_) {
+    for (uint32_t i = 0; i < Width; ++i) {
+      if (node.isEmpty(i))
+        continue;
+      child_count++;
+      if (node.isLeaf(i))
+        stats_.leaf_count++;
+    }
+  }
+  stats_.node_count      = nodes_.size();
+  stats_.avg_child_count = static_cast<float>(child_count) / nodes_.size();
+  Log(Debug,
+      "Collapsed BVH into {} {}-wide {}nodes ({} leaves, avg. {:.2f} children "
+      "per node, {} kernel)",
+      stats_.node_count,
+      Width,
+      Quantized ? "quantized " : "",
+      stats_.leaf_count,
+      stats_.avg_child_count,
+      kernelName());
+}
+
+template <uint32_t Width, bool Quantized>
+uint32_t
+WideBVH<Width, Quantized>::collapse(const BVH&                       bvh,
+                                    const uint32_t                   binary_node,
+                                    std::vector<WideBVHNode<Width>>& nodes)
+{
+  const std::span<const BVHNode> binary_nodes{ bvh.nodes() };
+
+  // Gather up to Width children by repeatedly opening the interior child with
+  // the largest surface area, since it is the most likely one to be visited
+  uint32_t children[Width];
+  uint32_t child_count{ 0 };
+  if (binary_nodes[binary_node].isLeaf()) {
+    // Only happens for a root that is a leaf
+    children[child_count++] = binary_node;
+  }
+  else {
+    children[child_count++] = binary_nodes[binary_node].offset;
+    children[child_count++] = binary_nodes[binary_node].offset + 1;
+  }
+  while (child_count < Width) {
+    int32_t best{ -1 };
+    Float   best_area{ -1.f };
+    for (uint32_t i = 0; i < child_count; ++i) {
+      const BVHNode& child{ binary_nodes[children[i]] };
+      if (child.isLeaf())
+        continue;
+      if (const Float area{ child.bbox.surfaceArea() }; area > best_area) {
+        best_area = area;
+        best      = static_cast<int32_t>(i);
+      }
+    }
+    if (best < 0)
+      break;
+    const uint32_t offset{ binary_nodes[children[best]].offset };
+    children[best]          = offset;
+    children[child_count++] = offset + 1;
+  }
+
+  const auto node_index{ static_cast<uint32_t>(nodes.size()) };
+  nodes.emplace_back();
+  for (uint32_t i = 0; i < Width; ++i) {
+    WideBVHNode<Width>& node{ nodes[node_index] };
+    if (i >= child_count) {
+      for (uint32_t axis = 0; axis < 3; ++axis) {
+        node.bounds[axis][i]     = inf;
+        node.bounds[3 + axis][i] = -inf;
+      }
+      node.child[i]      = WideBVHNode<Width>::invalid;
+      node.prim_count[i] = 0;
+      continue;
+    }
+
+    const BVHNode& child{ binary_nodes[children[i]] };
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+      node.bounds[axis][i]     = child.bbox.min[axis];
+      node.bounds[3 + axis][i] = child.bbox.max[axis];
+    }
+    if (child.isLeaf()) {
+      node.child[i]      = appendLeaf(bvh, child);
+      node.prim_count[i] = child.prim_count;
+    }
+    else {
+      // nodes may be reallocated by the recursion, so don't keep references
+      const uint32_t child_index{ collapse(bvh, children[i], nodes) };
+      nodes[node_index].child[i]      = child_index;
+      nodes[node_index].prim_count[i] = 0;
+    }
+  }
+  return node_index;
+}
+
+template <uint32_t Width, bool Quantized>
+void WideBVH<Width, Quantized>::write(Stream& stream) const
+{
+  stream.write(leaf_alignment_);
+  stream.writeArray(&bbox_.min.x, 3);
+  stream.writeArray(&bbox_.max.x, 3);
+  stream.write(static_cast<uint64_t>(stats_.leaf_count));
+  stream.write(stats_.avg_child_count);
+  stream.write(static_cast<uint64_t>(nodes_.size()));
+  stream.write(nodes_.data(), nodes_.size() * sizeof(Node));
+  stream.write(static_cast<uint64_t>(prim_indices_.size()));
+  stream.writeArray(prim_indices_.data(), prim_indices_.size());
+}
+
+template <uint32_t Width, bool Quantized>
+void WideBVH<Width, Quantized>::read(Stream& stream)
+{
+  stream.read(leaf_alignment_);
+  stream.readArray(&bbox_.min.x, 3);
+  stream.readArray(&bbox_.max.x, 3);
+  uint64_t leaf_count, node_count, prim_count;
+  stream.read(leaf_count);
+  stream.read(stats_.avg_child_count);
+  stream.read(node_count);
+  if (node_count * sizeof(Node) > stream.size() - stream.tell())
+    Throw("WideBVH: stream ends before the {} nodes", node_count);
+  nodes_.resize(node_count);
+  stream.read(nodes_.data(), nodes_.size() * sizeof(Node));
+  stream.read(prim_count);
+  if (prim_count * sizeof(uint32_t) > stream.size() - stream.tell())
+    Throw("WideBVH: stream ends before the {} primitive indices", prim_count);
+  prim_indices_.resize(prim_count);
+  stream.readArray(prim_indices_.data(), prim_indices_.size());
+  stats_.node_count = nodes_.size();
+  stats_.leaf_count = leaf_count;
+  validate();
+}
+
+template <uint32_t Width, bool Quantized>
+void WideBVH<Width, Quantized>::validate() const
+{
+  if (leaf_alignment_ == 0)
+    Throw("WideBVH: leaf alignment is zero");
+  // Children always come after their parent, which also rules out cycles, so
+  // the depth of every node is known once its parent has been checked
+  std::vector<uint32_t> depth(nodes_.size(), 0);
+  for (uint32_t n = 0; n < nodes_.size(); ++n) {
+    const Node& node{ nodes_[n] };
+    for (uint32_t i = 0; i < Width; ++i) {
+      if (node.isEmpty(i)) {
+        // The node kernels must never report an empty slot as hit
+        bool unused;
+        if constexpr (Quantized)
+          unused = (node.child_mask >> i & 1) == 0;
+        else
+          unused = node.bounds[0][i] > node.bounds[3][i];
+        if (not unused)
+          Throw("WideBVH: empty child {} of node {} can be hit", i, n);
+        continue;
+      }
+      if (node.isLeaf(i)) {
+        const uint64_t first{ node.firstPrim(i) };
+        if (first % leaf_alignment_ != 0 or
+            first + node.prim_count[i] > prim_indices_.size())
+          Throw("WideBVH: leaf {} of node {} is outside of the {} primitive "
+                "indices",
+                i,
+                n,
+                prim_indices_.size());
+        continue;
+      }
+      const uint32_t child{ node.childNode(n, i) };
+      if (child <= n or child >= nodes_.size())
+        Throw("WideBVH: child {} of node {} has invalid index {}", i, n, child);
+      depth[child] = depth[n] + 1;
+      if (depth[child] >= BVH::max_depth)
+        Throw("WideBVH: tree is deeper than {} levels", BVH::max_depth);
+    }
+  }
+}
+
+template <uint32_t Width, bool Quantized>
+uint32_t WideBVH<Width, Quantized>::appendLeaf(const BVH& bvh, const BVHNode& leaf)
+{
+  const size_t padding{ (leaf_alignment_ -
+                         prim_indices_.size() % leaf_alignment_) %
+                        leaf_alignment_ };
+  prim_indices_.insert(prim_indices_.end(), padding, Node::invalid);
+  const auto offset{ static_cast<uint32_t>(prim_indices_.size()) };
+  const std::span<const uint32_t> prims{
+    bvh.primIndices().subspan(leaf.offset, leaf.prim_count)
+  };
+  prim_indices_.insert(prim_indices_.end(), prims.begin(), prims.end());
+  return offset;
+}
+
+template class WideBVH<4>;
+template class WideBVH<8>;
+template class WideBVH<4, true>;
+template class WideBVH<8, true>;
+} // namespace eldr
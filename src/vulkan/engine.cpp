@@ -7,6 +7,7 @@
 #include <eldr/core/hash.hpp>
 #include <eldr/core/logger.hpp>
 #include <eldr/core/math.hpp>
+#include <eldr/core/parallel.hpp>
 #include <eldr/core/platform.hpp>
 #include <eldr/core/stopwatch.hpp>
 #include <eldr/render/mesh.hpp>
@@ -51,6 +52,10 @@ struct FrameData {
   Buffer<GpuSceneData>     scene_data_buffer;
   Buffer<GpuModelData>     model_data_buffer;
   const wr::CommandBuffer* cmd_buf;
+  // Set by prepareGeometry() for the draws of the frame
+  VkDescriptorSet       scene_descriptor{ VK_NULL_HANDLE };
+  VkDescriptorSet       model_descriptor{ VK_NULL_HANDLE };
+  std::vector<uint32_t> first_indices;
 };
 
 // TODO: is this even used
@@ -178,7 +183,11 @@ VulkanEngine::VulkanEngine(const app::Window& window)
   //  ---------------------------------------------------------------------------
   //  Create render graph
   //  ---------------------------------------------------------------------------
-  recreateSwapchain();
+  d_->render_graph = std::make_unique<RenderGraph>(d_->device, d_->swapchain);
+  setupRenderGraph();
+  d_->imgui_overlay = std::make_unique<ImGuiOverlay>(
+    d_->device, d_->swapchain, d_->render_graph.get());
+  d_->render_graph->compile();
 }
 
 VulkanEngine::~VulkanEngine() { d_->device.waitIdle(); }
@@ -361,29 +370,22 @@ void VulkanEngine::setupRenderGraph()
   auto* main_stage = graph->add<GraphicsStage>("Main stage");
   main_stage->writesTo(color_buffer, VK_ATTACHMENT_LOAD_OP_CLEAR)
     .writesTo(depth_buffer, VK_ATTACHMENT_LOAD_OP_CLEAR)
-    .setOnRecord([&](const CommandBuffer& cb) { drawGeometry(cb); });
+    .setOnRecord(
+      [&] { return main_draw_context_.opaque_surfaces.size(); },
+      [&](const CommandBuffer& cb, const BlockedRange<size_t>& range) {
+        drawGeometry(cb, range);
+      });
 }
 
 void VulkanEngine::recreateSwapchain()
 {
-  const auto& device{ d_->device };
-  auto&       swapchain{ d_->swapchain };
-  auto&       graph{ d_->render_graph };
-  auto&       overlay{ d_->imgui_overlay };
-
   window_.waitForFocus();
-  device.waitIdle();
-  swapchain.setupSwapchain(
-    device, d_->surface, { window_.width(), window_.height() });
-  // TODO: experiment with render graph creation/compilation. It is not
-  // necessary to rebuild the whole thing on every swapchain invalidation.
-  graph.reset();
-  graph = std::make_unique<RenderGraph>(device, swapchain);
-  setupRenderGraph();
-  // Reset first to destroy ImGui context
-  overlay.reset();
-  overlay = std::make_unique<ImGuiOverlay>(device, swapchain, graph.get());
-  graph->compile();
+  // Frames in flight may still copy to the old swapchain images, so the render
+  // graph keeps the old swapchain alive along with its own old textures until
+  // they have finished. The stages and the overlay stay as they are.
+  auto old_swapchain{ d_->swapchain.setupSwapchain(
+    d_->device, d_->surface, { window_.width(), window_.height() }) };
+  d_->render_graph->resize(std::move(old_swapchain));
 }
 
 void VulkanEngine::updateScenes(uint32_t current_image)
@@ -429,17 +431,9 @@ void VulkanEngine::updateScenes(uint32_t current_image)
   }
 }
 
-void VulkanEngine::drawGeometry(const CommandBuffer& cb)
+void VulkanEngine::prepareGeometry()
 {
-  const auto& swapchain{ d_->swapchain };
-  const auto& device{ d_->device };
-
-  cb.bindIndexBuffer(d_->index_buffer);
-  // Using vertex pulling instead, so binding vertex buffer not necessary
-  // VkBuffer vbuffers[]{ d_->vertex_buffer.vk() };
-  // cb.bindVertexBuffers(vbuffers);
-
-  const size_t    surface_count{ main_draw_context_.opaque_surfaces.size() };
+  const auto&     device{ d_->device };
   FrameData&      frame{ d_->frames_in_flight[frame_index_] };
   VkDescriptorSet scene_descriptor{ frame.descriptors.allocate(
     device, d_->scene_data_descriptor_layout) };
@@ -447,8 +441,6 @@ void VulkanEngine::drawGeometry(const CommandBuffer& cb)
   VkDescriptorSet model_descriptor{ frame.descriptors.allocate(
     device, d_->model_data_descriptor_layout) };
 
-  size_t idx_offset{ 0 };
-
   DescriptorWriter writer;
   writer.writeUniformBuffer(0, frame.scene_data_buffer, 0)
     .updateSet(device, scene_descriptor);
@@ -458,15 +450,48 @@ void VulkanEngine::drawGeometry(const CommandBuffer& cb)
   writer.writeUniformBuffer(0, frame.model_data_buffer, 0)
     .updateSet(device, model_descriptor);
 
-  for (size_t i{ 0 }; i < surface_count; ++i) {
-    const RenderObject& draw{ main_draw_context_.opaque_surfaces[i] };
-    // cb.bindDescriptorSets(descriptors_[frame_index_].descriptorSets(),
-    //                       physical.pipelineLayout());
-    // VkDescriptorSet viking_descriptor{ frame.descriptors.allocate(
-    //   device, d_->viking_model_descriptor_layout) };
+  frame.scene_descriptor = scene_descriptor;
+  frame.model_descriptor = model_descriptor;
 
-    //
+  // Draws are recorded in blocks on different threads, so the offset of each
+  // one into the index buffer is computed up front
+  frame.first_indices.clear();
+  uint32_t idx_offset{ 0 };
+  for (const RenderObject& draw : main_draw_context_.opaque_surfaces) {
+    frame.first_indices.push_back(draw.first_index + idx_offset);
+    idx_offset += draw.index_count;
+  }
+}
+
+void VulkanEngine::drawGeometry(const CommandBuffer&        cb,
+                                const BlockedRange<size_t>& range)
+{
+  const auto&      swapchain{ d_->swapchain };
+  const FrameData& frame{ d_->frames_in_flight[frame_index_] };
+
+  cb.bindIndexBuffer(d_->index_buffer);
+  // Using vertex pulling instead, so binding vertex buffer not necessary
+  // VkBuffer vbuffers[]{ d_->vertex_buffer.vk() };
+  // cb.bindVertexBuffers(vbuffers);
 
+  const VkViewport viewports[] = { {
+    .x        = 0.0f,
+    .y        = 0.0f,
+    .width    = static_cast<float>(swapchain.extent().width),
+    .height   = static_cast<float>(swapchain.extent().height),
+    .minDepth = 0.0f,
+    .maxDepth = 1.0f,
+  } };
+  cb.setViewport(viewports, 0);
+
+  const VkRect2D scissors[] = { {
+    .offset = { 0, 0 },
+    .extent = swapchain.extent(),
+  } };
+  cb.setScissor(scissors, 0);
+
+  for (size_t i{ range.begin() }; i != range.end(); ++i) {
+    const RenderObject& draw{ main_draw_context_.opaque_surfaces[i] };
     // cb.bindDescriptorSets(draw.material->descriptor.descriptorSets(),
     // physical.pipelineLayout(), 1);
 
@@ -480,30 +505,13 @@ void VulkanEngine::drawGeometry(const CommandBuffer& cb)
                     push_constants,
                     VK_SHADER_STAGE_VERTEX_BIT);
 
-    std::vector<VkDescriptorSet> descriptor_sets{
-      scene_descriptor, draw.material->data.descriptor_set, model_descriptor
-    };
+    const VkDescriptorSet descriptor_sets[]{ frame.scene_descriptor,
+                                             draw.material->data.descriptor_set,
+                                             frame.model_descriptor };
     cb.bindDescriptorSets(descriptor_sets,
                           draw.material->data.pipeline->layout());
 
-    const VkViewport viewports[] = { {
-      .x        = 0.0f,
-      .y        = 0.0f,
-      .width    = static_cast<float>(swapchain.extent().width),
-      .height   = static_cast<float>(swapchain.extent().height),
-      .minDepth = 0.0f,
-      .maxDepth = 1.0f,
-    } };
-    cb.setViewport(viewports, 0);
-
-    const VkRect2D scissors[] = { {
-      .offset = { 0, 0 },
-      .extent = swapchain.extent(),
-    } };
-    cb.setScissor(scissors, 0);
-
-    cb.drawIndexed(draw.index_count, 1, draw.first_index + idx_offset);
-    idx_offset += draw.index_count;
+    cb.drawIndexed(draw.index_count, 1, frame.first_indices[i]);
   }
 }
 
@@ -589,6 +597,8 @@ void VulkanEngine::drawFrame()
   const auto& cb = device.requestCommandBuffer();
   frame.cmd_buf  = &cb;
 
+  prepareGeometry();
+
   cb.transitionImageLayout(swapchain.image(image_index),
                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
   d_->render_graph->render(cb, swapchain.image(image_index));
@@ -6,11 +6,62 @@
 #include <eldr/vulkan/wrappers/framebuffer.hpp>
 #include <eldr/vulkan/wrappers/shader.hpp>
 
+#include <algorithm>
 #include <deque>
 
 using namespace eldr::core;
 
 namespace eldr::vk {
+namespace {
+/// @brief Layout textures are kept in while they are rendered to
+VkImageLayout attachmentLayout(TextureUsage usage)
+{
+  switch (usage) {
+    case TextureUsage::Color:
+      return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    case TextureUsage::DepthStencil:
+      return VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+    default:
+      Throw("Attachment layout for this texture usage has not been defined");
+  }
+}
+
+/// @brief Get how a stage running shaders in `shader_stages` reads a buffer
+/// with `usage`
+ResourceAccess bufferReadAccess(VkBufferUsageFlags    usage,
+                                VkPipelineStageFlags2 shader_stages)
+{
+  ResourceAccess access;
+  if (usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) {
+    access.stages |= VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT;
+    access.access |= VK_ACCESS_2_INDEX_READ_BIT;
+  }
+  if (usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) {
+    access.stages |= VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT;
+    access.access |= VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT;
+  }
+  if (usage & VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT) {
+    access.stages |= VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT;
+    access.access |= VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT;
+  }
+  if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+    access.stages |= shader_stages;
+    access.access |= VK_ACCESS_2_UNIFORM_READ_BIT;
+  }
+  if (usage & (VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+               VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)) {
+    access.stages |= shader_stages;
+    access.access |= VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+  }
+  if (access.stages == VK_PIPELINE_STAGE_2_NONE) {
+    // Unknown use, wait for anything
+    access.stages = shader_stages;
+    access.access = VK_ACCESS_2_MEMORY_READ_BIT;
+  }
+  return access;
+}
+} // namespace
+
 RenderStage& RenderStage::writesTo(const RenderResource* resource)
 {
   if (unlikely(writes_.contains(resource))) {
@@ -29,13 +80,17 @@ RenderStage& RenderStage::readsFrom(const RenderResource* resource)
   return *this;
 }
 
-GraphicsStage& GraphicsStage::writesTo(const TextureResource* resource,
-                                       VkAttachmentLoadOp     load_op,
-                                       VkAttachmentStoreOp    store_op)
+GraphicsStage&
+GraphicsStage::writesTo(const TextureResource*             resource,
+                        VkAttachmentLoadOp                 load_op,
+                        std::optional<VkAttachmentStoreOp> store_op)
 {
   RenderStage::writesTo(resource);
-  load_store_ops_.insert(
-    std::make_pair(resource, std::make_pair(load_op, store_op)));
+  load_store_ops_.insert(std::make_pair(
+    resource,
+    std::make_pair(load_op, store_op.value_or(VK_ATTACHMENT_STORE_OP_STORE))));
+  if (not store_op)
+    inferred_stores_.insert(resource);
   return *this;
 }
 
@@ -88,11 +143,223 @@ bool RenderStage::hasReadDependency(
   return false;
 }
 
-void RenderGraph::recordCommandBuffer(const RenderStage*       stage,
-                                      const wr::CommandBuffer& cb) const
+void RenderGraph::addBarrier(PhysicalResource&     resource,
+                             const ResourceAccess& access,
+                             BarrierBatch&         batch)
+{
+  MemoryAccessState&  state{ *resource.state_ };
+  auto*               image{ resource.as<PhysicalImage>() };
+  const VkImageLayout old_layout{ image and not access.acquire
+                                    ? image->image_.layout()
+                                    : VK_IMAGE_LAYOUT_UNDEFINED };
+  const bool          transition{ image and (access.acquire or
+                                             old_layout != access.layout) };
+
+  VkPipelineStageFlags2 src_stages{ VK_PIPELINE_STAGE_2_NONE };
+  VkAccessFlags2        src_access{ VK_ACCESS_2_NONE };
+  bool                  needed{ transition };
+  if (access.write or transition) {
+    // Writes and layout transitions wait for every earlier access. Only
+    // earlier writes need to be made available, reads just have to finish.
+    src_stages = state.write_stages | state.read_stages;
+    src_access = state.write_access;
+    needed |= src_stages != VK_PIPELINE_STAGE_2_NONE;
+
+    state.write_stages   = access.stages;
+    state.write_access   = access.write ? access.access : VK_ACCESS_2_NONE;
+    state.read_stages    = access.write ? VK_PIPELINE_STAGE_2_NONE
+                                        : access.stages;
+    state.visible_stages = access.write ? VK_PIPELINE_STAGE_2_NONE
+                                        : access.stages;
+    state.visible_access = access.write ? VK_ACCESS_2_NONE : access.access;
+  }
+  else {
+    // Reads only wait for the last write, unless an earlier barrier already
+    // made it visible to them
+    const bool visible{
+      (state.visible_stages & access.stages) == access.stages and
+      (state.visible_access & access.access) == access.access
+    };
+    if (state.write_stages != VK_PIPELINE_STAGE_2_NONE and not visible) {
+      src_stages = state.write_stages;
+      src_access = state.write_access;
+      needed     = true;
+      state.visible_stages |= access.stages;
+      state.visible_access |= access.access;
+    }
+    state.read_stages |= access.stages;
+  }
+  if (not needed)
+    return;
+
+  if (image) {
+    batch.images.push_back({
+      .sType         = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+      .pNext         = {},
+      .srcStageMask  = src_stages,
+      .srcAccessMask = src_access,
+      .dstStageMask  = access.stages,
+      .dstAccessMask = access.access,
+      .oldLayout     = transition and access.discard ? VK_IMAGE_LAYOUT_UNDEFINED
+                                                     : old_layout,
+      .newLayout     = access.layout,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image               = image->image_.vk(),
+      .subresourceRange = {
+        .aspectMask     = image->image_.view().aspectFlags(),
+        .baseMipLevel   = 0,
+        .levelCount     = image->image_.mipLevels(),
+        .baseArrayLayer = 0,
+        .layerCount     = 1,
+      },
+    });
+    image->image_.setLayout(access.layout);
+  }
+  else if (auto* buffer = resource.as<PhysicalBuffer>()) {
+    batch.buffers.push_back({
+      .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+      .pNext               = {},
+      .srcStageMask        = src_stages,
+      .srcAccessMask       = src_access,
+      .dstStageMask        = access.stages,
+      .dstAccessMask       = access.access,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .buffer              = buffer->buffer_.vk(),
+      .offset              = 0,
+      .size                = VK_WHOLE_SIZE,
+    });
+  }
+}
+
+void RenderGraph::recordBarriers(const BarrierBatch&      batch,
+                                 const wr::CommandBuffer& cb)
+{
+  if (batch.images.empty() and batch.buffers.empty())
+    return;
+  cb.pipelineBarrier(batch.images, {}, batch.buffers);
+}
+
+bool RenderGraph::hasBufferData(const RenderStage* stage) const
+{
+  for (const auto* resource : stage->reads_) {
+    auto* buffer_resource{ resource->as<BufferResource>() };
+    if (buffer_resource == nullptr)
+      continue;
+    const auto* physical_buffer =
+      buffer_resource->physical_->as<PhysicalBuffer>();
+    if (unlikely(physical_buffer and physical_buffer->buffer_.empty())) {
+      Log(Debug,
+          "The PhysicalBuffer of '{}' in stage '{}' is empty. "
+          "This can happen when RenderGraph::render(...) gets called "
+          "before data has been uploaded to the buffer via "
+          "BufferResource::uploadData(...).",
+          buffer_resource->name_,
+          stage->name_);
+      return false;
+    }
+  }
+  return true;
+}
+
+void RenderGraph::beginSecondary(const RenderStage*       stage,
+                                 const wr::CommandBuffer& secondary) const
+{
+  VkCommandBufferInheritanceRenderingInfo rendering_info{
+    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+    .pNext = {},
+    .flags = 0,
+    .viewMask                = 0,
+    .colorAttachmentCount    = 0,
+    .pColorAttachmentFormats = nullptr,
+    .depthAttachmentFormat   = VK_FORMAT_UNDEFINED,
+    .stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+    .rasterizationSamples    = VK_SAMPLE_COUNT_1_BIT,
+  };
+  VkCommandBufferInheritanceInfo inheritance{
+    .sType                = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+    .pNext                = {},
+    .renderPass           = VK_NULL_HANDLE,
+    .subpass              = 0,
+    .framebuffer          = VK_NULL_HANDLE,
+    .occlusionQueryEnable = VK_FALSE,
+    .queryFlags           = 0,
+    .pipelineStatistics   = 0,
+  };
+  VkCommandBufferUsageFlags usage{
+    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+  };
+  // Graphics stages are recorded within the rendering begun by the primary
+  // command buffer
+  if (const auto* physical = stage->physical_->as<PhysicalGraphicsStage>()) {
+    rendering_info.colorAttachmentCount =
+      static_cast<uint32_t>(physical->color_formats_.size());
+    rendering_info.pColorAttachmentFormats = physical->color_formats_.data();
+    rendering_info.depthAttachmentFormat   = physical->depth_format_;
+    rendering_info.rasterizationSamples    = physical->sample_count_;
+    inheritance.pNext                      = &rendering_info;
+    usage |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  }
+  secondary.begin(usage, &inheritance);
+}
+
+void RenderGraph::recordSecondaries(
+  const RenderStage*                     stage,
+  std::vector<const wr::CommandBuffer*>& secondaries,
+  TaskGroup&                             group) const
+{
+  if (not stage->record_count_) {
+    secondaries.resize(1);
+    group.run([this, stage, &secondaries] {
+      const auto& secondary{ device_.requestSecondaryCommandBuffer() };
+      beginSecondary(stage, secondary);
+      stage->on_record_(secondary);
+      secondary.end();
+      secondaries[0] = &secondary;
+    });
+    return;
+  }
+
+  // One block per worker, unless that makes them smaller than the grain size
+  const size_t   count{ stage->record_count_() };
+  const uint32_t threads{ ThreadPool::instance() != nullptr
+                            ? ThreadPool::instance()->threadCount()
+                            : 1 };
+  const size_t   block_size{ std::max<size_t>(
+    stage->record_grain_size_, (count + threads - 1) / threads) };
+  secondaries.resize((count + block_size - 1) / block_size);
+  for (size_t i{ 0 }; i < secondaries.size(); ++i) {
+    const BlockedRange<size_t> range{ i * block_size,
+                                      std::min(count, (i + 1) * block_size) };
+    group.run([this, stage, range, &slot = secondaries[i]] {
+      const auto& secondary{ device_.requestSecondaryCommandBuffer() };
+      beginSecondary(stage, secondary);
+      stage->on_record_range_(secondary, range);
+      secondary.end();
+      slot = &secondary;
+    });
+  }
+}
+
+void RenderGraph::recordCommandBuffer(
+  const RenderStage*                        stage,
+  std::span<const wr::CommandBuffer* const> secondaries,
+  const wr::CommandBuffer&                  cb) const
 {
   const PhysicalStage& physical = *stage->physical_;
 
+  // Wait for the earlier accesses to the resources of this stage, all in a
+  // single batch
+  BarrierBatch batch;
+  for (const auto& [resource, access] : physical.accesses_) {
+    if (auto* buffer = resource->as<PhysicalBuffer>();
+        buffer and buffer->buffer_.empty())
+      continue;
+    addBarrier(*resource, access, batch);
+  }
+  recordBarriers(batch, cb);
+
   // Record render pass for graphics stages.
   const auto* graphics_stage = stage->as<GraphicsStage>();
   if (graphics_stage != nullptr) {
@@ -102,7 +369,7 @@ void RenderGraph::recordCommandBuffer(const RenderStage*       stage,
     const VkRenderingInfo render_info{
       .sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
       .pNext = nullptr,
-      .flags = 0,
+      .flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT,
       .renderArea{
         .offset{},
         .extent{ swapchain_.extent() },
@@ -118,52 +385,24 @@ void RenderGraph::recordCommandBuffer(const RenderStage*       stage,
     cb.beginRendering(render_info);
   }
 
-  // std::vector<VkBuffer> vertex_buffers;
-  for (const auto* resource : stage->reads_) {
-    auto* buffer_resource{ resource->as<BufferResource>() };
-    if (buffer_resource == nullptr)
-      continue;
-
-    if (const auto& physical_buffer =
-          buffer_resource->physical_->as<PhysicalBuffer>()) {
-
-      if (unlikely(physical_buffer->buffer_.empty())) {
-        Log(Debug,
-            "The PhysicalBuffer of '{}' in stage '{}' is empty. "
-            "This can happen when RenderGraph::render(...) gets called "
-            "before data has been uploaded to the buffer via "
-            "BufferResource::uploadData(...).",
-            buffer_resource->name_,
-            stage->name_);
-        return;
-      }
-
-      // if (buffer_resource->buffer_usage_ & VK_BUFFER_USAGE_INDEX_BUFFER_BIT)
-      // {
-      //   Assert(physical_buffer->buffer_.vk());
-      //   cb.bindIndexBuffer(physical_buffer->buffer_);
-      // }
-
-      // else if (buffer_resource->buffer_usage_ &
-      //          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) {
-      //   vertex_buffers.push_back(physical_buffer->buffer_.vk());
-      // }
-    }
-  }
-
+  // if (buffer_resource->buffer_usage_ & VK_BUFFER_USAGE_INDEX_BUFFER_BIT)
+  // {
+  //   Assert(physical_buffer->buffer_.vk());
+  //   cb.bindIndexBuffer(physical_buffer->buffer_);
+  // }
+  // else if (buffer_resource->buffer_usage_ &
+  //          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) {
+  //   vertex_buffers.push_back(physical_buffer->buffer_.vk());
+  // }
   // if (not vertex_buffers.empty()) {
   //   cb.bindVertexBuffers(vertex_buffers);
   // }
   // cb.bindPipeline(physical.pipeline_);
-  stage->on_record_(cb);
+  cb.executeCommands(secondaries);
 
   if (graphics_stage != nullptr) {
     cb.endRendering();
   }
-
-  // TODO: Find a more performant solution instead of placing a full memory
-  // barrier after each stage!
-  cb.fullBarrier();
 }
 
 void RenderGraph::buildAttachments(const GraphicsStage*   stage,
@@ -171,6 +410,7 @@ void RenderGraph::buildAttachments(const GraphicsStage*   stage,
 {
   auto& attachments = physical.color_attachments_;
   attachments.clear();
+  physical.color_formats_.clear();
   for (const auto* resource : stage->writes_) {
     const auto* texture = resource->as<TextureResource>();
     if (texture == nullptr) {
@@ -191,7 +431,7 @@ void RenderGraph::buildAttachments(const GraphicsStage*   stage,
                "A resolve image has been provided, but only a single sample "
                "is used.");
         resolve_view   = resolve_image->image_.view().vk();
-        resolve_layout = resolve_image->image_.layout();
+        resolve_layout = attachmentLayout(texture->resolve_->usage_);
         resolve_flags  = VK_RESOLVE_MODE_AVERAGE_BIT;
       }
 
@@ -205,7 +445,7 @@ void RenderGraph::buildAttachments(const GraphicsStage*   stage,
         .sType              = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
         .pNext              = {},
         .imageView          = image->image_.view().vk(),
-        .imageLayout        = image->image_.layout(),
+        .imageLayout        = attachmentLayout(texture->usage_),
         .resolveMode        = resolve_flags,
         .resolveImageView   = resolve_view,
         .resolveImageLayout = resolve_layout,
@@ -214,13 +454,17 @@ void RenderGraph::buildAttachments(const GraphicsStage*   stage,
         .clearValue         = texture->clear_value_,
       };
 
+      physical.sample_count_ =
+        std::max(physical.sample_count_, texture->sample_count_);
       switch (texture->usage_) {
         case TextureUsage::Color:
           attachments.push_back(attachment);
+          physical.color_formats_.push_back(texture->format_);
           break;
         case TextureUsage::DepthStencil:
           physical.depth_attachment_ =
             std::make_unique<VkRenderingAttachmentInfo>(attachment);
+          physical.depth_format_ = texture->format_;
           break;
         default:
           Throw("Rendering attachment for this texture usage has not been "
@@ -230,8 +474,78 @@ void RenderGraph::buildAttachments(const GraphicsStage*   stage,
   }
 }
 
+void RenderGraph::buildAccesses(const RenderStage* stage,
+                                PhysicalStage&     physical) const
+{
+  const auto*                 g_stage = stage->as<GraphicsStage>();
+  const VkPipelineStageFlags2 shader_stages{
+    g_stage ? VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+                VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT
+            : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT
+  };
+  auto& accesses = physical.accesses_;
+  accesses.clear();
+
+  for (const auto* resource : stage->writes_) {
+    ResourceAccess access{ .write = true };
+    if (const auto* texture = resource->as<TextureResource>()) {
+      Assert(g_stage, "Textures can only be written as attachments");
+      const VkAttachmentLoadOp load_op{
+        g_stage->load_store_ops_.at(texture).first
+      };
+      access.layout  = attachmentLayout(texture->usage_);
+      access.acquire = texture->physical_->as<PhysicalImage>()->first_stage_ ==
+                       stage;
+      // Resolve targets are overwritten entirely at the end of the stage
+      access.discard = g_stage->resolves_.contains(texture) or
+                       load_op != VK_ATTACHMENT_LOAD_OP_LOAD;
+      switch (texture->usage_) {
+        case TextureUsage::Color:
+          access.stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+          access.access = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+          if (not access.discard)
+            access.access |= VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT;
+          break;
+        case TextureUsage::DepthStencil:
+          // Depth tests read the attachment whatever the load op
+          access.stages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                          VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+          access.access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                          VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+          break;
+        default:
+          Throw("Access for this texture usage has not been implemented.");
+      }
+    }
+    else {
+      access.stages = shader_stages;
+      access.access = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    }
+    accesses.emplace_back(resource->physical_.get(), access);
+  }
+
+  for (const auto* resource : stage->reads_) {
+    // Resources written by the stage are covered by their write access
+    if (stage->writes_.contains(resource))
+      continue;
+    ResourceAccess access;
+    if (const auto* buffer = resource->as<BufferResource>()) {
+      access = bufferReadAccess(buffer->buffer_usage_, shader_stages);
+    }
+    else {
+      access.stages = shader_stages;
+      access.access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+      access.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+    accesses.emplace_back(resource->physical_.get(), access);
+  }
+}
+
 void RenderGraph::compile()
 {
+  Assert(stage_stack_.empty(),
+         "Render graph has already been compiled, use resize() to recreate "
+         "its textures");
   Log(Trace, "Compiling render graph...");
 #ifdef DEBUG
   // ---------------------------------------------------------------------------
@@ -508,37 +822,141 @@ void RenderGraph::compile()
     buffer_resource->physical_ = std::make_unique<PhysicalBuffer>();
   }
 
-  Log(Trace, "Allocating physical resource for texture:");
-  for (auto& texture : texture_resources_) {
-    Log(Trace, "  - {}", texture->name_);
+  // ---------------------------------------------------------------------------
+  // Texture lifetimes
+  // ---------------------------------------------------------------------------
+  // A texture whose first use in a frame overwrites it doesn't need to keep
+  // its contents from one frame to the next. It is only alive from the first
+  // to the last stage group using it, and textures that are never alive at the
+  // same time can share memory.
+  for (size_t group{ 0 }; group < stage_stack_.size(); ++group) {
+    for (const auto* stage : stage_stack_[group]) {
+      const auto* g_stage = stage->as<GraphicsStage>();
+      auto        use     = [&](const RenderResource* resource, bool discards) {
+        const auto* texture = resource->as<TextureResource>();
+        if (texture == nullptr)
+          return;
+        Lifetime& lifetime{ lifetimes_[texture] };
+        if (lifetime.first_stage == nullptr) {
+          lifetime.first       = group;
+          lifetime.first_stage = stage;
+        }
+        if (group == lifetime.first and not discards)
+          lifetime.transient = false;
+        lifetime.last = group;
+      };
+      for (const auto* resource : stage->writes_) {
+        const auto* texture = resource->as<TextureResource>();
+        use(resource,
+            g_stage and texture and
+              (g_stage->resolves_.contains(texture) or
+               g_stage->load_store_ops_.at(texture).first !=
+                 VK_ATTACHMENT_LOAD_OP_LOAD));
+      }
+      for (const auto* resource : stage->reads_) {
+        if (not stage->writes_.contains(resource))
+          use(resource, false);
+      }
+    }
+  }
+  // The back buffer is copied out after the last stage
+  lifetimes_[backBuffer()].transient = false;
+
+  // ---------------------------------------------------------------------------
+  // Store ops
+  // ---------------------------------------------------------------------------
+  // Attachments only need to be stored if the next stage using them loads
+  // their contents, or the next frame does. Transient textures that are never
+  // stored or loaded only live in tile memory, and need no backing memory on
+  // devices that allocate it lazily.
+  std::vector<RenderStage*> order;
+  for (const auto& group : stage_stack_)
+    order.insert(order.end(), group.begin(), group.end());
+  auto loads = [](const RenderStage* stage, const TextureResource* texture) {
+    if (not stage->writes_.contains(texture))
+      return stage->reads_.contains(texture);
+    const auto* g_stage = stage->as<GraphicsStage>();
+    return not g_stage or (not g_stage->resolves_.contains(texture) and
+                           g_stage->load_store_ops_.at(texture).first ==
+                             VK_ATTACHMENT_LOAD_OP_LOAD);
+  };
+  for (const auto& kv : lifetimes_) {
+    const TextureResource* texture{ kv.first };
+    bool                   stored{ false };
+    bool                   loaded{ false };
+    for (size_t i{ 0 }; i < order.size(); ++i) {
+      auto* g_stage = order[i]->as<GraphicsStage>();
+      loaded |= (order[i]->writes_.contains(texture) or
+                 order[i]->reads_.contains(texture)) and
+                loads(order[i], texture);
+      if (not g_stage or not g_stage->writes_.contains(texture))
+        continue;
+      if (g_stage->resolves_.contains(texture)) {
+        stored = true;
+        continue;
+      }
+      auto& store_op{ g_stage->load_store_ops_.at(texture).second };
+      if (g_stage->inferred_stores_.contains(texture)) {
+        const auto next{ std::find_if(
+          order.begin() + i + 1, order.end(), [&](const RenderStage* stage) {
+            return stage->writes_.contains(texture) or
+                   stage->reads_.contains(texture);
+          }) };
+        const bool needed{ next != order.end() ? loads(*next, texture)
+                                               : not kv.second.transient };
+        store_op = needed ? VK_ATTACHMENT_STORE_OP_STORE
+                          : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      }
+      stored |= store_op != VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    }
+    if (kv.second.transient and not stored and not loaded)
+      memoryless_.insert(texture);
+  }
+
+  allocateTextures();
+  buildStages();
+}
 
-    // if (texture_resource->usage_ == TextureUsage::BackBuffer) {
-    //   texture_resource->physical_ = std::make_shared<PhysicalBackBuffer>();
-    //   continue;
-    // }
+void RenderGraph::allocateTextures()
+{
+  const bool lazy_memory{ device_.hasMemoryType(
+    VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) };
+
+  Log(Trace, "Allocating physical resource for texture:");
+  auto image_info = [&](const TextureResource* texture) {
     VkImageUsageFlags  usage_flags;
     VkImageAspectFlags aspect_flags;
-    VkImageLayout      layout;
     switch (texture->usage_) {
       case TextureUsage::Color:
         usage_flags  = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
         aspect_flags = VK_IMAGE_ASPECT_COLOR_BIT;
-        layout       = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
         break;
       case TextureUsage::DepthStencil:
         usage_flags  = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
         aspect_flags = VK_IMAGE_ASPECT_DEPTH_BIT;
-        layout       = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
         break;
       default:
         Throw("Image creation for this usage has not been implemented yet.");
         break;
     }
-    if (texture.get() == backBuffer()) {
+    if (texture == backBuffer()) {
       usage_flags |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // to copy to swapchain
     }
+    for (const auto& stage : stages_) {
+      if (stage->reads_.contains(texture) and
+          not stage->writes_.contains(texture)) {
+        usage_flags |= VK_IMAGE_USAGE_SAMPLED_BIT;
+        break;
+      }
+    }
+    VmaMemoryUsage memory_usage{ VMA_MEMORY_USAGE_GPU_ONLY };
+    if (memoryless_.contains(texture)) {
+      usage_flags |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+      if (lazy_memory)
+        memory_usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+    }
 
-    const wr::ImageCreateInfo texture_info{
+    return wr::ImageCreateInfo{
       .name         = fmt::format("{} image", texture->name_),
       .extent       = swapchain_.extent(),
       .format       = texture->format_,
@@ -547,15 +965,107 @@ void RenderGraph::compile()
       .aspect_flags = aspect_flags,
       .sample_count = texture->sample_count_,
       .mip_levels   = 1,
-      .memory_usage = VMA_MEMORY_USAGE_GPU_ONLY,
-      .final_layout = layout,
+      .memory_usage = memory_usage,
+      .final_layout = attachmentLayout(texture->usage_),
     };
 
+  };
+
+  std::vector<TextureResource*> transient;
+  for (auto& texture : texture_resources_) {
+    // Lazily allocated memory is left out of aliasing, there is next to
+    // nothing to share
+    const auto it{ lifetimes_.find(texture.get()) };
+    if (it != lifetimes_.end() and it->second.transient and
+        not(lazy_memory and memoryless_.contains(texture.get()))) {
+      transient.push_back(texture.get());
+      continue;
+    }
+    Log(Trace, "  - {}", texture->name_);
     auto physical      = std::make_unique<PhysicalImage>();
-    physical->image_   = wr::Image{ device_, texture_info };
+    physical->image_   = wr::Image{ device_, image_info(texture.get()) };
     texture->physical_ = std::move(physical);
   }
 
+  // Place the largest transient textures first, each in the first block of
+  // memory none of whose textures is alive at the same time
+  struct MemoryBlock {
+    VkMemoryRequirements          requirements;
+    std::vector<TextureResource*> textures;
+  };
+  std::vector<MemoryBlock>                                         blocks;
+  std::unordered_map<const TextureResource*, VkMemoryRequirements> requirements;
+  for (const auto* texture : transient) {
+    requirements[texture] =
+      wr::Image::memoryRequirements(device_, image_info(texture));
+  }
+  std::ranges::sort(transient, [&](const auto* a, const auto* b) {
+    return requirements[a].size > requirements[b].size;
+  });
+  for (auto* texture : transient) {
+    const Lifetime&             lifetime{ lifetimes_[texture] };
+    const VkMemoryRequirements& reqs{ requirements[texture] };
+    auto fits = [&](const MemoryBlock& block) {
+      if ((block.requirements.memoryTypeBits & reqs.memoryTypeBits) == 0)
+        return false;
+      return std::ranges::all_of(block.textures, [&](const auto* other) {
+        const Lifetime& l{ lifetimes_[other] };
+        return l.last < lifetime.first or lifetime.last < l.first;
+      });
+    };
+    if (auto block = std::ranges::find_if(blocks, fits);
+        block != blocks.end()) {
+      block->requirements.size = std::max(block->requirements.size, reqs.size);
+      block->requirements.alignment =
+        std::max(block->requirements.alignment, reqs.alignment);
+      block->requirements.memoryTypeBits &= reqs.memoryTypeBits;
+      block->textures.push_back(texture);
+    }
+    else {
+      blocks.push_back({ reqs, { texture } });
+    }
+  }
+
+  VkDeviceSize transient_size{ 0 };
+  VkDeviceSize aliased_size{ 0 };
+  for (const auto& block : blocks) {
+    if (block.textures.size() == 1) {
+      // Nothing to share with, the texture keeps its memory to itself
+      auto* texture{ block.textures.front() };
+      Log(Trace, "  - {}", texture->name_);
+      auto physical      = std::make_unique<PhysicalImage>();
+      physical->image_   = wr::Image{ device_, image_info(texture) };
+      texture->physical_ = std::move(physical);
+      continue;
+    }
+    const wr::DeviceMemory& memory{ transient_memory_.emplace_back(
+      device_,
+      fmt::format("Transient memory #{}", transient_memory_.size() + 1),
+      block.requirements) };
+    const auto state{ std::make_shared<MemoryAccessState>() };
+    for (auto* texture : block.textures) {
+      Log(Trace, "  - {} (aliased)", texture->name_);
+      auto physical    = std::make_unique<PhysicalImage>();
+      physical->image_ = wr::Image{ device_, image_info(texture), memory };
+      physical->first_stage_ = lifetimes_[texture].first_stage;
+      physical->state_       = state;
+      texture->physical_     = std::move(physical);
+      transient_size += requirements[texture].size;
+    }
+    aliased_size += block.requirements.size;
+  }
+  if (aliased_size > 0) {
+    Log(Debug,
+        "Transient textures share {} blocks of memory, {:.1f} MiB instead of "
+        "{:.1f} MiB",
+        transient_memory_.size(),
+        static_cast<double>(aliased_size) / (1024. * 1024.),
+        static_cast<double>(transient_size) / (1024. * 1024.));
+  }
+}
+
+void RenderGraph::buildStages()
+{
   for (auto substages : stage_stack_) {
     for (auto* stage : substages) {
       if (auto* graphics_stage = stage->as<GraphicsStage>()) {
@@ -583,12 +1093,53 @@ void RenderGraph::compile()
         // buildPipelineLayout(graphics_stage, physical);
         // buildGraphicsPipeline(graphics_stage, physical);
       }
+      else {
+        stage->physical_ = std::make_unique<PhysicalStage>();
+      }
+      buildAccesses(stage, *stage->physical_);
     }
   }
 }
 
+void RenderGraph::resize(wr::Swapchain old_swapchain)
+{
+  Assert(not stage_stack_.empty(), "Render graph has not been compiled");
+  Assert(back_buffer_->format_ == swapchain_.imageFormat(),
+         "Swapchain image format changed, the render graph must be rebuilt");
+  Log(Trace,
+      "Recreating render graph textures ({}x{})",
+      swapchain_.extent().width,
+      swapchain_.extent().height);
+  // Command buffers recorded before now may still use the old textures and
+  // swapchain images, they are destroyed once those have finished executing
+  releaseRetired();
+  RetiredResources& retired{ retired_.emplace_back() };
+  retired.swapchain = std::move(old_swapchain);
+  retired.memory    = std::move(transient_memory_);
+  transient_memory_.clear();
+  for (auto& texture : texture_resources_)
+    retired.textures.push_back(std::move(texture->physical_));
+  retired.users = in_flight_;
+
+  allocateTextures();
+  buildStages();
+}
+
+void RenderGraph::releaseRetired()
+{
+  std::erase_if(in_flight_, [](const Submission& submission) {
+    return submission.completed();
+  });
+  std::erase_if(retired_, [](const RetiredResources& retired) {
+    return std::ranges::all_of(retired.users, &Submission::completed);
+  });
+}
+
 void RenderGraph::render(const wr::CommandBuffer& cb, wr::Image& target)
 {
+  releaseRetired();
+  in_flight_.push_back({ &cb, cb.submitCount() + 1 });
+
   Assert(target.layout() == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
          "Render graph expects target to be in "
          "VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL");
@@ -642,12 +1193,23 @@ void RenderGraph::render(const wr::CommandBuffer& cb, wr::Image& target)
     }
   }
 
-  // TODO: full memory barrier is not needed between nodes in same subset
+  // Record the contents of all stages into secondary command buffers on
+  // worker threads, then run them in order with the barriers in between
+  std::vector<const RenderStage*> stages;
   for (const auto& subset : stage_stack_) {
-    for (const auto& stage : subset) {
-      recordCommandBuffer(stage, cb);
+    for (const auto* stage : subset) {
+      if (hasBufferData(stage))
+        stages.push_back(stage);
     }
   }
+  std::vector<std::vector<const wr::CommandBuffer*>> secondaries(
+    stages.size());
+  TaskGroup group;
+  for (size_t i{ 0 }; i < stages.size(); ++i)
+    recordSecondaries(stages[i], secondaries[i], group);
+  group.wait();
+  for (size_t i{ 0 }; i < stages.size(); ++i)
+    recordCommandBuffer(stages[i], secondaries[i], cb);
 
   // Copy back buffer to target
   const VkImageCopy2 regions[] {{
@@ -669,10 +1231,16 @@ void RenderGraph::render(const wr::CommandBuffer& cb, wr::Image& target)
     .dstOffset = {0,0,0},
     .extent = {size.width, size.height, 1}
   }};
-  cb.transitionImageLayout(bb->image_, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
-    .copyImage(target, bb->image_, regions)
-    .transitionImageLayout(bb->image_,
-                           VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+  // The back buffer is left in the transfer layout, the first stage writing
+  // to it in the next frame transitions it back
+  BarrierBatch batch;
+  addBarrier(*bb,
+             { .stages = VK_PIPELINE_STAGE_2_COPY_BIT,
+               .access = VK_ACCESS_2_TRANSFER_READ_BIT,
+               .layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL },
+             batch);
+  recordBarriers(batch, cb);
+  cb.copyImage(target, bb->image_, regions);
 }
 
 } // namespace eldr::vk
@@ -8,6 +8,9 @@
 #include <eldr/vulkan/wrappers/image.hpp>
 #include <eldr/vulkan/wrappers/pipeline.hpp>
 
+#include <atomic>
+#include <vector>
+
 namespace eldr::vk::wr {
 //------------------------------------------------------------------------------
 // CommandBufferImpl
@@ -17,15 +20,30 @@ public:
   CommandBufferImpl(const Device&                     device,
                     const VkCommandBufferAllocateInfo alloc_info);
   ~CommandBufferImpl();
-  const Device&   device_;
-  VkCommandPool   command_pool_;
-  VkCommandBuffer command_buffer_{ VK_NULL_HANDLE };
-  Fence           wait_fence_;
+  const Device&        device_;
+  VkCommandPool        command_pool_;
+  VkCommandBufferLevel level_;
+  VkCommandBuffer      command_buffer_{ VK_NULL_HANDLE };
+  // Only primary command buffers are submitted and get a fence
+  Fence                wait_fence_;
+  // Submissions so far, and how many of them are known to have completed
+  uint64_t submit_count_{ 0 };
+  uint64_t completed_count_{ 0 };
+  // Secondary command buffers executed since this primary one was handed out,
+  // released when it is handed out again
+  std::vector<const CommandBuffer*> secondaries_;
+  // Whether this secondary command buffer is handed out, from its request
+  // until the primary one executing it is reused. Cleared from the thread
+  // recording the primary command buffer.
+  std::atomic<bool> pending_{ false };
 };
 
 CommandBuffer::CommandBufferImpl::CommandBufferImpl(
   const Device& device, const VkCommandBufferAllocateInfo alloc_info)
-  : device_(device), command_pool_(alloc_info.commandPool), wait_fence_(device)
+  : device_(device), command_pool_(alloc_info.commandPool),
+    level_(alloc_info.level),
+    wait_fence_(level_ == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? Fence{ device }
+                                                         : Fence{})
 {
   if (const VkResult result{ vkAllocateCommandBuffers(
         device_.logical(), &alloc_info, &command_buffer_) };
@@ -45,15 +63,16 @@ CommandBuffer::CommandBuffer()                         = default;
 CommandBuffer::~CommandBuffer()                        = default;
 CommandBuffer::CommandBuffer(CommandBuffer&&) noexcept = default;
 
-CommandBuffer::CommandBuffer(const Device&      device,
-                             const CommandPool& command_pool,
-                             std::string_view   name)
+CommandBuffer::CommandBuffer(const Device&        device,
+                             const CommandPool&   command_pool,
+                             std::string_view     name,
+                             VkCommandBufferLevel level)
   : name_(name)
 {
   VkCommandBufferAllocateInfo alloc_info{};
   alloc_info.sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
   alloc_info.commandPool = command_pool.vk();
-  alloc_info.level       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  alloc_info.level       = level;
   alloc_info.commandBufferCount = 1;
 
   d_ = std::make_unique<CommandBufferImpl>(device, alloc_info);
@@ -65,8 +84,8 @@ const CommandBuffer& CommandBuffer::pipelineBarrier(
   std::span<const VkBufferMemoryBarrier2> buf_mem_barriers) const
 {
   // One barrier must be set at least
-  Assert(!(img_mem_barriers.empty() && mem_barriers.empty()) &&
-         buf_mem_barriers.empty());
+  Assert(!(img_mem_barriers.empty() && mem_barriers.empty() &&
+           buf_mem_barriers.empty()));
 
   VkDependencyInfo dep_info{
     .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
@@ -133,13 +152,17 @@ const CommandBuffer& CommandBuffer::fullBarrier() const
   return pipelineMemoryBarrier(barrier);
 }
 
-const CommandBuffer& CommandBuffer::begin(VkCommandBufferUsageFlags usage) const
+const CommandBuffer&
+CommandBuffer::begin(VkCommandBufferUsageFlags             usage,
+                     const VkCommandBufferInheritanceInfo* inheritance) const
 {
+  Assert(d_->level_ == VK_COMMAND_BUFFER_LEVEL_PRIMARY or inheritance,
+         "Secondary command buffers need inheritance info");
   const VkCommandBufferBeginInfo begin_info{
     .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
     .pNext            = {},
     .flags            = usage,
-    .pInheritanceInfo = nullptr,
+    .pInheritanceInfo = inheritance,
   };
   if (const VkResult result{
         vkBeginCommandBuffer(d_->command_buffer_, &begin_info) };
@@ -186,6 +209,24 @@ const CommandBuffer& CommandBuffer::endRenderPass() const
   return *this;
 }
 
+const CommandBuffer& CommandBuffer::executeCommands(
+  std::span<const CommandBuffer* const> secondaries) const
+{
+  if (secondaries.empty())
+    return *this;
+  std::vector<VkCommandBuffer> command_buffers;
+  command_buffers.reserve(secondaries.size());
+  for (const auto* secondary : secondaries) {
+    Assert(secondary->d_->level_ == VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+    d_->secondaries_.push_back(secondary);
+    command_buffers.push_back(secondary->vk());
+  }
+  vkCmdExecuteCommands(d_->command_buffer_,
+                       static_cast<uint32_t>(command_buffers.size()),
+                       command_buffers.data());
+  return *this;
+}
+
 const CommandBuffer& CommandBuffer::endRendering() const
 {
   vkCmdEndRendering(d_->command_buffer_);
@@ -208,6 +249,7 @@ CommandBuffer::submit(const VkSubmitInfo& submit_info) const
         d_->device_.graphicsQueue(), 1, &submit_info, d_->wait_fence_.vk()) };
       result != VK_SUCCESS)
     Throw("Failed to submit to queue ({}).", result);
+  ++d_->submit_count_;
   return *this;
 }
 
@@ -615,7 +657,38 @@ CommandBuffer::createStagingBuffer(const std::string&      name,
   return staging_buffers_.back();
 }
 
-VkResult CommandBuffer::fenceStatus() const { return d_->wait_fence_.status(); }
+VkResult CommandBuffer::fenceStatus() const
+{
+  Assert(d_->level_ == VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+  return d_->wait_fence_.status();
+}
+
+uint64_t CommandBuffer::submitCount() const { return d_->submit_count_; }
+
+bool CommandBuffer::hasCompleted(uint64_t submission) const
+{
+  if (submission > d_->completed_count_ and fenceStatus() == VK_SUCCESS)
+    d_->completed_count_ = d_->submit_count_;
+  return submission <= d_->completed_count_;
+}
+
+bool CommandBuffer::pending() const
+{
+  return d_->pending_.load(std::memory_order_acquire);
+}
+
+void CommandBuffer::markPending() const
+{
+  d_->pending_.store(true, std::memory_order_relaxed);
+}
+
+void CommandBuffer::releaseSecondaries() const
+{
+  for (const auto* secondary : d_->secondaries_)
+    secondary->d_->pending_.store(false, std::memory_order_release);
+  d_->secondaries_.clear();
+}
+
 void     CommandBuffer::waitFence() const
 {
   // 5 seconds, vulkan timeout is in nanoseconds
@@ -624,7 +697,13 @@ void     CommandBuffer::waitFence() const
     Log(core::Debug, "{} timed out waiting for its internal fence!", name_);
 }
 
-void CommandBuffer::resetFence() const { d_->wait_fence_.reset(); }
+void CommandBuffer::resetFence() const
+{
+  // The fence no longer tells whether the submissions so far have completed
+  if (fenceStatus() == VK_SUCCESS)
+    d_->completed_count_ = d_->submit_count_;
+  d_->wait_fence_.reset();
+}
 
 VkCommandBuffer CommandBuffer::vk() const { return d_->command_buffer_; }
 
@@ -54,6 +54,9 @@ const CommandBuffer& CommandPool::requestCommandBuffer()
   // Try to find a command buffer that is not in use
   for (const auto& cb : command_buffers_) {
     if (cb.fenceStatus() == VK_SUCCESS) {
+      // The secondary command buffers it executed are done as well. Their
+      // state can't be derived from the fence anymore once it is reset.
+      cb.releaseSecondaries();
       // Reset the command buffer's fence to make it usable again
       cb.resetFence();
       // The command buffer is reset implicitly since the command pools are
@@ -78,5 +81,23 @@ const CommandBuffer& CommandPool::requestCommandBuffer()
   return command_buffers_.back();
 }
 
+const CommandBuffer& CommandPool::requestSecondaryCommandBuffer()
+{
+  for (const auto& cb : secondary_command_buffers_) {
+    if (not cb.pending()) {
+      cb.markPending();
+      return cb;
+    }
+  }
+
+  const std::string name{ fmt::format("secondary command buffer #{}",
+                                      secondary_command_buffers_.size() + 1) };
+  Log(Trace, "Creating {}", name);
+  const auto& cb{ secondary_command_buffers_.emplace_back(
+    d_->device_, *this, name, VK_COMMAND_BUFFER_LEVEL_SECONDARY) };
+  cb.markPending();
+  return cb;
+}
+
 VkCommandPool CommandPool::vk() const { return d_->pool_; }
 } // namespace eldr::vk::wr
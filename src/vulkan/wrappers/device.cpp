@@ -378,6 +378,11 @@ const CommandBuffer& Device::requestCommandBuffer() const
   return threadGraphicsPool().requestCommandBuffer();
 }
 
+const CommandBuffer& Device::requestSecondaryCommandBuffer() const
+{
+  return threadGraphicsPool().requestSecondaryCommandBuffer();
+}
+
 void Device::execute(
   const std::function<void(const CommandBuffer& cb)>& cmd_lambda) const
 {
@@ -400,6 +405,17 @@ uint32_t Device::findMemoryType(uint32_t              type_filter,
   Throw("Failed to find suitable device memory type!");
 }
 
+bool Device::hasMemoryType(VkMemoryPropertyFlags properties) const
+{
+  VkPhysicalDeviceMemoryProperties mem_props;
+  vkGetPhysicalDeviceMemoryProperties(d_->physical_device_, &mem_props);
+  for (uint32_t i = 0; i < mem_props.memoryTypeCount; ++i) {
+    if ((mem_props.memoryTypes[i].propertyFlags & properties) == properties)
+      return true;
+  }
+  return false;
+}
+
 VkPhysicalDevice Device::physical() const { return d_->physical_device_; }
 VkDevice         Device::logical() const { return d_->device_; }
 VmaAllocator     Device::allocator() const { return d_->allocator_; }
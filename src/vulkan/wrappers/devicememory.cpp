@@ -0,0 +1,71 @@
+#include <eldr/vulkan/vktypes.hpp>
+#include <eldr/vulkan/wrappers/device.hpp>
+#include <eldr/vulkan/wrappers/devicememory.hpp>
+
+#include <string>
+
+namespace eldr::vk::wr {
+//------------------------------------------------------------------------------
+// DeviceMemoryImpl
+//------------------------------------------------------------------------------
+class DeviceMemory::DeviceMemoryImpl : public GpuResourceAllocation {
+public:
+  DeviceMemoryImpl(const Device&                  device,
+                   const VkMemoryRequirements&    requirements,
+                   const VmaAllocationCreateInfo& alloc_ci);
+  ~DeviceMemoryImpl();
+};
+
+DeviceMemory::DeviceMemoryImpl::DeviceMemoryImpl(
+  const Device&                  device,
+  const VkMemoryRequirements&    requirements,
+  const VmaAllocationCreateInfo& alloc_ci)
+  : GpuResourceAllocation(device, {}, {}, {})
+{
+  if (const VkResult result{ vmaAllocateMemory(device_.allocator(),
+                                               &requirements,
+                                               &alloc_ci,
+                                               &allocation_,
+                                               &alloc_info_) };
+      result != VK_SUCCESS)
+    Throw("Failed to allocate device memory! ({})", result);
+  vmaGetAllocationMemoryProperties(
+    device_.allocator(), allocation_, &mem_flags_);
+}
+
+DeviceMemory::DeviceMemoryImpl::~DeviceMemoryImpl()
+{
+  vmaFreeMemory(device_.allocator(), allocation_);
+}
+
+//------------------------------------------------------------------------------
+// DeviceMemory
+//------------------------------------------------------------------------------
+DeviceMemory::DeviceMemory()                          = default;
+DeviceMemory::DeviceMemory(DeviceMemory&&) noexcept   = default;
+DeviceMemory::~DeviceMemory()                         = default;
+DeviceMemory& DeviceMemory::operator=(DeviceMemory&&) = default;
+
+DeviceMemory::DeviceMemory(const Device&               device,
+                           std::string_view            name,
+                           const VkMemoryRequirements& requirements)
+{
+  const VmaAllocationCreateInfo alloc_ci{
+    .flags          = VMA_ALLOCATION_CREATE_CAN_ALIAS_BIT,
+    .usage          = VMA_MEMORY_USAGE_GPU_ONLY,
+    .requiredFlags  = {},
+    .preferredFlags = {},
+    .memoryTypeBits = {},
+    .pool           = {},
+    .pUserData      = {},
+    .priority       = {},
+  };
+  d_ = std::make_unique<DeviceMemoryImpl>(device, requirements, alloc_ci);
+  vmaSetAllocationName(
+    device.allocator(), d_->allocation_, std::string{ name }.c_str());
+}
+
+VmaAllocation DeviceMemory::allocation() const { return d_->allocation_; }
+
+VkDeviceSize DeviceMemory::size() const { return d_->alloc_info_.size; }
+} // namespace eldr::vk::wr
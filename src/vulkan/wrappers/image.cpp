@@ -3,6 +3,7 @@
 #include <eldr/vulkan/vktypes.hpp>
 #include <eldr/vulkan/wrappers/commandbuffer.hpp>
 #include <eldr/vulkan/wrappers/device.hpp>
+#include <eldr/vulkan/wrappers/devicememory.hpp>
 #include <eldr/vulkan/wrappers/image.hpp>
 
 namespace eldr::vk::wr {
@@ -49,6 +50,29 @@ ImageCreateInfo createBitmapTextureCI(const Bitmap& bitmap, uint32_t mip_levels)
   };
   return texture_info;
 }
+
+VkImageCreateInfo createVkImageCI(const ImageCreateInfo& image_info)
+{
+  return {
+    .sType                 = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+    .pNext                 = nullptr,
+    .flags                 = 0,
+    .imageType             = VK_IMAGE_TYPE_2D,
+    .format                = image_info.format,
+    .extent                = { image_info.extent.width,
+                               image_info.extent.height,
+                               1 },
+    .mipLevels             = image_info.mip_levels,
+    .arrayLayers           = 1,
+    .samples               = image_info.sample_count,
+    .tiling                = image_info.tiling,
+    .usage                 = image_info.usage_flags,
+    .sharingMode           = VK_SHARING_MODE_EXCLUSIVE,
+    .queueFamilyIndexCount = {},
+    .pQueueFamilyIndices   = nullptr,
+    .initialLayout         = VK_IMAGE_LAYOUT_UNDEFINED,
+  };
+}
 } // namespace
 //------------------------------------------------------------------------------
 // GpuImageImpl
@@ -59,9 +83,15 @@ public:
   ImageImpl(const Device&                  device,
             const VkImageCreateInfo&       image_ci,
             const VmaAllocationCreateInfo& alloc_ci);
+  // For images placed in memory owned by someone else
+  ImageImpl(const Device&            device,
+            const VkImageCreateInfo& image_ci,
+            VmaAllocation            memory,
+            VkDeviceSize             offset);
   ImageImpl(const Device&, VkImage); // for swapchain images
   ~ImageImpl();
   VkImage image_{ VK_NULL_HANDLE };
+  bool    owns_image_{ true };
 };
 
 Image::ImageImpl::ImageImpl(const Device&                  device,
@@ -79,8 +109,21 @@ Image::ImageImpl::ImageImpl(const Device&                  device,
     Throw("Failed to create image! ({})", result);
 }
 
+Image::ImageImpl::ImageImpl(const Device&            device,
+                            const VkImageCreateInfo& image_ci,
+                            VmaAllocation            memory,
+                            VkDeviceSize             offset)
+  : GpuResourceAllocation(device, {}, {}, {})
+{
+  if (const VkResult result{ vmaCreateAliasingImage2(
+        device_.allocator(), memory, offset, &image_ci, &image_) };
+      result != VK_SUCCESS)
+    Throw("Failed to create aliasing image! ({})", result);
+}
+
 Image::ImageImpl::ImageImpl(const Device& device, VkImage image)
-  : GpuResourceAllocation(device, {}, {}, {}), image_(image)
+  : GpuResourceAllocation(device, {}, {}, {}), image_(image),
+    owns_image_(false)
 {
 }
 
@@ -89,6 +132,9 @@ Image::ImageImpl::~ImageImpl()
   if (allocation_ != VK_NULL_HANDLE) {
     vmaDestroyImage(device_.allocator(), image_, allocation_);
   }
+  else if (owns_image_ and image_ != VK_NULL_HANDLE) {
+    vkDestroyImage(device_.logical(), image_, nullptr);
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -103,23 +149,7 @@ Image::Image(const Device& device, const ImageCreateInfo& image_info)
   : name_(image_info.name), size_(image_info.extent),
     format_(image_info.format), mip_levels_(image_info.mip_levels)
 {
-  const VkImageCreateInfo image_ci{
-    .sType                 = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-    .pNext                 = nullptr,
-    .flags                 = 0,
-    .imageType             = VK_IMAGE_TYPE_2D,
-    .format                = format_,
-    .extent                = { size_.width, size_.height, 1 },
-    .mipLevels             = mip_levels_,
-    .arrayLayers           = 1,
-    .samples               = image_info.sample_count,
-    .tiling                = image_info.tiling,
-    .usage                 = image_info.usage_flags,
-    .sharingMode           = VK_SHARING_MODE_EXCLUSIVE,
-    .queueFamilyIndexCount = {},
-    .pQueueFamilyIndices   = nullptr,
-    .initialLayout         = VK_IMAGE_LAYOUT_UNDEFINED,
-  };
+  const VkImageCreateInfo image_ci{ createVkImageCI(image_info) };
 
   const VmaAllocationCreateInfo alloc_ci{
     .flags          = {},
@@ -141,6 +171,39 @@ Image::Image(const Device& device, const ImageCreateInfo& image_info)
   }
 }
 
+Image::Image(const Device&          device,
+             const ImageCreateInfo& image_info,
+             const DeviceMemory&    memory,
+             VkDeviceSize           offset)
+  : name_(image_info.name), size_(image_info.extent),
+    format_(image_info.format), mip_levels_(image_info.mip_levels)
+{
+  const VkImageCreateInfo image_ci{ createVkImageCI(image_info) };
+  d_ = std::make_unique<ImageImpl>(
+    device, image_ci, memory.allocation(), offset);
+  image_view_ = ImageView{ device, *this, image_info.aspect_flags };
+}
+
+VkMemoryRequirements
+Image::memoryRequirements(const Device&          device,
+                          const ImageCreateInfo& image_info)
+{
+  const VkImageCreateInfo               image_ci{ createVkImageCI(image_info) };
+  const VkDeviceImageMemoryRequirements info{
+    .sType       = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS,
+    .pNext       = {},
+    .pCreateInfo = &image_ci,
+    .planeAspect = {},
+  };
+  VkMemoryRequirements2 requirements{
+    .sType              = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+    .pNext              = {},
+    .memoryRequirements = {},
+  };
+  vkGetDeviceImageMemoryRequirements(device.logical(), &info, &requirements);
+  return requirements.memoryRequirements;
+}
+
 Image::Image(const Device& device, const Bitmap& bitmap, uint32_t mip_levels)
   : Image(device, createBitmapTextureCI(bitmap, mip_levels))
 {
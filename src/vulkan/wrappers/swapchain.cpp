@@ -106,10 +106,15 @@ Swapchain::Swapchain(const Device&  device,
   }
 }
 
-void Swapchain::setupSwapchain(const Device&  device,
-                               const Surface& surface,
-                               VkExtent2D     requested_extent)
+Swapchain Swapchain::setupSwapchain(const Device&  device,
+                                    const Surface& surface,
+                                    VkExtent2D     requested_extent)
 {
+  Swapchain old;
+  old.d_      = std::move(d_);
+  old.images_ = std::move(images_);
+  old.extent_ = extent_;
+
   const SwapchainSupportDetails& support_details{
     device.swapchainSupportDetails(surface.vk())
   };
@@ -127,8 +132,8 @@ void Swapchain::setupSwapchain(const Device&  device,
   }
 
   VkSwapchainKHR old_swapchain{ VK_NULL_HANDLE };
-  if (likely(d_ != nullptr))
-    old_swapchain = d_->swapchain_;
+  if (likely(old.d_ != nullptr))
+    old_swapchain = old.d_->swapchain_;
   VkSwapchainCreateInfoKHR swapchain_ci{
     .sType            = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
     .pNext            = {},
@@ -169,8 +174,6 @@ void Swapchain::setupSwapchain(const Device&  device,
   Log(core::Trace, "Creating swapchain...");
   d_ = std::make_unique<SwapchainImpl>(device, swapchain_ci);
 
-  // Clear data from old swapchain
-  images_.clear();
   std::vector<VkImage> images;
 
   // Get new swapchain images
@@ -195,6 +198,7 @@ void Swapchain::setupSwapchain(const Device&  device,
                                   extent_,
                                   surface_format_.format));
   }
+  return old;
 }
 
 const VkSemaphore* Swapchain::imageAvailableSemaphore(uint32_t index) const